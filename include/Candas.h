@@ -14,8 +14,13 @@
  *     1  | 8         |   2.4         |   'B'
  *     .  | .         |    .          |    .
  * - only use C standard library
+ *   (optionally POSIX mmap and SSE2 / AVX2 intrinsics when available, see CANDAS_NO_MMAP / CANDAS_NO_SIMD)
  * - currently support int/double/char data type,
- *   specified by first character 'I'/'D'/'C'
+ *   specified by first character 'I'/'D'/'C',
+ *   and compact / wide types int8 'b', int16 'h', int64 'l', uint32 'u', float 'f',
+ *   and dictionary encoded strings 'S' (int codes into a string dictionary shared by derived dataframes)
+ * - missing values are nulls in an optional validity bitmap per column (null rows also hold MISS_*),
+ *   columns without nulls have no bitmap and cost nothing
  * - support read & write csv, filter by value, concatenate by row & col, merge(left), sort by value
  * - most functions (except get pointer) are deep copy,
  *   which means use can_free for every can_dataframe
@@ -28,43 +33,336 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <stdarg.h>
 
-#define MAX_COL_NUM 16
-#define MAX_COL_LEN 32
+// optional speedups, define CANDAS_NO_MMAP / CANDAS_NO_SIMD to use only C standard library,
+// define CANDAS_NO_THREADS if C11 <threads.h> is not wanted
+#if !defined(CANDAS_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define CANDAS_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CANDAS_HAVE_MMAP 0
+#endif
+
+#if !defined(CANDAS_NO_THREADS) && !defined(__STDC_NO_THREADS__)
+#define CANDAS_HAVE_THREADS 1
+#include <threads.h>
+#else
+#define CANDAS_HAVE_THREADS 0
+#endif
+
+#if !defined(CANDAS_NO_SIMD) && (defined(__SSE2__) || defined(__AVX2__))
+#include <immintrin.h>
+#endif
+
+// filter kernels: AVX2 version is compiled with target attribute and chosen at runtime (x86 GCC / Clang)
+#if !defined(CANDAS_NO_SIMD) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CANDAS_HAVE_AVX2_DISPATCH 1
+#else
+#define CANDAS_HAVE_AVX2_DISPATCH 0
+#endif
+
+#define MAX_COL_NUM 16 // size of column name arrays in examples, dataframes have any number of columns
+#ifndef MAX_COL_LEN
+#define MAX_COL_LEN 32 // column name width including '\0', define before including Candas.h for longer names
+#endif
 #define MAX_LINE_LEN 1024
 
 #define MISS_INT -999
 #define MISS_DOUBLE -999.999
 #define MISS_CHAR ' '
+#define MISS_INT8 INT8_MIN // -999 does not fit
+#define MISS_INT16 -999
+#define MISS_INT64 -999
+#define MISS_UINT32 UINT32_MAX // -999 does not fit
+#define MISS_FLOAT -999.999f
+#define MISS_STR -1 // code of missing string
+#define CAN_NULL_TOKEN "NA" // csv text of a null value, written by can_write_csv* and read back as null
+
+#define CAN_ALIGN 64 // alignment of dataframe blocks and columns (cache line)
+
+// smallest csv chunk worth a thread of can_read_csv_parallel, define before including Candas.h to change it
+#ifndef CAN_CSV_MIN_CHUNK
+#define CAN_CSV_MIN_CHUNK (64 * 1024)
+#endif
+
+#define CAN_POOL_MIN_SIZE 64           // smallest size class of pool allocator
+#define CAN_POOL_N_CLASS 11            // size classes 64 bytes ~ 64 KB, larger blocks go to malloc
+#define CAN_POOL_SLAB (256 * 1024)     // bytes taken from malloc at a time to refill a size class
+
+// allocator of the current thread is thread local where C11 is available (threads always imply C11)
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define CAN_THREAD_LOCAL _Thread_local
+#else
+#define CAN_THREAD_LOCAL
+#endif
+
+/// @brief memory backend of dataframes, built in: can_arena_new / can_pool_new, or fill in your own
+typedef struct can_allocator
+{
+    void *(*alloc)(void *ctx, size_t size); // CAN_ALIGN aligned memory of size bytes, NULL if out of memory
+    void (*free)(void *ctx, void *p);       // give back memory of alloc
+    void (*release)(void *ctx);             // free everything of ctx, called by can_allocator_free
+    void *ctx;
+} can_allocator;
+
+/// @brief min / max of the non-null values of every block of rows of a column, lets filters skip or take whole blocks
+typedef struct
+{
+    int n_block;
+    double *min;           // min of block (int / char stored exactly, NaN ignored)
+    double *max;           // max of block (null rows skipped, min > max if all rows are null)
+    unsigned char *has_nan; // 1 if block has NaN (block can never match entirely)
+} can_zone_map;
+
+/// @brief distinct strings of a string column, a row stores the int code of its string
+/// (append only, so dataframes derived from one column share it and their codes stay valid)
+typedef struct
+{
+    int n_str;        // number of strings, codes are 0 .. n_str - 1
+    int cap_str;      // capacity of offsets
+    size_t *offsets;  // offset of every string in arena
+    char *arena;      // strings back to back, '\0' terminated
+    size_t arena_len; // bytes used of arena
+    size_t arena_cap; // bytes of arena
+    int *slots;       // string -> code (open addressing, -1 empty), power of 2 >= 2 * n_str
+    int n_slot;       // slots of hash table
+    int refs;         // number of columns sharing this dictionary
+} can_dict;
+
+/// @brief sorted secondary index of a column (see can_create_index), filters binary search it instead of scanning
+typedef struct
+{
+    int n;          // number of rows when built
+    int stale;      // 1 if values changed after build, rebuilt by the next filter that uses it
+    int *perm;      // row numbers in ascending value order (stable, NaN last)
+    uint64_t *keys; // normalized sort key of every entry of perm (see can_load_sort_keys), ascending
+} can_index;
 
 typedef struct
 {
     int n_row;
     int n_col;
-    char dtypes[MAX_COL_NUM];
-    char cols[MAX_COL_NUM][MAX_COL_LEN];
-    void *values[MAX_COL_NUM];
+    int capacity; // rows every column can hold without growing (>= n_row), see can_reserve / can_append_row
+    char *dtypes;              // data type of every column, n_col ('\0' terminated)
+    char (*cols)[MAX_COL_LEN]; // name of every column, n_col
+    void **values;             // values of every column, n_col
+    int *col_hash;             // column name -> column index (open addressing, -1 empty), see can_find_col
+    int col_hash_size;         // slots of col_hash, power of 2 >= 2 * n_col
+    int col_hash_ready;        // 1 if col_hash is built
+    const char *mapping; // file mapping of read-only dataframe (can_load_binary), NULL if values are owned
+    size_t mapping_len;  // length of file mapping
+    int zone_rows;       // rows per zone map block, 0 if zone maps are disabled (see can_enable_zone_maps)
+    can_zone_map **zones; // zone map of every column, built lazily by filters, NULL if not built or invalidated
+    can_index **indexes;  // sorted index of every column, NULL if none (see can_create_index)
+    can_dict **dicts;     // string dictionary of every 'S' column, NULL if none yet (no string stored)
+    uint64_t **valid;     // validity bitmap of every column (bit set = not null, also past n_row), NULL if no null
+    can_allocator *allocator; // backend that owns this dataframe, NULL means malloc / free
+    size_t block_len;         // bytes of the block holding this struct and its columns (columns outside were regrown)
+    int arena_slot;           // index in the frame list of its arena (see can_arena_reset), -1 if not from an arena
 } can_dataframe;
 
+/// @brief column resolved once by name, for unchecked fast access by can_hget_* / can_hset_*
+typedef struct
+{
+    int col;    // column index
+    char dtype; // data type
+} can_col_handle;
+
+/// @brief rows of a parent dataframe selected by filters, without copying data (see can_view_of)
+typedef struct
+{
+    const can_dataframe *parent; // parent dataframe, must outlive the view
+    int n_sel;                   // number of selected rows
+    int *sel;                    // selected row numbers of parent in ascending order, NULL means all rows
+} can_view;
+
+#define CAN_PRED_RANGE 0 // min <= col <= max (also equality)
+#define CAN_PRED_IN 1    // col in set
+#define CAN_PRED_AND 2
+#define CAN_PRED_OR 3
+#define CAN_PRED_NOT 4
+#define CAN_PRED_NULL 5 // col is null
+
+#define CAN_PRED_CHUNK 4096 // rows evaluated at a time by can_filter
+
+#define CAN_INDEX_SCAN_RATIO 8 // filters scan instead of using an index when more than 1 / 8 of rows match
+
+/// @brief node of compound filter predicate, built by can_pred_* and evaluated by can_filter
+typedef struct can_pred
+{
+    int op;                // CAN_PRED_*
+    char col[MAX_COL_LEN]; // column of leaf
+    char dtype;            // data type of leaf column ('l' matches every integer column, 'D' also float, 'S' string)
+    double min;            // range of CAN_PRED_RANGE (int / char stored exactly)
+    double max;
+    int n_set;             // number of values of CAN_PRED_IN
+    void *set;             // values of CAN_PRED_IN (sorted for int / double, '\0' terminated one after another for string)
+    struct can_pred *a;    // operands of AND / OR / NOT
+    struct can_pred *b;
+} can_pred;
+
+#define CAN_QUERY_SELECT 0
+#define CAN_QUERY_FILTER 1
+#define CAN_QUERY_SORT 2
+#define CAN_QUERY_MERGE 3
+#define CAN_QUERY_LIMIT 4
+
+/// @brief one recorded step of a lazy query
+typedef struct
+{
+    int op;                      // CAN_QUERY_*
+    int n_col;                   // number of columns of select / keys of sort / 1 for merge
+    char (*cols)[MAX_COL_LEN];   // columns of select / keys of sort / key of merge (owned)
+    int *ascending;              // order of sort keys (owned)
+    can_pred *pred;              // predicate of filter (owned)
+    const can_dataframe *right;  // right dataframe of merge
+    int limit;                   // max number of rows of limit
+} can_query_step;
+
+/// @brief lazy query on a dataframe, steps are recorded by can_query_* and planned / run by can_query_collect
+typedef struct
+{
+    const can_dataframe *df; // source dataframe, must outlive the query
+    int n_step;
+    int cap_step;
+    can_query_step *steps;
+} can_query;
+
+#define CAN_AGG_SUM 0
+#define CAN_AGG_MEAN 1
+#define CAN_AGG_COUNT 2
+#define CAN_AGG_MIN 3
+#define CAN_AGG_MAX 4
+#define CAN_AGG_VAR 5
+#define CAN_AGG_FIRST 6
+#define CAN_AGG_LAST 7
+
+/// @brief one aggregation of can_groupby_agg
+typedef struct
+{
+    int op;                 // CAN_AGG_*
+    char col[MAX_COL_LEN];  // aggregated column, "" only for CAN_AGG_COUNT (counts rows)
+    char name[MAX_COL_LEN]; // output column name, "" means "<col>_<op>" e.g. "E_mean"
+} can_agg_spec;
+
+#define CAN_ENC_PLAIN 0 // raw values
+#define CAN_ENC_RLE 1   // run length: value and end row of every run
+#define CAN_ENC_FOR 2   // frame of reference: value - min, bit packed
+#define CAN_ENC_DELTA 3 // difference to previous row - min difference, bit packed, restarted every block
+
+#define CAN_ENC_BLOCK 1024 // rows per block of FOR / DELTA column (block min / max let filters skip or take it)
+
+/// @brief one encoded column of can_compressed
+typedef struct
+{
+    int enc;              // CAN_ENC_*
+    char dtype;           // data type of decoded values
+    void *values;         // PLAIN: value of every row, RLE: value of every run
+    int n_run;            // RLE: number of runs
+    int *run_end;         // RLE: end row (exclusive) of every run
+    int64_t ref;          // FOR: min value, DELTA: min difference
+    int width;            // FOR / DELTA: bits per packed value, 0 if all equal
+    uint64_t *bits;       // FOR / DELTA: packed values, value of row i at bit i * width
+    int64_t *block_min;   // FOR / DELTA: min value of every block
+    int64_t *block_max;   // FOR / DELTA: max value of every block
+    int64_t *block_first; // DELTA: value of first row of every block
+    size_t bytes;         // memory of encoded column
+} can_enc_col;
+
+/// @brief dataframe whose columns are encoded in memory (see can_compress),
+/// filtered and aggregated on the encoded values where the encoding allows it
+typedef struct
+{
+    int n_row;
+    int n_col;
+    char *dtypes;              // data type of every column, n_col ('\0' terminated)
+    char (*cols)[MAX_COL_LEN]; // name of every column, n_col
+    can_enc_col *encs;         // encoded values of every column, n_col
+    can_dict **dicts;          // string dictionary of every 'S' column (shared with source), NULL otherwise
+    uint64_t **valid;          // validity bitmap of every column (copied), NULL if no null
+} can_compressed;
+
+/// @brief csv file opened for reading in batches, see can_csv_reader_open
+typedef struct
+{
+    FILE *fp;
+    char *buf;         // file buffer
+    size_t buf_cap;    // capacity of file buffer
+    size_t buf_len;    // number of bytes in file buffer
+    size_t pos;        // first byte not parsed yet
+    int eof;           // 1 if whole file is in buffer
+    long line_no;      // number of lines parsed (for warnings)
+    int n_col;
+    char *dtypes;              // data type of every column, n_col
+    char (*cols)[MAX_COL_LEN]; // name of every column, n_col
+    char *delim;
+} can_csv_reader;
+
 // BASIC USAGE ====================================================================================
 can_dataframe *can_alloc(int n_row, int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], void *values[MAX_COL_NUM]);
 void can_free(can_dataframe *df);
 
+can_allocator *can_arena_new(size_t chunk_size);
+void can_arena_reset(can_allocator *arena);
+can_allocator *can_pool_new(void);
+void can_allocator_free(can_allocator *a);
+can_allocator *can_set_allocator(can_allocator *a);
+
 can_dataframe *can_read_csv(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row);
+can_dataframe *can_read_csv_mmap(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row);
+can_dataframe *can_read_csv_parallel(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row, int n_thread);
+can_csv_reader *can_csv_reader_open(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row);
+can_dataframe *can_csv_reader_next_batch(can_csv_reader *rd, int max_rows, can_dataframe *reuse);
+void can_csv_reader_close(can_csv_reader *rd);
 void can_write_csv(const char file[MAX_LINE_LEN], const can_dataframe *df, const char *delim);
+void can_write_csv_buffered(const char file[MAX_LINE_LEN], const can_dataframe *df, const char *delim, int precision, int banner);
+void can_save_binary(const char file[MAX_LINE_LEN], const can_dataframe *df);
+can_dataframe *can_load_binary(const char file[MAX_LINE_LEN]);
 void can_print(const can_dataframe *df, int n_row);
 
 int can_get_int(const can_dataframe *df, int row, char col[MAX_COL_LEN]);
 double can_get_double(const can_dataframe *df, int row, char col[MAX_COL_LEN]);
 char can_get_char(const can_dataframe *df, int row, char col[MAX_COL_LEN]);
+int64_t can_get_int64(const can_dataframe *df, int row, char col[MAX_COL_LEN]);
+const char *can_get_str(const can_dataframe *df, int row, char col[MAX_COL_LEN]);
 
 void can_set_int(can_dataframe *df, int row, char col[MAX_COL_LEN], int value);
 void can_set_double(can_dataframe *df, int row, char col[MAX_COL_LEN], double value);
 void can_set_char(can_dataframe *df, int row, char col[MAX_COL_LEN], char value);
+void can_set_int64(can_dataframe *df, int row, char col[MAX_COL_LEN], int64_t value);
+void can_set_str(can_dataframe *df, int row, char col[MAX_COL_LEN], const char *value);
+
+int can_is_null(const can_dataframe *df, int row, char col[MAX_COL_LEN]);
+void can_set_null(can_dataframe *df, int row, char col[MAX_COL_LEN]);
+int can_null_count(const can_dataframe *df, char col[MAX_COL_LEN]);
+
+can_col_handle can_get_col_handle(const can_dataframe *df, char col[MAX_COL_LEN]);
+static inline int can_hget_int(const can_dataframe *df, can_col_handle h, int row);
+static inline double can_hget_double(const can_dataframe *df, can_col_handle h, int row);
+static inline char can_hget_char(const can_dataframe *df, can_col_handle h, int row);
+static inline int64_t can_hget_int64(const can_dataframe *df, can_col_handle h, int row);
+static inline void can_hset_int(can_dataframe *df, can_col_handle h, int row, int value);
+static inline void can_hset_double(can_dataframe *df, can_col_handle h, int row, double value);
+static inline void can_hset_char(can_dataframe *df, can_col_handle h, int row, char value);
+static inline void can_hset_int64(can_dataframe *df, can_col_handle h, int row, int64_t value);
 
 int *can_get_int_pointer(can_dataframe *df, char col[MAX_COL_LEN]);
 double *can_get_double_pointer(can_dataframe *df, char col[MAX_COL_LEN]);
 char *can_get_char_pointer(can_dataframe *df, char col[MAX_COL_LEN]);
+void *can_get_pointer(can_dataframe *df, char col[MAX_COL_LEN], char dtype);
+void can_mark_modified(can_dataframe *df, const char *col);
+
+void can_enable_zone_maps(can_dataframe *df, int block_rows);
+void can_create_index(can_dataframe *df, char col[MAX_COL_LEN]);
+void can_drop_index(can_dataframe *df, char col[MAX_COL_LEN]);
 
 // Higher Manipulation ============================================================================
 can_dataframe *can_select_col(const can_dataframe *df, char col[MAX_COL_LEN]);
@@ -74,1485 +372,9835 @@ can_dataframe *can_select_rows(const can_dataframe *df, int n_row, int *rows);
 
 can_dataframe *can_filter_double(const can_dataframe *df, char col[MAX_COL_LEN], double min, double max);
 can_dataframe *can_filter_int(const can_dataframe *df, char col[MAX_COL_LEN], int min, int max);
+can_dataframe *can_filter_int64(const can_dataframe *df, char col[MAX_COL_LEN], int64_t min, int64_t max);
 can_dataframe *can_filter_char(const can_dataframe *df, char col[MAX_COL_LEN], char min, char max);
+can_dataframe *can_filter_str(const can_dataframe *df, char col[MAX_COL_LEN], const char *value);
+
+can_pred *can_pred_range_double(char col[MAX_COL_LEN], double min, double max);
+can_pred *can_pred_range_int(char col[MAX_COL_LEN], int min, int max);
+can_pred *can_pred_range_int64(char col[MAX_COL_LEN], int64_t min, int64_t max);
+can_pred *can_pred_range_char(char col[MAX_COL_LEN], char min, char max);
+can_pred *can_pred_eq_double(char col[MAX_COL_LEN], double value);
+can_pred *can_pred_eq_int(char col[MAX_COL_LEN], int value);
+can_pred *can_pred_eq_int64(char col[MAX_COL_LEN], int64_t value);
+can_pred *can_pred_eq_char(char col[MAX_COL_LEN], char value);
+can_pred *can_pred_ne_double(char col[MAX_COL_LEN], double value);
+can_pred *can_pred_ne_int(char col[MAX_COL_LEN], int value);
+can_pred *can_pred_ne_int64(char col[MAX_COL_LEN], int64_t value);
+can_pred *can_pred_ne_char(char col[MAX_COL_LEN], char value);
+can_pred *can_pred_in_double(char col[MAX_COL_LEN], int n, const double *values);
+can_pred *can_pred_in_int(char col[MAX_COL_LEN], int n, const int *values);
+can_pred *can_pred_in_int64(char col[MAX_COL_LEN], int n, const int64_t *values);
+can_pred *can_pred_in_char(char col[MAX_COL_LEN], int n, const char *values);
+can_pred *can_pred_eq_str(char col[MAX_COL_LEN], const char *value);
+can_pred *can_pred_ne_str(char col[MAX_COL_LEN], const char *value);
+can_pred *can_pred_in_str(char col[MAX_COL_LEN], int n, const char *const *values);
+can_pred *can_pred_and(can_pred *a, can_pred *b);
+can_pred *can_pred_or(can_pred *a, can_pred *b);
+can_pred *can_pred_is_null(char col[MAX_COL_LEN]);
+can_pred *can_pred_not(can_pred *a);
+void can_pred_free(can_pred *p);
+can_dataframe *can_filter(const can_dataframe *df, const can_pred *p);
+
+can_view *can_view_of(const can_dataframe *df);
+void can_view_filter_double(can_view *v, char col[MAX_COL_LEN], double min, double max);
+void can_view_filter_int(can_view *v, char col[MAX_COL_LEN], int min, int max);
+void can_view_filter_char(can_view *v, char col[MAX_COL_LEN], char min, char max);
+can_dataframe *can_view_materialize(const can_view *v, int n_col, char cols[MAX_COL_NUM][MAX_COL_LEN]);
+void can_view_free(can_view *v);
 
 can_dataframe *can_concat_row(const can_dataframe *df1, const can_dataframe *df2);
 can_dataframe *can_concat_col(const can_dataframe *df1, const can_dataframe *df2);
+can_dataframe *can_concat_rows_n(int n, can_dataframe *const frames[]);
+can_dataframe *can_concat_rows_n_parallel(int n, can_dataframe *const frames[], int n_thread);
+void can_reserve(can_dataframe *df, int n_row);
+void can_append_row(can_dataframe *df, ...);
+void can_append_frame(can_dataframe *dst, const can_dataframe *src);
 
 can_dataframe *can_merge_left(const can_dataframe *df1, const can_dataframe *df2, char key_col[MAX_COL_LEN]);
 
+int *can_argsort(const can_dataframe *df, char key_col[MAX_COL_LEN]);
 can_dataframe *can_sort(const can_dataframe *df, char key_col[MAX_COL_LEN]);
+int *can_argsort_by(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending);
+can_dataframe *can_sort_by(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending);
+int *can_argsort_by_nulls(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending, int nulls_last);
+can_dataframe *can_sort_by_nulls(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending, int nulls_last);
+
+can_dataframe *can_groupby_agg(const can_dataframe *df, int n_keys, char keys[MAX_COL_NUM][MAX_COL_LEN], int n_spec, const can_agg_spec *specs);
 
-// TODO
 can_dataframe *can_unique(const can_dataframe *df, char key_col[MAX_COL_LEN]);
+can_dataframe *can_drop_duplicates(const can_dataframe *df, int n_keys, char keys[MAX_COL_NUM][MAX_COL_LEN], int keep_last, int **counts);
+
+can_query *can_query_from(const can_dataframe *df);
+void can_query_select(can_query *q, int n_col, char cols[MAX_COL_NUM][MAX_COL_LEN]);
+void can_query_filter(can_query *q, can_pred *p);
+void can_query_sort_by(can_query *q, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending);
+void can_query_merge_left(can_query *q, const can_dataframe *df2, char key_col[MAX_COL_LEN]);
+void can_query_limit(can_query *q, int n_row);
+can_dataframe *can_query_collect(can_query *q);
+void can_query_free(can_query *q);
+
+can_compressed *can_compress(const can_dataframe *df);
+can_dataframe *can_decompress(const can_compressed *cf);
+int can_compressed_encoding(const can_compressed *cf, char col[MAX_COL_LEN]);
+size_t can_compressed_bytes(const can_compressed *cf);
+can_dataframe *can_compressed_filter(const can_compressed *cf, const can_pred *p);
+double can_compressed_agg(const can_compressed *cf, char col[MAX_COL_LEN], int op);
+void can_compressed_free(can_compressed *cf);
 
 // BELOW IS IMPLEMENTATION ========================================================================
 
-/// @brief init and alloc memory for can_dataframe
-/// @param n_row  I number of rows (can reserve empty rows)
-/// @param n_col  I number of cols (must be exact)
-/// @param cols   I column names
-/// @param dtypes I data types, e.g. "IDDC" means 4 cols with int, double, double, char
-/// @param values I init values of columns (deep copy, only n_row), set NULL (not {NULL}) to do only malloc
-/// @return
-can_dataframe *can_alloc(int n_row, int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], void *values[MAX_COL_NUM])
+/// @brief helper function, size in bytes of one value of dtype
+/// @param dtype I data type 'I'/'D'/'C'/'b'/'h'/'l'/'u'/'f'/'S'
+/// @return size in bytes
+static inline size_t can_dtype_size(char dtype)
 {
-    can_dataframe *df = (can_dataframe *)calloc(1, sizeof(can_dataframe));
-    if (df == NULL)
+    switch (dtype)
     {
-        fprintf(stderr, "ERORR: can_alloc cannot alloc memory\n");
-        exit(EXIT_FAILURE);
+    case 'I':
+    case 'S':
+        return sizeof(int);
+    case 'D':
+        return sizeof(double);
+    case 'b':
+        return sizeof(int8_t);
+    case 'h':
+        return sizeof(int16_t);
+    case 'l':
+        return sizeof(int64_t);
+    case 'u':
+        return sizeof(uint32_t);
+    case 'f':
+        return sizeof(float);
     }
+    return sizeof(char);
+}
 
-    if (n_row < 0)
+/// @brief helper function, whether dtype is a known data type
+/// @param dtype I data type
+/// @return 1 if known, 0 otherwise
+static inline int can_dtype_valid(char dtype)
+{
+    return dtype != '\0' && strchr("IDCbhlufS", dtype) != NULL;
+}
+
+/// @brief helper function, whether dtype is an integer type 'I'/'b'/'h'/'l'/'u' (char is not)
+/// @param dtype I data type
+/// @return 1 if integer type, 0 otherwise
+static inline int can_dtype_is_int(char dtype)
+{
+    return dtype == 'I' || dtype == 'b' || dtype == 'h' || dtype == 'l' || dtype == 'u';
+}
+
+/// @brief helper function, whether a column of dtype can be used where type of want is asked,
+/// int64 'l' stands for every integer type and double 'D' for both floating types
+/// @param dtype I data type of column
+/// @param want  I asked data type
+/// @return 1 if accepted, 0 otherwise
+static inline int can_dtype_accepts(char dtype, char want)
+{
+    return dtype == want || (want == 'l' && can_dtype_is_int(dtype)) || (want == 'D' && dtype == 'f');
+}
+
+/// @brief helper function, value of row i as int64 (integer types, char and string code)
+/// @param vs    I values
+/// @param dtype I data type
+/// @param i     I row
+/// @return value
+static inline int64_t can_value_as_int64(const void *vs, char dtype, int i)
+{
+    switch (dtype)
     {
-        fprintf(stderr, "ERROR: can_alloc n_row < 0\n");
-        exit(EXIT_FAILURE);
+    case 'I':
+    case 'S':
+        return ((const int *)vs)[i];
+    case 'b':
+        return ((const int8_t *)vs)[i];
+    case 'h':
+        return ((const int16_t *)vs)[i];
+    case 'l':
+        return ((const int64_t *)vs)[i];
+    case 'u':
+        return ((const uint32_t *)vs)[i];
     }
-    df->n_row = n_row;
+    return ((const char *)vs)[i];
+}
 
-    if (n_col <= 0)
+/// @brief helper function, value of row i as double (int64 beyond 2^53 is rounded)
+/// @param vs    I values
+/// @param dtype I data type
+/// @param i     I row
+/// @return value
+static inline double can_value_as_double(const void *vs, char dtype, int i)
+{
+    if (dtype == 'D')
     {
-        fprintf(stderr, "ERROR: can_alloc n_col <= 0\n");
-        exit(EXIT_FAILURE);
+        return ((const double *)vs)[i];
     }
-    df->n_col = n_col;
+    else if (dtype == 'f')
+    {
+        return ((const float *)vs)[i];
+    }
+    return (double)can_value_as_int64(vs, dtype, i);
+}
 
-    for (int j = 0; j < n_col; j++)
+/// @brief helper function, store integer at row i (converted like a C cast)
+/// @param vs    IO values
+/// @param dtype I  data type
+/// @param i     I  row
+/// @param v     I  value
+static inline void can_value_set_int64(void *vs, char dtype, int i, int64_t v)
+{
+    switch (dtype)
     {
-        if (strlen(cols[j]) >= MAX_COL_LEN)
-        {
-            fprintf(stderr, "WARNING: can_alloc col name %s exceed MAX_COL_LEN = %d, col name will be cut\n", cols[j], MAX_COL_LEN);
-        }
-        strncpy(df->cols[j], cols[j], MAX_COL_LEN);
+    case 'I':
+    case 'S':
+        ((int *)vs)[i] = (int)v;
+        break;
+    case 'b':
+        ((int8_t *)vs)[i] = (int8_t)v;
+        break;
+    case 'h':
+        ((int16_t *)vs)[i] = (int16_t)v;
+        break;
+    case 'l':
+        ((int64_t *)vs)[i] = v;
+        break;
+    case 'u':
+        ((uint32_t *)vs)[i] = (uint32_t)v;
+        break;
+    case 'D':
+        ((double *)vs)[i] = (double)v;
+        break;
+    case 'f':
+        ((float *)vs)[i] = (float)v;
+        break;
+    default:
+        ((char *)vs)[i] = (char)v;
+        break;
+    }
+}
+
+/// @brief helper function, store MISS_* of dtype at row i
+/// @param vs    IO values
+/// @param dtype I  data type
+/// @param i     I  row
+static inline void can_value_set_missing(void *vs, char dtype, int i)
+{
+    switch (dtype)
+    {
+    case 'I':
+        ((int *)vs)[i] = MISS_INT;
+        break;
+    case 'S':
+        ((int *)vs)[i] = MISS_STR;
+        break;
+    case 'D':
+        ((double *)vs)[i] = MISS_DOUBLE;
+        break;
+    case 'b':
+        ((int8_t *)vs)[i] = MISS_INT8;
+        break;
+    case 'h':
+        ((int16_t *)vs)[i] = MISS_INT16;
+        break;
+    case 'l':
+        ((int64_t *)vs)[i] = MISS_INT64;
+        break;
+    case 'u':
+        ((uint32_t *)vs)[i] = MISS_UINT32;
+        break;
+    case 'f':
+        ((float *)vs)[i] = MISS_FLOAT;
+        break;
+    default:
+        ((char *)vs)[i] = MISS_CHAR;
+        break;
+    }
+}
+
+/// @brief helper function, whether row i holds MISS_* of dtype
+/// @param vs    I values
+/// @param dtype I data type
+/// @param i     I row
+/// @return 1 if missing, 0 otherwise
+static inline int can_value_is_missing(const void *vs, char dtype, int i)
+{
+    switch (dtype)
+    {
+    case 'D':
+        return ((const double *)vs)[i] == MISS_DOUBLE;
+    case 'f':
+        return ((const float *)vs)[i] == MISS_FLOAT;
+    case 'C':
+        return ((const char *)vs)[i] == MISS_CHAR;
+    case 'b':
+        return ((const int8_t *)vs)[i] == MISS_INT8;
+    case 'h':
+        return ((const int16_t *)vs)[i] == MISS_INT16;
+    case 'l':
+        return ((const int64_t *)vs)[i] == MISS_INT64;
+    case 'u':
+        return ((const uint32_t *)vs)[i] == MISS_UINT32;
+    case 'S':
+        return ((const int *)vs)[i] == MISS_STR;
+    }
+    return ((const int *)vs)[i] == MISS_INT;
+}
+
+/// @brief helper function, integer range [lo, hi] of type range [tmin, tmax] inside double range [min, max]
+/// @param min  I min value
+/// @param max  I max value
+/// @param tmin I smallest value of integer type
+/// @param tmax I largest value of integer type
+/// @param lo   O smallest integer >= min
+/// @param hi   O largest integer <= max
+/// @return 1 if not empty, 0 if no integer of the type is in range (also NaN bounds)
+static inline int can_int_range(double min, double max, int64_t tmin, int64_t tmax, int64_t *lo, int64_t *hi)
+{
+    // 2^63 is the first double past INT64_MAX, doubles beyond 2^52 are integers so casts below are exact
+    if (!(min <= max) || min >= 9223372036854775808.0 || max < -9223372036854775808.0)
+    {
+        return 0;
+    }
+    int64_t c = INT64_MIN, f = INT64_MAX;
+    if (min > -9223372036854775808.0)
+    {
+        c = (int64_t)min; // toward zero, then up to ceil
+        c += (double)c < min;
+    }
+    if (max < 9223372036854775808.0)
+    {
+        f = (int64_t)max; // toward zero, then down to floor
+        f -= (double)f > max;
+    }
+    *lo = c > tmin ? c : tmin;
+    *hi = f < tmax ? f : tmax;
+    return *lo <= *hi;
+}
+
+/// @brief helper function, next double after v toward +inf (up = 1) or -inf (up = 0), like nextafter without libm
+/// @param v  I value, not NaN
+/// @param up I direction
+/// @return neighbor of v
+static inline double can_double_step(double v, int up)
+{
+    if (v == 0.0)
+    {
+        return up ? DBL_TRUE_MIN : -DBL_TRUE_MIN;
+    }
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(double));
+    bits = (v > 0.0) == (up != 0) ? bits + 1 : bits - 1; // magnitude grows away from zero
+    memcpy(&v, &bits, sizeof(double));
+    return v;
+}
+
+/// @brief helper function, next float after v toward +inf (up = 1) or -inf (up = 0), like nextafterf without libm
+/// @param v  I value, not NaN
+/// @param up I direction
+/// @return neighbor of v
+static inline float can_float_step(float v, int up)
+{
+    if (v == 0.0f)
+    {
+        return up ? FLT_TRUE_MIN : -FLT_TRUE_MIN;
+    }
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(float));
+    bits = (v > 0.0f) == (up != 0) ? bits + 1 : bits - 1;
+    memcpy(&v, &bits, sizeof(float));
+    return v;
+}
+
+/// @brief helper function, smallest and largest value of integer dtype
+/// @param dtype I integer data type, 'C' or 'S' (codes)
+/// @param tmin  O smallest value
+/// @param tmax  O largest value
+static inline void can_int_limits(char dtype, int64_t *tmin, int64_t *tmax)
+{
+    switch (dtype)
+    {
+    case 'I':
+    case 'S':
+        *tmin = INT_MIN;
+        *tmax = INT_MAX;
+        break;
+    case 'b':
+        *tmin = INT8_MIN;
+        *tmax = INT8_MAX;
+        break;
+    case 'h':
+        *tmin = INT16_MIN;
+        *tmax = INT16_MAX;
+        break;
+    case 'l':
+        *tmin = INT64_MIN;
+        *tmax = INT64_MAX;
+        break;
+    case 'u':
+        *tmin = 0;
+        *tmax = UINT32_MAX;
+        break;
+    default:
+        *tmin = CHAR_MIN;
+        *tmax = CHAR_MAX;
+        break;
+    }
+}
+
+/// @brief helper function, FNV-1a hash of column name
+/// @param name I column name
+/// @return hash value
+static inline uint32_t can_hash_str(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < MAX_COL_LEN && name[i] != '\0'; i++)
+    {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
 
-        if (dtypes[j] == 'I' || dtypes[j] == 'D' || dtypes[j] == 'C')
+/// @brief helper function, build column name hash table of df (first column wins for duplicated names)
+/// @param df IO dataframe
+static void can_build_col_hash(can_dataframe *df)
+{
+    memset(df->col_hash, -1, sizeof(int) * df->col_hash_size);
+    for (int j = 0; j < df->n_col; j++)
+    {
+        uint32_t slot = can_hash_str(df->cols[j]) & (df->col_hash_size - 1);
+        while (df->col_hash[slot] >= 0 && strncmp(df->cols[df->col_hash[slot]], df->cols[j], MAX_COL_LEN) != 0)
         {
-            df->dtypes[j] = dtypes[j];
+            slot = (slot + 1) & (df->col_hash_size - 1);
         }
-        else
+        if (df->col_hash[slot] < 0)
         {
-            fprintf(stderr, "ERROR: dtype must be 'I'(int) or 'D'(double) or 'C'(char)\n");
-            exit(EXIT_FAILURE);
+            df->col_hash[slot] = j;
         }
+    }
+    df->col_hash_ready = 1;
+}
 
-        if (dtypes[j] == 'I')
+/// @brief helper function, find column index by name (one hash probe and one strcmp instead of scanning all names)
+/// @param df  I dataframe
+/// @param col I column name
+/// @return column index, -1 if not found
+static inline int can_find_col(const can_dataframe *df, const char *col)
+{
+    if (df->col_hash_ready)
+    {
+        uint32_t slot = can_hash_str(col) & (df->col_hash_size - 1);
+        while (df->col_hash[slot] >= 0)
         {
-            df->values[j] = (int *)malloc(sizeof(int) * n_row);
-            if (df->values[j] == NULL)
+            int j = df->col_hash[slot];
+            if (strncmp(col, df->cols[j], MAX_COL_LEN) == 0)
             {
-                fprintf(stderr, "ERORR: can_alloc cannot alloc memory\n");
-                exit(EXIT_FAILURE);
-            }
-            if (values != NULL)
-            {
-                memcpy(df->values[j], values[j], sizeof(int) * n_row);
+                return j;
             }
+            slot = (slot + 1) & (df->col_hash_size - 1);
+        }
+        return -1;
+    }
+    // dataframe not made by can_alloc, e.g. filled by hand
+    for (int j = 0; j < df->n_col; j++)
+    {
+        if (strncmp(col, df->cols[j], MAX_COL_LEN) == 0)
+        {
+            return j;
+        }
+    }
+    return -1;
+}
+
+/// @brief helper function, gather values of a column by row index: dst[i] = src[idx[i]],
+/// idx[i] = -1 means no source row, dst[i] will be MISS_INT / MISS_DOUBLE / MISS_CHAR
+/// @param dst   O destination column (n values)
+/// @param src   I source column
+/// @param dtype I data type of both columns
+/// @param idx   I row index in src of every dst row
+/// @param n     I number of values
+static void can_gather_col(void *dst, const void *src, char dtype, const int *idx, int n)
+{
+    if (dtype == 'I')
+    {
+        int *d = (int *)dst;
+        const int *s = (const int *)src;
+        for (int i = 0; i < n; i++)
+        {
+            d[i] = idx[i] >= 0 ? s[idx[i]] : MISS_INT;
+        }
+    }
+    else if (dtype == 'D')
+    {
+        double *d = (double *)dst;
+        const double *s = (const double *)src;
+        for (int i = 0; i < n; i++)
+        {
+            d[i] = idx[i] >= 0 ? s[idx[i]] : MISS_DOUBLE;
+        }
+    }
+    else if (dtype == 'C')
+    {
+        char *d = (char *)dst;
+        const char *s = (const char *)src;
+        for (int i = 0; i < n; i++)
+        {
+            d[i] = idx[i] >= 0 ? s[idx[i]] : MISS_CHAR;
         }
-        else if (dtypes[j] == 'D')
+    }
+    else
+    {
+        // other types are moved as raw values of their size
+        size_t size = can_dtype_size(dtype);
+        uint64_t miss_bits = 0;
+        can_value_set_missing(&miss_bits, dtype, 0);
+        if (size == 1)
         {
-            df->values[j] = (double *)malloc(sizeof(double) * n_row);
-            if (df->values[j] == NULL)
+            uint8_t *d = (uint8_t *)dst, miss;
+            const uint8_t *s = (const uint8_t *)src;
+            memcpy(&miss, &miss_bits, size);
+            for (int i = 0; i < n; i++)
             {
-                fprintf(stderr, "ERORR: can_alloc cannot alloc memory\n");
-                exit(EXIT_FAILURE);
+                d[i] = idx[i] >= 0 ? s[idx[i]] : miss;
             }
-            if (values != NULL)
+        }
+        else if (size == 2)
+        {
+            uint16_t *d = (uint16_t *)dst, miss;
+            const uint16_t *s = (const uint16_t *)src;
+            memcpy(&miss, &miss_bits, size);
+            for (int i = 0; i < n; i++)
             {
-                memcpy(df->values[j], values[j], sizeof(double) * n_row);
+                d[i] = idx[i] >= 0 ? s[idx[i]] : miss;
             }
         }
-        else if (dtypes[j] == 'C')
+        else if (size == 4)
         {
-            df->values[j] = (char *)malloc(sizeof(char) * n_row);
-            if (df->values[j] == NULL)
+            uint32_t *d = (uint32_t *)dst, miss;
+            const uint32_t *s = (const uint32_t *)src;
+            memcpy(&miss, &miss_bits, size);
+            for (int i = 0; i < n; i++)
             {
-                fprintf(stderr, "ERORR: can_alloc cannot alloc memory\n");
-                exit(EXIT_FAILURE);
+                d[i] = idx[i] >= 0 ? s[idx[i]] : miss;
             }
-            if (values != NULL)
+        }
+        else
+        {
+            uint64_t *d = (uint64_t *)dst;
+            const uint64_t *s = (const uint64_t *)src;
+            for (int i = 0; i < n; i++)
             {
-                memcpy(df->values[j], values[j], sizeof(char) * n_row);
+                d[i] = idx[i] >= 0 ? s[idx[i]] : miss_bits;
             }
         }
     }
-    return df;
 }
 
-/// @brief free dataframe, free the values in it and set n_row = 0
-/// @param df IO dataframe to be freed
-void can_free(can_dataframe *df)
+/// @brief helper function, new empty string dictionary
+/// @return dictionary with one reference (release by can_dict_release)
+static can_dict *can_dict_new(void)
 {
-    for (int j = 0; j < df->n_col; j++)
+    can_dict *d = (can_dict *)calloc(1, sizeof(can_dict));
+    if (d == NULL)
     {
-        free(df->values[j]);
+        fprintf(stderr, "ERROR: can_dict_new cannot alloc memory\n");
+        exit(EXIT_FAILURE);
     }
-    df->n_row = 0;
+    d->n_slot = 16;
+    d->slots = (int *)malloc(sizeof(int) * d->n_slot);
+    if (d->slots == NULL)
+    {
+        fprintf(stderr, "ERROR: can_dict_new cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(d->slots, 0xff, sizeof(int) * d->n_slot); // all -1
+    d->refs = 1;
+    return d;
 }
 
-/// @brief read csv file to dataframe
-/// @param file     I csv filepath
-/// @param n_col    I number of columns
-/// @param cols     I column names
-/// @param dtypes   I column data types
-/// @param delim    I delimiters (internally use strtok)
-/// @param skip_row I number of header row to skip
-/// @return           dataframe
-can_dataframe *can_read_csv(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row)
+/// @brief helper function, drop one reference of dictionary, freed with the last one
+/// @param d IO dictionary, may be NULL
+static void can_dict_release(can_dict *d)
 {
-    FILE *fp = fopen(file, "r");
-    if (!fp)
+    if (d == NULL || --d->refs > 0)
     {
-        fprintf(stderr, "can_read_csv cannot open file %s", file);
-        exit(EXIT_FAILURE);
+        return;
     }
-    char line[MAX_LINE_LEN] = "";
+    free(d->offsets);
+    free(d->arena);
+    free(d->slots);
+    free(d);
+}
 
-    // count row
-    int n_row = 0;
-    for (int i = 0; i < skip_row; i++)
+/// @brief helper function, FNV-1a hash of string of len bytes
+static inline uint32_t can_dict_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
     {
-        fgets(line, MAX_LINE_LEN, fp);
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
     }
-    while (fgets(line, MAX_LINE_LEN, fp))
+    return h;
+}
+
+/// @brief helper function, string of code
+/// @param d    I dictionary
+/// @param code I code, 0 .. d->n_str - 1
+/// @return '\0' terminated string (valid until the dictionary is freed)
+static inline const char *can_dict_str(const can_dict *d, int code)
+{
+    return d->arena + d->offsets[code];
+}
+
+/// @brief helper function, slot of string s in hash table of d (slot of its code, or the empty slot to insert it)
+static inline int can_dict_slot(const can_dict *d, const char *s, size_t len)
+{
+    int slot = (int)(can_dict_hash(s, len) & (uint32_t)(d->n_slot - 1));
+    while (d->slots[slot] >= 0)
     {
-        n_row++;
+        const char *t = can_dict_str(d, d->slots[slot]);
+        if (strncmp(t, s, len) == 0 && t[len] == '\0')
+        {
+            break;
+        }
+        slot = (slot + 1) & (d->n_slot - 1);
     }
+    return slot;
+}
 
-    rewind(fp);
+/// @brief helper function, code of string s of len bytes
+/// @param d   I dictionary, may be NULL (empty)
+/// @param s   I string, need not be '\0' terminated
+/// @param len I length of s
+/// @return code, -1 if s is not in dictionary
+static inline int can_dict_find(const can_dict *d, const char *s, size_t len)
+{
+    return d == NULL ? -1 : d->slots[can_dict_slot(d, s, len)];
+}
 
-    // init dataframe
-    can_dataframe *df = can_alloc(n_row, n_col, cols, dtypes, NULL);
+/// @brief helper function, code of string s of len bytes, added to dictionary if new
+/// (not thread safe, do not add strings to a dictionary shared by dataframes used on other threads)
+/// @param d   IO dictionary
+/// @param s   I  string, need not be '\0' terminated
+/// @param len I  length of s
+/// @return code
+static int can_dict_intern(can_dict *d, const char *s, size_t len)
+{
+    int slot = can_dict_slot(d, s, len);
+    if (d->slots[slot] >= 0)
+    {
+        return d->slots[slot];
+    }
 
-    for (int i = 0; i < skip_row; i++)
+    // new string, append to arena
+    if (d->n_str == INT_MAX)
+    {
+        fprintf(stderr, "ERROR: can_dict_intern too many distinct strings\n");
+        exit(EXIT_FAILURE);
+    }
+    if (d->n_str == d->cap_str)
+    {
+        d->cap_str = d->cap_str > 0 ? (d->cap_str < INT_MAX / 2 ? d->cap_str * 2 : INT_MAX) : 16;
+        size_t *offsets = (size_t *)realloc(d->offsets, sizeof(size_t) * d->cap_str);
+        if (offsets == NULL)
+        {
+            fprintf(stderr, "ERROR: can_dict_intern cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        d->offsets = offsets;
+    }
+    if (d->arena_len + len + 1 > d->arena_cap)
     {
-        fgets(line, MAX_LINE_LEN, fp);
+        size_t cap = d->arena_cap > 0 ? d->arena_cap : 256;
+        while (cap < d->arena_len + len + 1)
+        {
+            cap *= 2;
+        }
+        char *arena = (char *)realloc(d->arena, cap);
+        if (arena == NULL)
+        {
+            fprintf(stderr, "ERROR: can_dict_intern cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        d->arena = arena;
+        d->arena_cap = cap;
     }
+    memcpy(d->arena + d->arena_len, s, len);
+    d->arena[d->arena_len + len] = '\0';
+    d->offsets[d->n_str] = d->arena_len;
+    d->arena_len += len + 1;
+    int code = d->n_str++;
+    d->slots[slot] = code;
 
-    for (int i = 0; i < df->n_row; i++)
+    // grow hash table when half full
+    if (2 * d->n_str > d->n_slot)
     {
-        fgets(line, MAX_LINE_LEN, fp);
-        char *pch = strtok(line, delim);
-        if (*pch == '\n') // empty line
+        int *slots = (int *)malloc(sizeof(int) * d->n_slot * 2);
+        if (slots == NULL)
         {
-            fprintf(stderr, "WARNING: can_read_csv detect empty line at line %d\n", i + 1 + skip_row);
-            continue;
+            fprintf(stderr, "ERROR: can_dict_intern cannot alloc memory\n");
+            exit(EXIT_FAILURE);
         }
-        for (int j = 0; j < df->n_col; j++)
+        free(d->slots);
+        d->slots = slots;
+        d->n_slot *= 2;
+        memset(d->slots, 0xff, sizeof(int) * d->n_slot);
+        for (int c = 0; c < d->n_str; c++)
         {
-            if (df->dtypes[j] == 'I')
-            {
-                if (pch == NULL)
-                {
-                    ((int *)(df->values[j]))[i] = MISS_INT;
-                }
-                else
-                {
-                    ((int *)(df->values[j]))[i] = atoi(pch);
-                }
-            }
-            else if (df->dtypes[j] == 'D')
-            {
-                if (pch == NULL)
-                {
-                    ((double *)(df->values[j]))[i] = MISS_DOUBLE;
-                }
-                else
-                {
-                    ((double *)(df->values[j]))[i] = atof(pch);
-                }
-            }
-            else if (df->dtypes[j] == 'C')
-            {
-                if (pch == NULL)
-                {
-                    ((char *)(df->values[j]))[i] = MISS_CHAR;
-                }
-                else
-                {
-                    ((char *)(df->values[j]))[i] = *pch;
-                }
-            }
-
-            pch = strtok(NULL, delim);
-
-            if (j == df->n_col - 1 && pch != NULL)
-            {
-                fprintf(stderr, "WARNING: can_read_csv encounter strange line at line %d\n", i + 1 + skip_row);
-            }
+            const char *t = can_dict_str(d, c);
+            d->slots[can_dict_slot(d, t, strlen(t))] = c;
         }
     }
-
-    fclose(fp);
-    return df;
+    return code;
 }
 
-void can_write_csv(const char file[MAX_LINE_LEN], const can_dataframe *df, const char *delim)
+/// @brief helper function, dictionary of string column j of df, an empty one is made if it has none yet
+/// @param df IO dataframe
+/// @param j  I  column index of 'S' column
+/// @return dictionary
+static can_dict *can_col_dict(can_dataframe *df, int j)
 {
-    FILE *fp = fopen(file, "w");
-    if (!fp)
+    if (df->dicts[j] == NULL)
     {
-        fprintf(stderr, "can_read_csv cannot open file %s", file);
-        exit(EXIT_FAILURE);
+        df->dicts[j] = can_dict_new();
     }
+    return df->dicts[j];
+}
 
-    fprintf(fp, "Dataframe (%d, %d) , dtypes: %s\n", df->n_row, df->n_col, df->dtypes);
+/// @brief helper function, let column j of df share dictionary d (old one released)
+/// @param df IO dataframe
+/// @param j  I  column index of 'S' column
+/// @param d  I  dictionary, may be NULL
+static void can_set_col_dict(can_dataframe *df, int j, can_dict *d)
+{
+    if (d != NULL)
+    {
+        d->refs++;
+    }
+    can_dict_release(df->dicts[j]);
+    df->dicts[j] = d;
+}
 
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, drop all strings of column j of df before its codes are overwritten
+/// (emptied in place when no other dataframe shares it, otherwise released so the sharers keep their strings)
+/// @param df IO dataframe
+/// @param j  I  column index of 'S' column
+static void can_col_dict_reset(can_dataframe *df, int j)
+{
+    can_dict *d = df->dicts[j];
+    if (d == NULL)
     {
-        fprintf(fp, "%s%s", df->cols[j], delim);
+        return;
     }
-    fprintf(fp, "\n");
+    if (d->refs > 1)
+    {
+        can_dict_release(d);
+        df->dicts[j] = NULL;
+        return;
+    }
+    d->n_str = 0;
+    d->arena_len = 0;
+    memset(d->slots, 0xff, sizeof(int) * d->n_slot); // all -1
+}
 
-    for (int i = 0; i < df->n_row; i++)
+/// @brief helper function, let every string column of res share the dictionary of the same column of df
+/// (res has the columns of df, e.g. rows taken from df)
+/// @param res IO dataframe made from df
+/// @param df  I  source dataframe
+static void can_share_dicts(can_dataframe *res, const can_dataframe *df)
+{
+    for (int j = 0; j < res->n_col; j++)
     {
-        for (int j = 0; j < df->n_col; j++)
+        if (res->dtypes[j] == 'S')
         {
-            if (df->dtypes[j] == 'I')
-            {
-                fprintf(fp, "% d%s", ((int *)(df->values[j]))[i], delim);
-            }
-            else if (df->dtypes[j] == 'D')
-            {
-                fprintf(fp, "% e%s", ((double *)(df->values[j]))[i], delim);
-            }
-            else if (df->dtypes[j] == 'C')
-            {
-                fprintf(fp, "%c%s", ((char *)(df->values[j]))[i], delim);
-            }
+            can_set_col_dict(res, j, df->dicts[j]);
         }
-        fprintf(fp, "\n");
     }
-
-    fclose(fp);
 }
 
-/// @brief print n_row of df on screen
-/// @param df     I dataframe to be shown
-/// @param n_row  I n row
-void can_print(const can_dataframe *df, int n_row)
+/// @brief helper function, code in dst of every string of src
+/// @param dst    IO dictionary
+/// @param src    I  dictionary, may be NULL (empty)
+/// @param insert I  1 to add missing strings to dst, 0 to map them to -2 (matches no code)
+/// @return map of src->n_str codes (need free)
+static int *can_dict_remap(can_dict *dst, const can_dict *src, int insert)
 {
-    if (n_row > df->n_row)
+    int n = src != NULL ? src->n_str : 0;
+    int *map = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (map == NULL)
     {
-        fprintf(stderr, "WARNING: can_print n_row > df->n_row, will be cut\n");
-        n_row = df->n_row;
+        fprintf(stderr, "ERROR: can_dict_remap cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < n; c++)
+    {
+        const char *t = can_dict_str(src, c);
+        size_t len = strlen(t);
+        int code = insert ? can_dict_intern(dst, t, len) : can_dict_find(dst, t, len);
+        map[c] = code >= 0 ? code : -2;
     }
+    return map;
+}
 
-    printf("Dataframe (%d, %d) , dtypes: %s\n", df->n_row, df->n_col, df->dtypes);
+/// @brief helper function, translate codes by map of can_dict_remap (MISS_STR stays missing)
+/// @param dst O codes
+/// @param src I codes (may be dst)
+/// @param n   I number of codes
+/// @param map I code map
+static void can_remap_codes(int *dst, const int *src, int n, const int *map)
+{
+    for (int i = 0; i < n; i++)
+    {
+        dst[i] = src[i] >= 0 ? map[src[i]] : MISS_STR;
+    }
+}
 
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, rewrite codes of dictionary src to codes of the dictionary of string column j of df
+/// (strings new to it are added, nothing happens if src is already that dictionary)
+/// @param df    IO dataframe
+/// @param j     I  column index of 'S' column
+/// @param src   I  dictionary of codes, may be NULL (only missing values)
+/// @param codes IO codes of src, rewritten in place
+/// @param n     I  number of codes
+static void can_recode_into(can_dataframe *df, int j, const can_dict *src, int *codes, int n)
+{
+    if (df->dicts[j] == src)
     {
-        printf("%s\t", df->cols[j]);
+        return;
     }
-    printf("\n");
+    int *map = can_dict_remap(can_col_dict(df, j), src, 1);
+    can_remap_codes(codes, codes, n, map);
+    free(map);
+}
 
-    for (int i = 0; i < n_row; i++)
+/// @brief helper function, rank of every code of d in ascending string order (strcmp)
+/// @param d I dictionary, may be NULL (empty)
+/// @return rank of d->n_str codes, 0 .. n_str - 1 (need free)
+static int *can_dict_ranks(const can_dict *d)
+{
+    int n = d != NULL ? d->n_str : 0;
+    int *order = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int *rank = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (order == NULL || rank == NULL)
     {
-        for (int j = 0; j < df->n_col; j++)
+        fprintf(stderr, "ERROR: can_dict_ranks cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < n; c++)
+    {
+        order[c] = c;
+    }
+    // merge sort of codes by their strings, distinct strings so stability does not matter
+    int *tmp = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (tmp == NULL)
+    {
+        fprintf(stderr, "ERROR: can_dict_ranks cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int w = 1; w < n; w *= 2)
+    {
+        for (int lo = 0; lo < n; lo += 2 * w)
         {
-            if (df->dtypes[j] == 'I')
+            int mid = lo + w < n ? lo + w : n, hi = lo + 2 * w < n ? lo + 2 * w : n;
+            int a = lo, b = mid, k = lo;
+            while (a < mid && b < hi)
             {
-                printf("% d\t", ((int *)(df->values[j]))[i]);
+                tmp[k++] = strcmp(can_dict_str(d, order[a]), can_dict_str(d, order[b])) <= 0 ? order[a++] : order[b++];
             }
-            else if (df->dtypes[j] == 'D')
+            while (a < mid)
             {
-                printf("% e\t", ((double *)(df->values[j]))[i]);
+                tmp[k++] = order[a++];
             }
-            else if (df->dtypes[j] == 'C')
+            while (b < hi)
             {
-                printf("%c\t", ((char *)(df->values[j]))[i]);
+                tmp[k++] = order[b++];
             }
         }
-        printf("\n");
+        int *swap = order;
+        order = tmp;
+        tmp = swap;
+    }
+    for (int r = 0; r < n; r++)
+    {
+        rank[order[r]] = r;
     }
+    free(order);
+    free(tmp);
+    return rank;
 }
 
-/// @brief get int type value by row and col name
-/// @param df  I dataframe
-/// @param row I row number(start from 0)
-/// @param col I col name
-/// @return integer type value
-int can_get_int(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+/// @brief helper function, index of lowest set bit (x != 0)
+/// @param x I 64 bit word
+/// @return bit index
+static inline int can_ctz64(uint64_t x)
 {
-    if (row >= df->n_row)
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while ((x & 1) == 0)
     {
-        fprintf(stderr, "ERORR: can_get_int row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        x >>= 1;
+        n++;
     }
-    else if (row < 0)
+    return n;
+#endif
+}
+
+/// @brief helper function, number of set bits
+/// @param x I 64 bit word
+/// @return bit count
+static inline int can_popcount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    while (x != 0)
     {
-        fprintf(stderr, "ERORR: can_get_int invalid row=%d < 0\n", row);
-        exit(EXIT_FAILURE);
+        x &= x - 1;
+        n++;
     }
+    return n;
+#endif
+}
 
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, validity bitmap of column j, made with every row valid if it has none yet
+/// @param df IO dataframe
+/// @param j  I  column index
+/// @return (capacity + 63) / 64 words
+static uint64_t *can_valid_col(can_dataframe *df, int j)
+{
+    if (df->valid[j] == NULL)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        size_t n_word = ((size_t)df->capacity + 63) / 64;
+        df->valid[j] = (uint64_t *)malloc(sizeof(uint64_t) * (n_word > 0 ? n_word : 1));
+        if (df->valid[j] == NULL)
         {
-            found_col = j;
-            break;
+            fprintf(stderr, "ERROR: can_valid_col cannot alloc memory\n");
+            exit(EXIT_FAILURE);
         }
+        memset(df->valid[j], 0xff, sizeof(uint64_t) * (n_word > 0 ? n_word : 1));
     }
-    if (found_col == -1)
-    {
-        fprintf(stderr, "ERORR: can_get_int cannot found col=%s\n", col);
-    }
-    else if (df->dtypes[found_col] != 'I')
+    return df->valid[j];
+}
+
+/// @brief helper function, drop validity bitmap of column j (every row becomes valid)
+/// @param df IO dataframe
+/// @param j  I  column index
+static void can_valid_free(can_dataframe *df, int j)
+{
+    free(df->valid[j]);
+    df->valid[j] = NULL;
+}
+
+/// @brief helper function, whether row i of column j is not null
+/// @param df I dataframe
+/// @param j  I column index
+/// @param i  I row
+/// @return 1 if valid, 0 if null
+static inline int can_row_valid(const can_dataframe *df, int j, int i)
+{
+    return df->valid[j] == NULL || ((df->valid[j][i >> 6] >> (i & 63)) & 1);
+}
+
+/// @brief helper function, set row i of column j null (MISS_* value and cleared bit of validity bitmap)
+/// @param df IO dataframe
+/// @param j  I  column index
+/// @param i  I  row
+static void can_set_row_null(can_dataframe *df, int j, int i)
+{
+    uint64_t *valid = can_valid_col(df, j);
+    valid[i >> 6] &= ~((uint64_t)1 << (i & 63));
+    can_value_set_missing(df->values[j], df->dtypes[j], i);
+}
+
+/// @brief helper function, mark row i of column j valid after a value is written to it
+/// @param df IO dataframe
+/// @param j  I  column index
+/// @param i  I  row
+static inline void can_set_row_valid(can_dataframe *df, int j, int i)
+{
+    if (df->valid[j] != NULL)
     {
-        fprintf(stderr, "ERORR: can_get_int found col=%s but it is not integer type\n", col);
-        exit(EXIT_FAILURE);
+        df->valid[j][i >> 6] |= (uint64_t)1 << (i & 63);
     }
+}
 
-    int res = ((int *)df->values[found_col])[row];
-    return res;
+/// @brief helper function, word w of validity bitmap of n rows, bits past n cleared
+/// @param valid I validity bitmap
+/// @param w     I word index
+/// @param n     I number of rows
+/// @return validity bits of rows [64 * w, 64 * w + 64)
+static inline uint64_t can_valid_word(const uint64_t *valid, int w, int n)
+{
+    return (n & 63) && w == n / 64 ? valid[w] & (((uint64_t)1 << (n & 63)) - 1) : valid[w];
 }
 
-/// @brief get double type value by row and col name
-/// @param df  I dataframe
-/// @param row I row number(start from 0)
-/// @param col I col name
-/// @return double type value
-double can_get_double(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+/// @brief helper function, k <= 64 bits of bitmap starting at bit off
+/// @param bits I bitmap
+/// @param off  I first bit
+/// @param k    I number of bits
+/// @return bits in the low k bits
+static inline uint64_t can_bits_get(const uint64_t *bits, size_t off, int k)
 {
-    if (row >= df->n_row)
+    size_t w = off >> 6;
+    int s = (int)(off & 63);
+    uint64_t x = bits[w] >> s;
+    if (s != 0 && s + k > 64)
     {
-        fprintf(stderr, "ERORR: can_get_double row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        x |= bits[w + 1] << (64 - s);
     }
-    else if (row < 0)
+    return k == 64 ? x : x & (((uint64_t)1 << k) - 1);
+}
+
+/// @brief helper function, overwrite k <= 64 bits of bitmap starting at bit off
+/// @param bits IO bitmap
+/// @param off  I  first bit
+/// @param k    I  number of bits
+/// @param x    I  bits in the low k bits
+static inline void can_bits_set(uint64_t *bits, size_t off, int k, uint64_t x)
+{
+    size_t w = off >> 6;
+    int s = (int)(off & 63);
+    uint64_t m = k == 64 ? UINT64_MAX : ((uint64_t)1 << k) - 1;
+    x &= m;
+    bits[w] = (bits[w] & ~(m << s)) | (x << s);
+    if (s != 0 && s + k > 64)
     {
-        fprintf(stderr, "ERORR: can_get_double invalid row=%d < 0\n", row);
-        exit(EXIT_FAILURE);
+        bits[w + 1] = (bits[w + 1] & ~(m >> (64 - s))) | (x >> (64 - s));
     }
+}
 
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, copy validity of n rows from bitmap src (NULL means all valid) at row src_off
+/// to column j of dst at row dst_off, 64 rows per word (dst gets a bitmap only when a copied row is null)
+/// @param dst     IO dataframe
+/// @param j       I  column index
+/// @param dst_off I  first row in dst
+/// @param src     I  validity bitmap, may be NULL
+/// @param src_off I  first row in src
+/// @param n       I  number of rows
+static void can_valid_copy(can_dataframe *dst, int j, int dst_off, const uint64_t *src, int src_off, int n)
+{
+    if (dst->valid[j] == NULL)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        int any_null = 0;
+        for (int i = 0; i < n && src != NULL && !any_null; i += 64)
         {
-            found_col = j;
-            break;
+            int k = n - i < 64 ? n - i : 64;
+            any_null = can_bits_get(src, (size_t)src_off + i, k) != (k == 64 ? UINT64_MAX : ((uint64_t)1 << k) - 1);
+        }
+        if (!any_null)
+        {
+            return;
         }
     }
-    if (found_col == -1)
+    uint64_t *valid = can_valid_col(dst, j);
+    for (int i = 0; i < n; i += 64)
     {
-        fprintf(stderr, "ERORR: can_get_double cannot found col=%s\n", col);
+        int k = n - i < 64 ? n - i : 64;
+        can_bits_set(valid, (size_t)dst_off + i, k, src != NULL ? can_bits_get(src, (size_t)src_off + i, k) : UINT64_MAX);
     }
-    else if (df->dtypes[found_col] != 'D')
+}
+
+/// @brief helper function, validity of column j of res gathered from column j_src of df: row i from row idx[i],
+/// idx[i] = -1 is null (same rows as can_gather_col)
+/// @param res   IO dataframe
+/// @param j     I  column index in res
+/// @param df    I  source dataframe
+/// @param j_src I  column index in df
+/// @param idx   I  row index in df of every row of res
+/// @param n     I  number of rows
+static void can_valid_gather(can_dataframe *res, int j, const can_dataframe *df, int j_src, const int *idx, int n)
+{
+    const uint64_t *src = df->valid[j_src];
+    for (int i = 0; i < n; i++)
     {
-        fprintf(stderr, "ERORR: can_get_double found col=%s but it is not double type\n", col);
-        exit(EXIT_FAILURE);
+        if (idx[i] < 0 || (src != NULL && !((src[idx[i] >> 6] >> (idx[i] & 63)) & 1)))
+        {
+            can_valid_col(res, j)[i >> 6] &= ~((uint64_t)1 << (i & 63));
+        }
     }
-
-    double res = ((double *)df->values[found_col])[row];
-    return res;
 }
 
-/// @brief get char type value by row and col name
-/// @param df  I dataframe
-/// @param row I row number(start from 0)
-/// @param col I col name
-/// @return char type value
-char can_get_char(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+/// @brief helper function, validity of column j of res from rows of validity bitmap src set in mask, in row order
+/// (same rows as can_compact_col)
+/// @param res  IO dataframe
+/// @param j    I  column index in res
+/// @param src  I  validity bitmap of source column, NULL means all valid
+/// @param n    I  number of rows of source
+/// @param mask I  row bit mask of source
+static void can_valid_compact(can_dataframe *res, int j, const uint64_t *src, int n, const uint64_t *mask)
 {
-    if (row >= df->n_row)
+    if (src == NULL)
     {
-        fprintf(stderr, "ERORR: can_get_char row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        return;
     }
-    else if (row < 0)
+    int k = 0;
+    for (int w = 0; w < (n + 63) / 64; w++)
     {
-        fprintf(stderr, "ERORR: can_get_char invalid row=%d < 0\n", row);
-        exit(EXIT_FAILURE);
+        uint64_t m = mask[w];
+        if (m == UINT64_MAX && ~src[w] == 0)
+        {
+            k += 64; // 64 valid rows kept, bits already set
+            continue;
+        }
+        for (; m != 0; m &= m - 1, k++)
+        {
+            int b = can_ctz64(m);
+            if (!((src[w] >> b) & 1))
+            {
+                can_valid_col(res, j)[k >> 6] &= ~((uint64_t)1 << (k & 63));
+            }
+        }
     }
+}
 
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, new dataframe of given rows of df, every column is gathered once
+/// @param df    I dataframe
+/// @param rows  I row numbers (valid, any order)
+/// @param n_row I number of rows
+/// @return sub dataframe (deep copy)
+static can_dataframe *can_take_rows(const can_dataframe *df, const int *rows, int n_row)
+{
+    can_dataframe *res = can_alloc(n_row, df->n_col, df->cols, df->dtypes, NULL);
+    can_share_dicts(res, df);
+    for (int j = 0; j < res->n_col; j++)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        can_gather_col(res->values[j], df->values[j], res->dtypes[j], rows, n_row);
+        if (df->valid[j] != NULL)
         {
-            found_col = j;
-            break;
+            can_valid_gather(res, j, df, j, rows, n_row);
         }
     }
-    if (found_col == -1)
+    return res;
+}
+
+/// @brief helper function, free zone map
+/// @param zm IO zone map, may be NULL
+static void can_zone_map_free(can_zone_map *zm)
+{
+    if (zm == NULL)
     {
-        fprintf(stderr, "ERORR: can_get_char cannot found col=%s\n", col);
+        return;
     }
-    else if (df->dtypes[found_col] != 'C')
+    free(zm->min);
+    free(zm->max);
+    free(zm->has_nan);
+    free(zm);
+}
+
+/// @brief helper function, free index
+/// @param ix IO index, may be NULL
+static void can_index_free(can_index *ix)
+{
+    if (ix == NULL)
     {
-        fprintf(stderr, "ERORR: can_get_char found col=%s but it is not char type\n", col);
-        exit(EXIT_FAILURE);
+        return;
     }
-
-    char res = ((char *)df->values[found_col])[row];
-    return res;
+    free(ix->perm);
+    free(ix->keys);
+    free(ix);
 }
 
-/// @brief set int type value of df
-/// @param df    IO dataframe
-/// @param row   I number of row
-/// @param col   I column name
-/// @param value I given integer type value
-void can_set_int(can_dataframe *df, int row, char col[MAX_COL_LEN], int value)
+/// @brief helper function, drop derived data of column j after its values changed
+/// (zone map is rebuilt lazily, index is marked stale and rebuilt by the next filter that uses it)
+/// @param df IO dataframe
+/// @param j  I  column index
+static inline void can_col_modified(can_dataframe *df, int j)
 {
-    if (row >= df->n_row)
+    if (df->zones[j] != NULL)
     {
-        fprintf(stderr, "ERORR: can_set_int row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        can_zone_map_free(df->zones[j]);
+        df->zones[j] = NULL;
     }
-    else if (row < 0)
+    if (df->indexes[j] != NULL)
     {
-        fprintf(stderr, "ERORR: can_set_int invalid row=%d < 0\n", row);
-        exit(EXIT_FAILURE);
+        df->indexes[j]->stale = 1;
     }
+}
 
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, map whole file read-only into memory
+/// (falls back to read the whole file into a buffer when mmap is not available)
+/// @param file I file path
+/// @param len  O file length in bytes
+/// @return file content (free with can_unmap_file), NULL if cannot open
+static const char *can_map_file(const char *file, size_t *len)
+{
+#if CANDAS_HAVE_MMAP
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
     {
-        if (strcmp(col, df->cols[j]) == 0)
-        {
-            found_col = j;
-            break;
-        }
+        return NULL;
     }
-    if (found_col == -1)
+    struct stat st;
+    if (fstat(fd, &st) != 0)
     {
-        fprintf(stderr, "ERORR: can_set_int cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        close(fd);
+        return NULL;
     }
-    else if (df->dtypes[found_col] != 'I')
+    *len = (size_t)st.st_size;
+    if (*len == 0)
     {
-        fprintf(stderr, "ERORR: can_set_int found col=%s but it is not char type\n", col);
-        exit(EXIT_FAILURE);
+        close(fd);
+        return "";
     }
-    ((int *)df->values[found_col])[row] = value;
-}
-
-/// @brief set double type value of df
-/// @param df    IO dataframe
-/// @param row   I number of row
-/// @param col   I column name
-/// @param value I given double type value
-void can_set_double(can_dataframe *df, int row, char col[MAX_COL_LEN], double value)
-{
-    if (row >= df->n_row)
+    void *p = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
     {
-        fprintf(stderr, "ERORR: can_set_double row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        return NULL;
     }
-    else if (row < 0)
+#ifdef MADV_SEQUENTIAL
+    madvise(p, *len, MADV_SEQUENTIAL);
+#endif
+    return (const char *)p;
+#else
+    FILE *fp = fopen(file, "rb");
+    if (!fp)
     {
-        fprintf(stderr, "ERORR: can_set_double invalid row=%d < 0\n", row);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *p = (char *)malloc(size > 0 ? (size_t)size : 1);
+    if (p == NULL)
+    {
+        fprintf(stderr, "ERROR: can_map_file cannot alloc memory\n");
         exit(EXIT_FAILURE);
     }
+    *len = fread(p, 1, size > 0 ? (size_t)size : 0, fp);
+    fclose(fp);
+    return p;
+#endif
+}
 
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+/// @brief helper function, release file content of can_map_file
+/// @param p   I file content
+/// @param len I file length in bytes
+static void can_unmap_file(const char *p, size_t len)
+{
+#if CANDAS_HAVE_MMAP
+    if (len > 0)
     {
-        if (strcmp(col, df->cols[j]) == 0)
-        {
-            found_col = j;
-            break;
-        }
+        munmap((void *)p, len);
     }
-    if (found_col == -1)
+#else
+    (void)len;
+    free((void *)p);
+#endif
+}
+
+/// @brief helper function, malloc with CAN_ALIGN alignment (original pointer is kept just before the result)
+/// @param size I bytes
+/// @return aligned memory, NULL if out of memory (free by can_aligned_free)
+static void *can_aligned_malloc(size_t size)
+{
+    char *raw = (char *)malloc(size + CAN_ALIGN + sizeof(void *));
+    if (raw == NULL)
     {
-        fprintf(stderr, "ERORR: can_set_double cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        return NULL;
     }
-    else if (df->dtypes[found_col] != 'D')
+    char *p = (char *)(((uintptr_t)raw + sizeof(void *) + CAN_ALIGN - 1) & ~(uintptr_t)(CAN_ALIGN - 1));
+    ((void **)p)[-1] = raw;
+    return p;
+}
+
+/// @brief helper function, free memory of can_aligned_malloc
+/// @param p I aligned memory, may be NULL
+static void can_aligned_free(void *p)
+{
+    if (p != NULL)
     {
-        fprintf(stderr, "ERORR: can_set_double found col=%s but it is not char type\n", col);
-        exit(EXIT_FAILURE);
+        free(((void **)p)[-1]);
     }
-    ((double *)df->values[found_col])[row] = value;
 }
 
-/// @brief set char type value of df
-/// @param df    IO dataframe
-/// @param row   I number of row
-/// @param col   I column name
-/// @param value I given char type value
-void can_set_char(can_dataframe *df, int row, char col[MAX_COL_LEN], char value)
+/// @brief helper function, round size up to multiple of CAN_ALIGN
+static inline size_t can_align_up(size_t size)
 {
-    if (row >= df->n_row)
+    return (size + CAN_ALIGN - 1) & ~(size_t)(CAN_ALIGN - 1);
+}
+
+// allocator of new dataframes of this thread, NULL means malloc / free
+static CAN_THREAD_LOCAL can_allocator *can_current_allocator = NULL;
+
+/// @brief helper function, alloc from allocator a (NULL means aligned malloc)
+static inline void *can_mem_alloc(can_allocator *a, size_t size)
+{
+    return a == NULL ? can_aligned_malloc(size) : a->alloc(a->ctx, size);
+}
+
+/// @brief helper function, give back memory of can_mem_alloc to allocator a
+static inline void can_mem_free(can_allocator *a, void *p)
+{
+    if (a == NULL)
     {
-        fprintf(stderr, "ERORR: can_set_char row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        can_aligned_free(p);
     }
-    else if (row < 0)
+    else
     {
-        fprintf(stderr, "ERORR: can_set_char invalid row=%d < 0\n", row);
-        exit(EXIT_FAILURE);
+        a->free(a->ctx, p);
     }
+}
 
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+/// @brief chunk of arena, data follows the header at CAN_ALIGN
+typedef struct can_arena_chunk
+{
+    struct can_arena_chunk *next;
+    size_t cap;  // bytes of data
+    size_t used; // bytes of data handed out
+} can_arena_chunk;
+
+/// @brief bump allocator, frees are ignored and everything goes back at once
+typedef struct
+{
+    can_arena_chunk *head; // chunk being filled, older chunks follow
+    size_t chunk_size;
+    can_dataframe **frames; // dataframes allocated from arena and not freed yet, their dicts / bitmaps / zone maps / indexes are malloc'ed
+    int n_frame;
+    int cap_frame;
+} can_arena;
+
+/// @brief helper function for can_arena_new, bump alloc from current chunk (new chunk if it is full)
+static void *can_arena_alloc(void *ctx, size_t size)
+{
+    can_arena *arena = (can_arena *)ctx;
+    size = can_align_up(size > 0 ? size : 1);
+    if (arena->head == NULL || arena->head->used + size > arena->head->cap)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        size_t cap = size > arena->chunk_size ? size : arena->chunk_size;
+        can_arena_chunk *chunk = (can_arena_chunk *)can_aligned_malloc(can_align_up(sizeof(can_arena_chunk)) + cap);
+        if (chunk == NULL)
         {
-            found_col = j;
-            break;
+            return NULL;
         }
+        chunk->cap = cap;
+        chunk->used = 0;
+        chunk->next = arena->head;
+        arena->head = chunk;
     }
-    if (found_col == -1)
+    char *p = (char *)arena->head + can_align_up(sizeof(can_arena_chunk)) + arena->head->used;
+    arena->head->used += size;
+    return p;
+}
+
+/// @brief helper function for can_arena_new, memory goes back by can_arena_reset / can_allocator_free only
+static void can_arena_free(void *ctx, void *p)
+{
+    (void)ctx;
+    (void)p;
+}
+
+/// @brief helper function for can_arena_reset / can_arena_release, can_free every dataframe still in arena
+/// (gives back what they hold outside the arena: string dictionaries, validity bitmaps, zone maps, indexes)
+static void can_arena_free_frames(can_arena *arena)
+{
+    while (arena->n_frame > 0)
     {
-        fprintf(stderr, "ERORR: can_set_char cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        can_free(arena->frames[arena->n_frame - 1]); // removes itself from the list
     }
-    else if (df->dtypes[found_col] != 'C')
+}
+
+/// @brief helper function for can_arena_new, free all chunks and arena
+static void can_arena_release(void *ctx)
+{
+    can_arena *arena = (can_arena *)ctx;
+    can_arena_free_frames(arena);
+    free(arena->frames);
+    while (arena->head != NULL)
     {
-        fprintf(stderr, "ERORR: can_set_char found col=%s but it is not char type\n", col);
-        exit(EXIT_FAILURE);
+        can_arena_chunk *next = arena->head->next;
+        can_aligned_free(arena->head);
+        arena->head = next;
     }
-    ((char *)df->values[found_col])[row] = value;
+    free(arena);
 }
 
-/// @brief return the pointer to df's col of integer type
-/// @param df  I dataframe
-/// @param col I column name
-/// @return integer pointer (shallow copy)
-int *can_get_int_pointer(can_dataframe *df, char col[MAX_COL_LEN])
+/// @brief header of every pool block, data follows at CAN_ALIGN
+typedef struct can_pool_block
 {
-    // check if col exist, and data type is int
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    int size_class;              // index of size class, -1 for large block from malloc
+    struct can_pool_block *next; // free list of size class / list of large blocks
+    struct can_pool_block *prev; // list of large blocks
+} can_pool_block;
+
+/// @brief size class allocator, freed blocks are kept in a free list per class and reused
+typedef struct
+{
+    can_pool_block *free_list[CAN_POOL_N_CLASS];
+    void *slabs;           // slabs taken from malloc, first word links to next slab
+    can_pool_block *large; // blocks larger than the largest class
+} can_pool;
+
+/// @brief helper function for can_pool_new, pop block of smallest fitting size class (refill class by one slab)
+static void *can_pool_alloc(void *ctx, size_t size)
+{
+    can_pool *pool = (can_pool *)ctx;
+    size_t head = can_align_up(sizeof(can_pool_block));
+    int c = 0;
+    while (c < CAN_POOL_N_CLASS && ((size_t)CAN_POOL_MIN_SIZE << c) < head + size)
+    {
+        c++;
+    }
+    if (c == CAN_POOL_N_CLASS)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        can_pool_block *b = (can_pool_block *)can_aligned_malloc(head + size);
+        if (b == NULL)
         {
-            found_col = j;
-            break;
+            return NULL;
+        }
+        b->size_class = -1;
+        b->prev = NULL;
+        b->next = pool->large;
+        if (pool->large != NULL)
+        {
+            pool->large->prev = b;
         }
+        pool->large = b;
+        return (char *)b + head;
     }
-    if (found_col == -1)
+
+    if (pool->free_list[c] == NULL)
     {
-        fprintf(stderr, "ERORR: can_get_int_pointer cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        // cut a slab into blocks of class c
+        size_t block = (size_t)CAN_POOL_MIN_SIZE << c;
+        char *slab = (char *)can_aligned_malloc(CAN_ALIGN + CAN_POOL_SLAB);
+        if (slab == NULL)
+        {
+            return NULL;
+        }
+        *(void **)slab = pool->slabs;
+        pool->slabs = slab;
+        for (size_t offset = CAN_ALIGN; offset + block <= CAN_ALIGN + CAN_POOL_SLAB; offset += block)
+        {
+            can_pool_block *b = (can_pool_block *)(slab + offset);
+            b->size_class = c;
+            b->next = pool->free_list[c];
+            pool->free_list[c] = b;
+        }
     }
-    else if (df->dtypes[found_col] != 'I')
+    can_pool_block *b = pool->free_list[c];
+    pool->free_list[c] = b->next;
+    return (char *)b + head;
+}
+
+/// @brief helper function for can_pool_new, push block back to free list of its class (large block to malloc)
+static void can_pool_free(void *ctx, void *p)
+{
+    can_pool *pool = (can_pool *)ctx;
+    can_pool_block *b = (can_pool_block *)((char *)p - can_align_up(sizeof(can_pool_block)));
+    if (b->size_class >= 0)
     {
-        fprintf(stderr, "ERORR: can_get_int_pointer found col=%s, but it is not integer type\n", col);
-        exit(EXIT_FAILURE);
+        b->next = pool->free_list[b->size_class];
+        pool->free_list[b->size_class] = b;
+        return;
     }
-    return df->values[found_col];
+    if (b->prev != NULL)
+    {
+        b->prev->next = b->next;
+    }
+    else
+    {
+        pool->large = b->next;
+    }
+    if (b->next != NULL)
+    {
+        b->next->prev = b->prev;
+    }
+    can_aligned_free(b);
 }
 
-/// @brief return the pointer to df's col of double type
-/// @param df  I dataframe
-/// @param col I column name
-/// @return double pointer (shallow copy)
-double *can_get_double_pointer(can_dataframe *df, char col[MAX_COL_LEN])
+/// @brief helper function for can_pool_new, free all slabs, large blocks and pool
+static void can_pool_release(void *ctx)
 {
-    // check if col exist, and data type is double
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    can_pool *pool = (can_pool *)ctx;
+    while (pool->slabs != NULL)
     {
-        if (strcmp(col, df->cols[j]) == 0)
-        {
-            found_col = j;
-            break;
-        }
+        void *next = *(void **)pool->slabs;
+        can_aligned_free(pool->slabs);
+        pool->slabs = next;
     }
-    if (found_col == -1)
+    while (pool->large != NULL)
     {
-        fprintf(stderr, "ERORR: can_get_double_pointer cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        can_pool_block *next = pool->large->next;
+        can_aligned_free(pool->large);
+        pool->large = next;
     }
-    else if (df->dtypes[found_col] != 'D')
+    free(pool);
+}
+
+/// @brief bump arena allocator, e.g. for all intermediate dataframes of a query: can_free is free,
+/// everything is released at once by can_arena_reset / can_allocator_free (not thread safe)
+/// @param chunk_size I bytes taken from malloc at a time, e.g. 1 << 20 (larger requests get a chunk of their own)
+/// @return allocator (free by can_allocator_free)
+can_allocator *can_arena_new(size_t chunk_size)
+{
+    can_allocator *a = (can_allocator *)calloc(1, sizeof(can_allocator));
+    can_arena *arena = (can_arena *)calloc(1, sizeof(can_arena));
+    if (a == NULL || arena == NULL)
     {
-        fprintf(stderr, "ERORR: can_get_double_pointer found col=%s, but it is not double type\n", col);
+        fprintf(stderr, "ERROR: can_arena_new cannot alloc memory\n");
         exit(EXIT_FAILURE);
     }
-    return df->values[found_col];
+    arena->chunk_size = chunk_size > 0 ? chunk_size : 1;
+    a->alloc = can_arena_alloc;
+    a->free = can_arena_free;
+    a->release = can_arena_release;
+    a->ctx = arena;
+    return a;
 }
 
-/// @brief return the pointer to df's col of char type
-/// @param df  I dataframe
-/// @param col I column name
-/// @return char pointer (shallow copy)
-char *can_get_char_pointer(can_dataframe *df, char col[MAX_COL_LEN])
+/// @brief give back all memory of arena at once, the newest chunk is kept for reuse
+/// (every dataframe allocated from arena becomes invalid, no can_free needed: string dictionary references,
+/// validity bitmaps, zone maps and indexes of dataframes not freed yet are freed here too)
+/// @param arena IO allocator from can_arena_new
+void can_arena_reset(can_allocator *arena)
 {
-    // check if col exist, and data type is char
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    if (arena->release != can_arena_release)
     {
-        if (strcmp(col, df->cols[j]) == 0)
-        {
-            found_col = j;
-            break;
-        }
+        fprintf(stderr, "ERROR: can_arena_reset allocator is not from can_arena_new\n");
+        exit(EXIT_FAILURE);
     }
-    if (found_col == -1)
+    can_arena *ctx = (can_arena *)arena->ctx;
+    can_arena_free_frames(ctx);
+    if (ctx->head == NULL)
     {
-        fprintf(stderr, "ERORR: can_get_char_pointer cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        return;
     }
-    else if (df->dtypes[found_col] != 'C')
+    can_arena_chunk *rest = ctx->head->next;
+    while (rest != NULL)
     {
-        fprintf(stderr, "ERORR: can_get_char_pointer found col=%s, but it is not char type\n", col);
+        can_arena_chunk *next = rest->next;
+        can_aligned_free(rest);
+        rest = next;
+    }
+    ctx->head->next = NULL;
+    ctx->head->used = 0;
+}
+
+/// @brief size class pool allocator (64 bytes ~ 64 KB, powers of 2) for many small dataframes,
+/// blocks given back by can_free are reused by the next dataframe of the same class (not thread safe)
+/// @return allocator (free by can_allocator_free)
+can_allocator *can_pool_new(void)
+{
+    can_allocator *a = (can_allocator *)calloc(1, sizeof(can_allocator));
+    can_pool *pool = (can_pool *)calloc(1, sizeof(can_pool));
+    if (a == NULL || pool == NULL)
+    {
+        fprintf(stderr, "ERROR: can_pool_new cannot alloc memory\n");
         exit(EXIT_FAILURE);
     }
-    return df->values[found_col];
+    a->alloc = can_pool_alloc;
+    a->free = can_pool_free;
+    a->release = can_pool_release;
+    a->ctx = pool;
+    return a;
 }
 
-/// @brief select one column by name from dataframe
-/// @param df  I dataframe
-/// @param col I column name
-/// @return sub dataframe (deep copy)
-can_dataframe *can_select_col(const can_dataframe *df, char col[MAX_COL_LEN])
+/// @brief release all memory of allocator and free it (dataframes allocated from it become invalid)
+/// @param a IO allocator, must not be the current allocator of any thread
+void can_allocator_free(can_allocator *a)
 {
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    if (a->release != NULL)
+    {
+        a->release(a->ctx);
+    }
+    free(a);
+}
+
+/// @brief set allocator of dataframes allocated later by this thread (every function that returns a dataframe),
+/// every dataframe keeps its allocator, so can_free always gives memory back to the right one
+/// e.g. prev = can_set_allocator(arena); ... run query ...; can_set_allocator(prev); can_arena_reset(arena);
+/// @param a I allocator, NULL means malloc / free
+/// @return previous allocator
+can_allocator *can_set_allocator(can_allocator *a)
+{
+    can_allocator *prev = can_current_allocator;
+    can_current_allocator = a;
+    return prev;
+}
+
+/// @brief helper function for can_frame_new, add df to the frame list of its allocator if it is an arena
+/// @param a  I  allocator of df
+/// @param df IO new dataframe
+static void can_arena_track(can_allocator *a, can_dataframe *df)
+{
+    df->arena_slot = -1;
+    if (a == NULL || a->release != can_arena_release)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        return;
+    }
+    can_arena *arena = (can_arena *)a->ctx;
+    if (arena->n_frame == arena->cap_frame)
+    {
+        int cap = arena->cap_frame > 0 ? arena->cap_frame * 2 : 16;
+        can_dataframe **frames = (can_dataframe **)realloc(arena->frames, sizeof(can_dataframe *) * cap);
+        if (frames == NULL)
         {
-            found_col = j;
-            break;
+            fprintf(stderr, "ERROR: can_arena_track cannot alloc memory\n");
+            exit(EXIT_FAILURE);
         }
+        arena->frames = frames;
+        arena->cap_frame = cap;
     }
-    if (found_col == -1)
+    df->arena_slot = arena->n_frame;
+    arena->frames[arena->n_frame++] = df;
+}
+
+/// @brief helper function for can_free, remove df from the frame list of its arena (last entry takes its slot)
+/// @param df IO dataframe
+static void can_arena_untrack(can_dataframe *df)
+{
+    if (df->arena_slot < 0)
     {
-        fprintf(stderr, "ERORR: can_select_col cannot found col=%s\n", col);
+        return;
+    }
+    can_arena *arena = (can_arena *)df->allocator->ctx;
+    can_dataframe *last = arena->frames[--arena->n_frame];
+    arena->frames[df->arena_slot] = last;
+    last->arena_slot = df->arena_slot;
+    df->arena_slot = -1;
+}
+
+/// @brief helper function, alloc struct, column descriptors (names, types, pointers, name hash) and n_row rows
+/// of every column as one CAN_ALIGN aligned block from the current allocator
+/// (struct and descriptors zeroed, columns not initialized, each column cache aligned)
+/// @param n_row       I number of rows
+/// @param n_col       I number of columns
+/// @param dtypes      I data types of columns, NULL to set them later (only without values)
+/// @param with_values I 1 to alloc columns, 0 for descriptors only (values NULL, e.g. mapped dataframe)
+/// @param func        I caller name for error message
+/// @return dataframe with n_row, n_col, capacity, dtypes, descriptor pointers, values, allocator and block_len set
+static can_dataframe *can_frame_new(int n_row, int n_col, const char *dtypes, int with_values, const char *func)
+{
+    int hash_size = 8;
+    while (hash_size < 2 * n_col)
+    {
+        hash_size <<= 1;
+    }
+
+    // pointers, then ints, then chars, padded to CAN_ALIGN
+    size_t head = can_align_up(sizeof(can_dataframe));
+    size_t desc = sizeof(void *) * 5 * n_col + sizeof(int) * hash_size + (size_t)MAX_COL_LEN * n_col + n_col + 1;
+    size_t len = head + can_align_up(desc);
+    for (int j = 0; j < n_col && with_values; j++)
+    {
+        len += can_align_up(can_dtype_size(dtypes[j]) * (size_t)(n_row > 0 ? n_row : 1));
+    }
+
+    can_allocator *a = can_current_allocator;
+    char *block = (char *)can_mem_alloc(a, len);
+    if (block == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
         exit(EXIT_FAILURE);
     }
+    memset(block, 0, head + desc);
+    can_dataframe *df = (can_dataframe *)block;
+    df->n_row = n_row;
+    df->n_col = n_col;
+    df->capacity = n_row > 0 ? n_row : 1;
+    df->allocator = a;
+    df->block_len = len;
+    can_arena_track(a, df);
 
-    char cols[MAX_COL_NUM][MAX_COL_LEN] = {""};
-    strncpy(cols[0], col, MAX_COL_LEN);
-    char dtypes[MAX_COL_NUM] = "";
-    dtypes[0] = df->dtypes[found_col];
+    char *p = block + head;
+    df->values = (void **)p;
+    df->zones = (can_zone_map **)(p + sizeof(void *) * n_col);
+    df->indexes = (can_index **)(p + sizeof(void *) * 2 * n_col);
+    df->dicts = (can_dict **)(p + sizeof(void *) * 3 * n_col);
+    df->valid = (uint64_t **)(p + sizeof(void *) * 4 * n_col);
+    p += sizeof(void *) * 5 * n_col;
+    df->col_hash = (int *)p;
+    df->col_hash_size = hash_size;
+    p += sizeof(int) * hash_size;
+    df->cols = (char(*)[MAX_COL_LEN])p;
+    p += (size_t)MAX_COL_LEN * n_col;
+    df->dtypes = p;
+    if (dtypes != NULL)
+    {
+        memcpy(df->dtypes, dtypes, n_col);
+    }
 
-    void *values[MAX_COL_NUM] = {df->values[found_col]};
-    can_dataframe *res = can_alloc(df->n_row, 1, cols, dtypes, values);
-    return res;
+    size_t offset = head + can_align_up(desc);
+    for (int j = 0; j < n_col && with_values; j++)
+    {
+        df->values[j] = block + offset;
+        offset += can_align_up(can_dtype_size(dtypes[j]) * (size_t)(n_row > 0 ? n_row : 1));
+    }
+    return df;
 }
 
-/// @brief select multiple columns from a dataframe
-/// @param df    I dataframe
-/// @param n_col I number of columns selected
-/// @param cols  I column names
-/// @return sub dataframe (deep copy)
-can_dataframe *can_select_cols(const can_dataframe *df, int n_col, char cols[MAX_COL_NUM][MAX_COL_LEN])
+/// @brief helper function, 1 if column j lives in the block of df (0 if it was regrown or is mapped)
+static inline int can_col_in_block(const can_dataframe *df, int j)
 {
-    char dtypes[MAX_COL_NUM] = "";
-    void *values[MAX_COL_NUM] = {NULL};
+    const char *v = (const char *)df->values[j];
+    return v >= (const char *)df && v < (const char *)df + df->block_len;
+}
 
-    for (int k = 0; k < n_col; k++)
+/// @brief helper function, move column j to its own buffer of n_new rows from the allocator of df
+/// (first n_keep rows are kept, old buffer is given back unless it is in the block of df)
+/// @param df     IO dataframe
+/// @param j      I  column index
+/// @param n_keep I  rows to keep
+/// @param n_new  I  rows of new buffer
+/// @param func   I  caller name for error message
+static void can_col_resize(can_dataframe *df, int j, int n_keep, int n_new, const char *func)
+{
+    size_t size = can_dtype_size(df->dtypes[j]);
+    void *p = can_mem_alloc(df->allocator, size * (size_t)(n_new > 0 ? n_new : 1));
+    if (p == NULL)
     {
-        char *col = cols[k];
-        int found_col = -1;
-        for (int j = 0; j < df->n_col; j++)
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(p, df->values[j], size * (size_t)n_keep);
+    if (!can_col_in_block(df, j))
+    {
+        can_mem_free(df->allocator, df->values[j]);
+    }
+    df->values[j] = p;
+
+    if (df->valid[j] != NULL)
+    {
+        // validity bitmap follows, new rows are valid
+        size_t n_old = ((size_t)df->capacity + 63) / 64, n_word = ((size_t)n_new + 63) / 64;
+        uint64_t *valid = (uint64_t *)realloc(df->valid[j], sizeof(uint64_t) * (n_word > 0 ? n_word : 1));
+        if (valid == NULL)
         {
-            if (strcmp(col, df->cols[j]) == 0)
-            {
-                found_col = j;
-                break;
-            }
+            fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+            exit(EXIT_FAILURE);
         }
-        if (found_col == -1)
+        if (n_word > n_old)
         {
-            fprintf(stderr, "ERORR: can_select_cols cannot found col=%s\n", col);
-            exit(EXIT_FAILURE);
+            memset(valid + n_old, 0xff, sizeof(uint64_t) * (n_word - n_old));
         }
-        dtypes[k] = df->dtypes[found_col];
-        values[k] = df->values[found_col];
+        df->valid[j] = valid;
     }
-    can_dataframe *res = can_alloc(df->n_row, n_col, cols, dtypes, values);
-    return res;
 }
 
-/// @brief select one row from dataframe
-/// @param df  I dataframe
-/// @param row I number of row
-/// @return sub dataframe (deep copy)
-can_dataframe *can_select_row(const can_dataframe *df, int row)
+/// @brief helper function, grow every column of df to hold at least need rows (capacity doubles, amortized O(1) per row)
+/// @param df   IO dataframe, not read-only
+/// @param need I rows needed
+/// @param func I caller name for error message
+static void can_grow(can_dataframe *df, int need, const char *func)
 {
-    if (row >= df->n_row)
+    if (need <= df->capacity)
     {
-        fprintf(stderr, "ERORR: can_select_row row=%d >= df->n_row\n", row);
-        exit(EXIT_FAILURE);
+        return;
     }
-    else if (row < 0)
+    else if (df->mapping != NULL)
     {
-        fprintf(stderr, "ERORR: can_select_row invalid row=%d < 0\n", row);
+        fprintf(stderr, "ERROR: %s dataframe is read-only (can_load_binary)\n", func);
         exit(EXIT_FAILURE);
     }
-
-    void *values[MAX_COL_NUM] = {NULL};
+    int new_cap = df->capacity > 0 ? df->capacity : 16;
+    while (new_cap < need)
+    {
+        new_cap = new_cap < INT_MAX / 2 ? new_cap * 2 : INT_MAX;
+    }
     for (int j = 0; j < df->n_col; j++)
     {
-        values[j] = df->values[j] + row;
+        can_col_resize(df, j, df->n_row, new_cap, func);
     }
+    df->capacity = new_cap;
+}
 
-    can_dataframe *res = can_alloc(1, df->n_col, df->cols, df->dtypes, values);
-    return res;
+/// @brief helper function, malloc that exits with an error message when out of memory
+/// @param size I bytes, 0 is allowed
+/// @param func I caller name for error message
+/// @return memory (need free)
+static void *can_malloc(size_t size, const char *func)
+{
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    return p;
 }
 
-/// @brief select multiple rows (not necessarily in ascending order) from a dataframe
-/// @param df    I dataframe
+/// @brief helper function, alloc dataframe of n_row rows with the names and data types of columns idx[k] of df
+/// (values not initialized)
+/// @param df    I source dataframe
 /// @param n_row I number of rows
-/// @param rows  I rows number
-/// @return sub dataframe (deep copy)
-can_dataframe *can_select_rows(const can_dataframe *df, int n_row, int *rows)
+/// @param n_col I number of columns
+/// @param idx   I column index in df of every column
+/// @param func  I caller name for error message
+/// @return dataframe
+static can_dataframe *can_alloc_cols_of(const can_dataframe *df, int n_row, int n_col, const int *idx, const char *func)
 {
-    for (int k = 0; k < n_row; k++)
+    char *dtypes = (char *)can_malloc(n_col, func);
+    for (int k = 0; k < n_col; k++)
     {
-        int row = rows[k];
-        if (row >= df->n_row)
+        dtypes[k] = df->dtypes[idx[k]];
+    }
+    can_dataframe *res = can_frame_new(n_row, n_col, dtypes, 1, func);
+    free(dtypes);
+    for (int k = 0; k < n_col; k++)
+    {
+        memcpy(res->cols[k], df->cols[idx[k]], MAX_COL_LEN);
+        if (res->dtypes[k] == 'S')
         {
-            fprintf(stderr, "ERORR: can_select_rows row=%d >= df->n_row\n", row);
-            exit(EXIT_FAILURE);
+            can_set_col_dict(res, k, df->dicts[idx[k]]);
         }
-        else if (row < 0)
+    }
+    can_build_col_hash(res);
+    return res;
+}
+
+/// @brief init and alloc memory for can_dataframe
+/// (struct and all columns are one cache aligned block from the current allocator, see can_set_allocator)
+/// @param n_row  I number of rows (can reserve empty rows)
+/// @param n_col  I number of cols (must be exact)
+/// @param cols   I column names
+/// @param dtypes I data types, e.g. "IDDC" means 4 cols with int, double, double, char
+///                  (also "bhluf" for int8, int16, int64, uint32, float, "S" for string)
+/// @param values I init values of columns (deep copy, only n_row), set NULL (not {NULL}) to do only malloc,
+///                  'S' column takes an array of const char * (NULL is a null row)
+/// @return
+can_dataframe *can_alloc(int n_row, int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], void *values[MAX_COL_NUM])
+{
+    if (n_row < 0)
+    {
+        fprintf(stderr, "ERROR: can_alloc n_row < 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (n_col <= 0)
+    {
+        fprintf(stderr, "ERROR: can_alloc n_col <= 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int j = 0; j < n_col; j++)
+    {
+        if (!can_dtype_valid(dtypes[j]))
         {
-            fprintf(stderr, "ERORR: can_select_rows invalid row=%d < 0\n", row);
+            fprintf(stderr, "ERROR: dtype must be 'I'(int) or 'D'(double) or 'C'(char) or 'b'(int8) or 'h'(int16) or 'l'(int64) or 'u'(uint32) or 'f'(float) or 'S'(string)\n");
             exit(EXIT_FAILURE);
         }
     }
 
-    // assign capacity, values here will be replaced
-    can_dataframe *res = can_alloc(n_row, df->n_col, df->cols, df->dtypes, (void **)df->values); // (void**) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-
-    // replace values
-    // for selected rows (not all rows)
-    for (int i = 0; i < n_row; i++)
+    can_dataframe *df = can_frame_new(n_row, n_col, dtypes, 1, "can_alloc");
+    for (int j = 0; j < n_col; j++)
     {
-        // for all column
-        for (int j = 0; j < res->n_col; j++)
+        if (strlen(cols[j]) >= MAX_COL_LEN)
         {
-            if (df->dtypes[j] == 'I')
-            {
-                int v = can_get_int(df, rows[i], (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                can_set_int(res, i, res->cols[j], v);
-            }
-            else if (df->dtypes[j] == 'D')
-            {
-                double v = can_get_double(df, rows[i], (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                can_set_double(res, i, res->cols[j], v);
-            }
-            else if (df->dtypes[j] == 'C')
+            fprintf(stderr, "WARNING: can_alloc col name %s exceed MAX_COL_LEN = %d, col name will be cut\n", cols[j], MAX_COL_LEN);
+        }
+        strncpy(df->cols[j], cols[j], MAX_COL_LEN - 1);
+
+        if (values != NULL && dtypes[j] == 'S')
+        {
+            const char **strs = (const char **)values[j];
+            can_dict *d = can_col_dict(df, j);
+            for (int i = 0; i < n_row; i++)
             {
-                char v = can_get_char(df, rows[i], (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                can_set_char(res, i, res->cols[j], v);
+                if (strs[i] != NULL)
+                {
+                    ((int *)df->values[j])[i] = can_dict_intern(d, strs[i], strlen(strs[i]));
+                }
+                else
+                {
+                    can_set_row_null(df, j, i);
+                }
             }
         }
+        else if (values != NULL)
+        {
+            memcpy(df->values[j], values[j], can_dtype_size(dtypes[j]) * n_row);
+        }
     }
-    return res;
+    can_build_col_hash(df);
+    return df;
 }
 
-/// @brief filter rows that have value of col between min and max
-/// @param df  I dataframe
-/// @param col I col name that have double date type
-/// @param min I min value
-/// @param max I max value
-/// @return     filtered dataframe
-can_dataframe *can_filter_double(const can_dataframe *df, char col[MAX_COL_LEN], double min, double max)
+/// @brief free dataframe, the values and derived data in it and the struct itself (df is invalid afterwards)
+/// @param df IO dataframe to be freed
+void can_free(can_dataframe *df)
 {
-    int found_col = -1;
+    if (df->mapping != NULL)
+    {
+        // read-only dataframe, values point into file mapping
+        can_unmap_file(df->mapping, df->mapping_len);
+        df->mapping = NULL;
+        df->mapping_len = 0;
+        memset(df->values, 0, sizeof(void *) * df->n_col);
+    }
     for (int j = 0; j < df->n_col; j++)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        // columns in the block go with the struct
+        if (df->values[j] != NULL && !can_col_in_block(df, j))
         {
-            found_col = j;
-            break;
+            can_mem_free(df->allocator, df->values[j]);
         }
+        can_col_modified(df, j);
+        can_index_free(df->indexes[j]);
+        df->indexes[j] = NULL;
+        can_dict_release(df->dicts[j]);
+        df->dicts[j] = NULL;
+        can_valid_free(df, j);
     }
-    if (found_col == -1)
+    can_arena_untrack(df);
+    can_mem_free(df->allocator, df);
+}
+
+/// @brief helper function for csv readers, whether field of len bytes is CAN_NULL_TOKEN
+/// @param s   I field text
+/// @param len I field length (line end excluded)
+/// @return 1 if null
+static inline int can_csv_is_null(const char *s, size_t len)
+{
+    return len == sizeof(CAN_NULL_TOKEN) - 1 && memcmp(s, CAN_NULL_TOKEN, len) == 0;
+}
+
+/// @brief helper function for can_read_csv, read one whole line of any length (fgets into a growing buffer)
+/// @param line IO line buffer, grown as needed (need free)
+/// @param cap  IO capacity of line buffer
+/// @param fp   I  file
+/// @return 1 if a line is read, 0 at end of file
+static int can_read_line(char **line, size_t *cap, FILE *fp)
+{
+    size_t len = 0;
+    while (fgets(*line + len, (int)(*cap - len < INT_MAX ? *cap - len : INT_MAX), fp) != NULL)
     {
-        fprintf(stderr, "ERORR: can_filter_double cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        len += strlen(*line + len);
+        if (len > 0 && (*line)[len - 1] == '\n')
+        {
+            return 1;
+        }
+        if (*cap - len < 2)
+        {
+            char *grown = (char *)realloc(*line, *cap * 2);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "ERROR: can_read_csv cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            *line = grown;
+            *cap *= 2;
+        }
     }
-    else if (df->dtypes[found_col] != 'D')
+    return len > 0;
+}
+
+/// @brief read csv file to dataframe
+/// @param file     I csv filepath
+/// @param n_col    I number of columns
+/// @param cols     I column names
+/// @param dtypes   I column data types
+/// @param delim    I delimiters (internally use strtok)
+/// @param skip_row I number of header row to skip
+/// @return           dataframe
+can_dataframe *can_read_csv(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp)
     {
-        fprintf(stderr, "ERORR: can_filter_double found col=%s but it is not double type\n", col);
+        fprintf(stderr, "can_read_csv cannot open file %s", file);
         exit(EXIT_FAILURE);
     }
+    size_t cap = MAX_LINE_LEN;
+    char *line = (char *)can_malloc(cap, "can_read_csv");
 
-    // count how many valid value
-    double *vs = (double *)df->values[found_col];
+    // count row
     int n_row = 0;
+    for (int i = 0; i < skip_row; i++)
+    {
+        can_read_line(&line, &cap, fp);
+    }
+    while (can_read_line(&line, &cap, fp))
+    {
+        n_row++;
+    }
+
+    rewind(fp);
+
+    // init dataframe
+    can_dataframe *df = can_alloc(n_row, n_col, cols, dtypes, NULL);
+
+    for (int i = 0; i < skip_row; i++)
+    {
+        can_read_line(&line, &cap, fp);
+    }
+
     for (int i = 0; i < df->n_row; i++)
     {
-        if (vs[i] >= min && vs[i] <= max)
+        can_read_line(&line, &cap, fp);
+        char *pch = strtok(line, delim);
+        if (*pch == '\n') // empty line
+        {
+            fprintf(stderr, "WARNING: can_read_csv detect empty line at line %d\n", i + 1 + skip_row);
+            continue;
+        }
+        for (int j = 0; j < df->n_col; j++)
         {
-            n_row++;
+            // line end is not part of the last field
+            size_t len = pch != NULL ? strcspn(pch, "\r\n") : 0;
+            if (len == 0 || can_csv_is_null(pch, len))
+            {
+                // missing field (nothing left after a trailing delimiter) or null token:
+                // MISS_* value and null in validity bitmap
+                can_set_row_null(df, j, i);
+            }
+            else if (df->dtypes[j] == 'I')
+            {
+                ((int *)(df->values[j]))[i] = atoi(pch);
+            }
+            else if (df->dtypes[j] == 'D')
+            {
+                ((double *)(df->values[j]))[i] = atof(pch);
+            }
+            else if (df->dtypes[j] == 'C')
+            {
+                ((char *)(df->values[j]))[i] = *pch;
+            }
+            else if (df->dtypes[j] == 'S')
+            {
+                ((int *)(df->values[j]))[i] = can_dict_intern(can_col_dict(df, j), pch, len);
+            }
+            else if (df->dtypes[j] == 'f')
+            {
+                ((float *)(df->values[j]))[i] = (float)atof(pch);
+            }
+            else
+            {
+                can_value_set_int64(df->values[j], df->dtypes[j], i, strtoll(pch, NULL, 10));
+            }
+
+            pch = strtok(NULL, delim);
+
+            if (j == df->n_col - 1 && pch != NULL)
+            {
+                fprintf(stderr, "WARNING: can_read_csv encounter strange line at line %d\n", i + 1 + skip_row);
+            }
         }
     }
 
-    // assign capacity, values here will be replaced
-    can_dataframe *res = can_alloc(n_row, df->n_col, df->cols, df->dtypes, (void **)df->values); // (void**) here do nothing but prevent [-Wdiscarded-qualifiers] warning
+    free(line);
+    fclose(fp);
+    return df;
+}
+
+/// @brief tokenizer state of csv reader, classify 64 bytes at a time into separator / newline bit masks
+typedef struct
+{
+    const char *buf;             // csv text
+    size_t len;                  // length of csv text
+    size_t block;                // start of the cached 64 byte block, (size_t)-1 if none
+    uint64_t sep;                // bit i set if buf[block + i] is a delimiter
+    uint64_t nl;                 // bit i set if buf[block + i] is '\n'
+    int n_delim;                 // number of delimiter chars (vectorized compare if <= 8)
+    char delims[8];              // delimiter chars
+    unsigned char is_sep[256];   // delimiter lookup table
+} can_csv_scanner;
 
-    // replace values
-    // for all rows that satisfy condition
-    int row_i = 0;
-    for (int i = 0; i < df->n_row; i++)
+/// @brief helper function for csv reader, init scanner of buf with delimiter chars
+/// (like strtok, consecutive delimiters are one separator, '\r' is also a delimiter)
+/// @param sc    O scanner
+/// @param buf   I csv text
+/// @param len   I length of csv text
+/// @param delim I delimiter chars
+static void can_csv_scanner_init(can_csv_scanner *sc, const char *buf, size_t len, const char *delim)
+{
+    memset(sc, 0, sizeof(can_csv_scanner));
+    sc->buf = buf;
+    sc->len = len;
+    sc->block = (size_t)-1;
+    for (const char *d = delim; *d != '\0'; d++)
+    {
+        sc->is_sep[(unsigned char)*d] = 1;
+    }
+    sc->is_sep['\r'] = 1;
+    sc->is_sep['\n'] = 0;
+    for (int c = 1; c < 256; c++)
     {
-        // if satisfy condition
-        double compare = can_get_double(df, i, col);
-        if (compare >= min && compare <= max)
+        if (sc->is_sep[c])
         {
-            // for all column copy value
-            for (int j = 0; j < res->n_col; j++)
+            if (sc->n_delim < 8)
             {
-                if (df->dtypes[j] == 'I')
-                {
-                    int v = can_get_int(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_int(res, row_i, res->cols[j], v);
-                }
-                else if (df->dtypes[j] == 'D')
-                {
-                    double v = can_get_double(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_double(res, row_i, res->cols[j], v);
-                }
-                else if (df->dtypes[j] == 'C')
-                {
-                    char v = can_get_char(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_char(res, row_i, res->cols[j], v);
-                }
+                sc->delims[sc->n_delim] = (char)c;
             }
-            row_i++;
+            sc->n_delim++;
         }
     }
-    return res;
 }
 
-/// @brief filter rows that have value of col between min and max
-/// @param df  I dataframe
-/// @param col I col name that have int date type
-/// @param min I min value
-/// @param max I max value
-/// @return     filtered dataframe
-can_dataframe *can_filter_int(const can_dataframe *df, char col[MAX_COL_LEN], int min, int max)
+/// @brief helper function for csv reader, compute separator / newline masks of the 64 byte block at block
+/// @param sc    IO scanner
+/// @param block I block start (multiple of 64)
+static void can_csv_load_block(can_csv_scanner *sc, size_t block)
 {
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    const char *p = sc->buf + block;
+    uint64_t sep = 0, nl = 0;
+    sc->block = block;
+    if (block + 64 > sc->len || sc->n_delim > 8)
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        // tail of buffer (must not read past the end) or too many delimiters
+        size_t n = sc->len - block < 64 ? sc->len - block : 64;
+        for (size_t i = 0; i < n; i++)
         {
-            found_col = j;
-            break;
+            unsigned char c = (unsigned char)p[i];
+            sep |= (uint64_t)sc->is_sep[c] << i;
+            nl |= (uint64_t)(c == '\n') << i;
         }
+        sc->sep = sep;
+        sc->nl = nl;
+        return;
     }
-    if (found_col == -1)
+#if defined(__AVX2__) && !defined(CANDAS_NO_SIMD)
+    __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+    __m256i v_nl = _mm256_set1_epi8('\n');
+    nl = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v_nl)) |
+         ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v_nl)) << 32);
+    __m256i s_lo = _mm256_setzero_si256(), s_hi = _mm256_setzero_si256();
+    for (int d = 0; d < sc->n_delim; d++)
     {
-        fprintf(stderr, "ERORR: can_filter_int cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        __m256i v_d = _mm256_set1_epi8(sc->delims[d]);
+        s_lo = _mm256_or_si256(s_lo, _mm256_cmpeq_epi8(lo, v_d));
+        s_hi = _mm256_or_si256(s_hi, _mm256_cmpeq_epi8(hi, v_d));
     }
-    else if (df->dtypes[found_col] != 'I')
+    sep = (uint64_t)(uint32_t)_mm256_movemask_epi8(s_lo) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(s_hi) << 32);
+#elif defined(__SSE2__) && !defined(CANDAS_NO_SIMD)
+    __m128i v_nl = _mm_set1_epi8('\n');
+    for (int k = 0; k < 4; k++)
     {
-        fprintf(stderr, "ERORR: can_filter_int found col=%s but it is not int type\n", col);
-        exit(EXIT_FAILURE);
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i s = _mm_setzero_si128();
+        for (int d = 0; d < sc->n_delim; d++)
+        {
+            s = _mm_or_si128(s, _mm_cmpeq_epi8(x, _mm_set1_epi8(sc->delims[d])));
+        }
+        nl |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, v_nl)) << (16 * k);
+        sep |= (uint64_t)(uint32_t)_mm_movemask_epi8(s) << (16 * k);
+    }
+#else
+    for (int i = 0; i < 64; i++)
+    {
+        unsigned char c = (unsigned char)p[i];
+        sep |= (uint64_t)sc->is_sep[c] << i;
+        nl |= (uint64_t)(c == '\n') << i;
     }
+#endif
+    sc->sep = sep;
+    sc->nl = nl;
+}
 
-    // count how many valid value
-    int *vs = (int *)df->values[found_col];
-    int n_row = 0;
-    for (int i = 0; i < df->n_row; i++)
+/// @brief helper function for csv reader, find first position >= pos whose byte class is selected
+/// @param sc    IO scanner
+/// @param pos   I start position
+/// @param which I 0: not delimiter, 1: delimiter or newline, 2: newline
+/// @return found position, sc->len if not found
+static inline size_t can_csv_find(can_csv_scanner *sc, size_t pos, int which)
+{
+    while (pos < sc->len)
     {
-        if (vs[i] >= min && vs[i] <= max)
+        size_t block = pos & ~(size_t)63;
+        if (block != sc->block)
+        {
+            can_csv_load_block(sc, block);
+        }
+        uint64_t m = which == 0 ? ~sc->sep : (which == 1 ? (sc->sep | sc->nl) : sc->nl);
+        m >>= (pos - block);
+        if (m != 0)
         {
-            n_row++;
+            size_t found = pos + (size_t)can_ctz64(m);
+            return found < sc->len ? found : sc->len;
         }
+        pos = block + 64;
     }
+    return sc->len;
+}
 
-    // assign capacity, values here will be replaced
-    can_dataframe *res = can_alloc(n_row, df->n_col, df->cols, df->dtypes, (void **)df->values); // (void**) here do nothing but prevent [-Wdiscarded-qualifiers] warning
+/// @brief helper function for csv reader, parse integer like atoi but without NUL terminator
+/// @param p   I token start
+/// @param end I token end
+/// @return integer value
+static inline int can_parse_int(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        neg = *p == '-';
+        p++;
+    }
+    unsigned int v = 0;
+    while (p < end && (unsigned)(*p - '0') < 10)
+    {
+        v = v * 10 + (unsigned)(*p - '0');
+        p++;
+    }
+    return neg ? (int)(0u - v) : (int)v;
+}
 
-    // replace values
-    // for all rows that satisfy condition
-    int row_i = 0;
-    for (int i = 0; i < df->n_row; i++)
+/// @brief helper function for csv reader, parse 64 bit integer like can_parse_int
+/// @param p   I token start
+/// @param end I token end
+/// @return integer value
+static inline int64_t can_parse_int64(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
     {
-        // if satisfy condition
-        int compare = can_get_int(df, i, col);
-        if (compare >= min && compare <= max)
-        {
-            // for all column copy value
-            for (int j = 0; j < res->n_col; j++)
-            {
-                if (df->dtypes[j] == 'I')
-                {
-                    int v = can_get_int(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_int(res, row_i, res->cols[j], v);
-                }
-                else if (df->dtypes[j] == 'D')
-                {
-                    double v = can_get_double(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_double(res, row_i, res->cols[j], v);
-                }
-                else if (df->dtypes[j] == 'C')
-                {
-                    char v = can_get_char(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_char(res, row_i, res->cols[j], v);
-                }
-            }
-            row_i++;
-        }
+        p++;
     }
-    return res;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        neg = *p == '-';
+        p++;
+    }
+    uint64_t v = 0;
+    while (p < end && (unsigned)(*p - '0') < 10)
+    {
+        v = v * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+    return neg ? (int64_t)(0u - v) : (int64_t)v;
 }
 
-/// @brief filter rows that have value of col between min and max
-/// @param df  I dataframe
-/// @param col I col name that have char date type
-/// @param min I min value
-/// @param max I max value
-/// @return     filtered dataframe
-can_dataframe *can_filter_char(const can_dataframe *df, char col[MAX_COL_LEN], char min, char max)
+/// @brief helper function for csv reader, parse double like atof but without NUL terminator,
+/// decimal numbers with <= 19 significant digits and |exponent| <= 22 are converted exactly in place
+/// (Clinger's fast path), others fall back to strtod
+/// @param p   I token start
+/// @param end I token end
+/// @return double value
+static inline double can_parse_double(const char *p, const char *end)
 {
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    static const double pow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *s = p;
+    while (s < end && (*s == ' ' || *s == '\t'))
+    {
+        s++;
+    }
+    int neg = 0;
+    if (s < end && (*s == '-' || *s == '+'))
+    {
+        neg = *s == '-';
+        s++;
+    }
+    uint64_t m = 0;
+    int n_digit = 0; // significant digits in m
+    int has_digit = 0;
+    int exp10 = 0;
+    while (s < end && (unsigned)(*s - '0') < 10)
+    {
+        m = m * 10 + (uint64_t)(*s - '0');
+        n_digit += (m != 0);
+        has_digit = 1;
+        s++;
+    }
+    if (s < end && *s == '.')
     {
-        if (strcmp(col, df->cols[j]) == 0)
+        s++;
+        while (s < end && (unsigned)(*s - '0') < 10)
         {
-            found_col = j;
-            break;
+            m = m * 10 + (uint64_t)(*s - '0');
+            n_digit += (m != 0);
+            has_digit = 1;
+            exp10--;
+            s++;
         }
     }
-    if (found_col == -1)
+    if (has_digit && s < end && (*s == 'e' || *s == 'E'))
     {
-        fprintf(stderr, "ERORR: can_filter_char cannot found col=%s\n", col);
-        exit(EXIT_FAILURE);
+        const char *e = s + 1;
+        int e_neg = 0;
+        if (e < end && (*e == '-' || *e == '+'))
+        {
+            e_neg = *e == '-';
+            e++;
+        }
+        int ev = 0;
+        while (e < end && (unsigned)(*e - '0') < 10)
+        {
+            ev = ev < 10000 ? ev * 10 + (*e - '0') : ev;
+            e++;
+        }
+        exp10 += e_neg ? -ev : ev;
     }
-    else if (df->dtypes[found_col] != 'C')
+
+    if (has_digit && n_digit <= 19 && m <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
     {
-        fprintf(stderr, "ERORR: can_filter_char found col=%s but it is not char type\n", col);
+        double v = (double)m;
+        v = exp10 < 0 ? v / pow10[-exp10] : v * pow10[exp10];
+        return neg ? -v : v;
+    }
+
+    // slow path: inf / nan / hex / too many digits / large exponent
+    char local[64];
+    size_t n = (size_t)(end - p);
+    char *tmp = n < sizeof(local) ? local : (char *)malloc(n + 1);
+    if (tmp == NULL)
+    {
+        fprintf(stderr, "ERROR: can_parse_double cannot alloc memory\n");
         exit(EXIT_FAILURE);
     }
+    memcpy(tmp, p, n);
+    tmp[n] = '\0';
+    double v = strtod(tmp, NULL);
+    if (tmp != local)
+    {
+        free(tmp);
+    }
+    return v;
+}
 
-    // count how many valid value
-    char *vs = (char *)df->values[found_col];
-    int n_row = 0;
-    for (int i = 0; i < df->n_row; i++)
+/// @brief helper function for csv reader, parse lines of [pos, end) and append them as rows after df->n_row
+/// (same rules as can_read_csv: missing tokens and CAN_NULL_TOKEN are null, char takes first character of token)
+/// @param sc       IO scanner of csv text
+/// @param pos      I  start position, must be start of a line
+/// @param end      I  end position, must be end of text or just after a '\n'
+/// @param df       IO dataframe, rows are appended
+/// @param max_rows I  stop after max_rows rows are appended, -1 means no limit
+/// @param line_no  IO number of lines before pos (for warnings), -1 means unknown
+/// @return position after the last parsed line
+static size_t can_csv_parse(can_csv_scanner *sc, size_t pos, size_t end, can_dataframe *df, int max_rows, long *line_no)
+{
+    const char *buf = sc->buf;
+    int added = 0;
+    while (pos < end && (max_rows < 0 || added < max_rows))
     {
-        if (vs[i] >= min && vs[i] <= max)
+        if (*line_no >= 0)
         {
-            n_row++;
+            (*line_no)++;
         }
-    }
 
-    // assign capacity, values here will be replaced
-    can_dataframe *res = can_alloc(n_row, df->n_col, df->cols, df->dtypes, (void **)df->values); // (void**) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-
-    // replace values
-    // for all rows that satisfy condition
-    int row_i = 0;
-    for (int i = 0; i < df->n_row; i++)
-    {
-        // if satisfy condition
-        char compare = can_get_char(df, i, col);
-        if (compare >= min && compare <= max)
+        // skip leading delimiters
+        size_t p = can_csv_find(sc, pos, 0);
+        if (p >= end || buf[p] == '\n')
         {
-            // for all column copy value
-            for (int j = 0; j < res->n_col; j++)
+            if (p < end)
             {
-                if (df->dtypes[j] == 'I')
+                if (*line_no >= 0)
                 {
-                    int v = can_get_int(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_int(res, row_i, res->cols[j], v);
+                    fprintf(stderr, "WARNING: can_read_csv_mmap detect empty line at line %ld\n", *line_no);
                 }
-                else if (df->dtypes[j] == 'D')
+                else
                 {
-                    double v = can_get_double(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_double(res, row_i, res->cols[j], v);
+                    fprintf(stderr, "WARNING: can_read_csv_mmap detect empty line at byte %zu\n", p);
                 }
-                else if (df->dtypes[j] == 'C')
+            }
+            pos = p < end ? p + 1 : end;
+            continue;
+        }
+
+        if (df->n_row >= df->capacity)
+        {
+            can_grow(df, df->n_row + 1, "can_csv_parse");
+        }
+        int i = df->n_row;
+        for (int j = 0; j < df->n_col; j++)
+        {
+            if (p >= end || buf[p] == '\n')
+            {
+                // missing field: MISS_* value and null in validity bitmap
+                can_set_row_null(df, j, i);
+                continue;
+            }
+            size_t e = can_csv_find(sc, p, 1);
+            if (can_csv_is_null(buf + p, e - p))
+            {
+                can_set_row_null(df, j, i);
+            }
+            else if (df->dtypes[j] == 'I')
+            {
+                ((int *)(df->values[j]))[i] = can_parse_int(buf + p, buf + e);
+            }
+            else if (df->dtypes[j] == 'D')
+            {
+                ((double *)(df->values[j]))[i] = can_parse_double(buf + p, buf + e);
+            }
+            else if (df->dtypes[j] == 'C')
+            {
+                ((char *)(df->values[j]))[i] = buf[p];
+            }
+            else if (df->dtypes[j] == 'S')
+            {
+                ((int *)(df->values[j]))[i] = can_dict_intern(can_col_dict(df, j), buf + p, e - p);
+            }
+            else if (df->dtypes[j] == 'f')
+            {
+                ((float *)(df->values[j]))[i] = (float)can_parse_double(buf + p, buf + e);
+            }
+            else
+            {
+                can_value_set_int64(df->values[j], df->dtypes[j], i, can_parse_int64(buf + p, buf + e));
+            }
+            p = can_csv_find(sc, e, 0);
+        }
+        if (p < end && buf[p] != '\n')
+        {
+            if (*line_no >= 0)
+            {
+                fprintf(stderr, "WARNING: can_read_csv_mmap encounter strange line at line %ld\n", *line_no);
+            }
+            else
+            {
+                fprintf(stderr, "WARNING: can_read_csv_mmap encounter strange line at byte %zu\n", p);
+            }
+            p = can_csv_find(sc, p, 2);
+        }
+        pos = p < end ? p + 1 : end;
+        df->n_row++;
+        added++;
+    }
+    return pos;
+}
+
+/// @brief helper function for csv reader, parse lines of [begin, end) of csv text into a new dataframe
+/// @param buf     I csv text
+/// @param len     I length of csv text
+/// @param begin   I start position, must be start of a line
+/// @param end     I end position, must be end of text or just after a '\n'
+/// @param n_col   I number of columns
+/// @param cols    I column names
+/// @param dtypes  I column data types
+/// @param delim   I delimiters
+/// @param line_no I number of lines before begin (for warnings), -1 means unknown
+/// @return dataframe
+static can_dataframe *can_csv_read_range(const char *buf, size_t len, size_t begin, size_t end, int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, long line_no)
+{
+    can_csv_scanner sc;
+    can_csv_scanner_init(&sc, buf, len, delim);
+
+    // guess number of rows by the length of first line, columns grow if guess is too small
+    size_t first_line = can_csv_find(&sc, begin, 2) - begin + 1;
+    size_t guess = (end - begin) / first_line + 16;
+    can_dataframe *df = can_alloc(guess < (size_t)INT_MAX ? (int)guess : INT_MAX, n_col, cols, dtypes, NULL);
+    df->n_row = 0;
+
+    can_csv_parse(&sc, begin, end, df, -1, &line_no);
+
+    // shrink to fit when the guess was far too large
+    if (df->n_row < df->capacity / 2)
+    {
+        for (int j = 0; j < df->n_col; j++)
+        {
+            can_col_resize(df, j, df->n_row, df->n_row, "can_read_csv");
+        }
+        df->capacity = df->n_row > 0 ? df->n_row : 1;
+    }
+    return df;
+}
+
+/// @brief helper function for csv reader, position after skip_row lines
+/// @param buf      I csv text
+/// @param len      I length of csv text
+/// @param skip_row I number of lines to skip
+/// @return start position of first data line
+static size_t can_csv_skip_rows(const char *buf, size_t len, int skip_row)
+{
+    size_t pos = 0;
+    for (int i = 0; i < skip_row && pos < len; i++)
+    {
+        const char *nl = (const char *)memchr(buf + pos, '\n', len - pos);
+        pos = nl != NULL ? (size_t)(nl - buf) + 1 : len;
+    }
+    return pos;
+}
+
+/// @brief read csv file to dataframe in a single pass, same arguments and result as can_read_csv
+/// (file is memory mapped and tokenized 64 bytes at a time with SSE2 / AVX2 when available,
+/// numbers are parsed in place, columns grow geometrically, no line length limit)
+/// @param file     I csv filepath
+/// @param n_col    I number of columns
+/// @param cols     I column names
+/// @param dtypes   I column data types
+/// @param delim    I delimiters (any of the chars, consecutive delimiters count as one, like strtok)
+/// @param skip_row I number of header row to skip
+/// @return           dataframe
+can_dataframe *can_read_csv_mmap(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row)
+{
+    size_t len = 0;
+    const char *buf = can_map_file(file, &len);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "can_read_csv_mmap cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t pos = can_csv_skip_rows(buf, len, skip_row);
+    can_dataframe *df = can_csv_read_range(buf, len, pos, len, n_col, cols, dtypes, delim, skip_row);
+    can_unmap_file(buf, len);
+    return df;
+}
+
+/// @brief helper function, number of online processors (1 if unknown)
+/// @return number of processors
+static int can_n_processor(void)
+{
+#if CANDAS_HAVE_MMAP && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/// @brief helper function, run fn on every job, each job on its own thread
+/// (jobs run one by one on the calling thread if C11 threads are not available)
+/// @param n_job    I number of jobs
+/// @param fn       I job function, returns 0
+/// @param jobs     IO array of n_job job arguments
+/// @param job_size I size in bytes of one job argument
+static void can_parallel_run(int n_job, int (*fn)(void *), void *jobs, size_t job_size)
+{
+#if CANDAS_HAVE_THREADS
+    thrd_t *threads = (thrd_t *)malloc(sizeof(thrd_t) * (n_job > 0 ? n_job : 1));
+    char *started = (char *)calloc(n_job > 0 ? n_job : 1, 1);
+    if (threads == NULL || started == NULL)
+    {
+        fprintf(stderr, "ERROR: can_parallel_run cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    // job 0 runs on the calling thread
+    for (int k = 1; k < n_job; k++)
+    {
+        started[k] = thrd_create(&threads[k], fn, (char *)jobs + job_size * k) == thrd_success;
+    }
+    for (int k = 0; k < n_job; k++)
+    {
+        if (!started[k])
+        {
+            fn((char *)jobs + job_size * k);
+        }
+    }
+    for (int k = 1; k < n_job; k++)
+    {
+        if (started[k])
+        {
+            thrd_join(threads[k], NULL);
+        }
+    }
+    free(threads);
+    free(started);
+#else
+    for (int k = 0; k < n_job; k++)
+    {
+        fn((char *)jobs + job_size * k);
+    }
+#endif
+}
+
+/// @brief one chunk of can_read_csv_parallel
+typedef struct
+{
+    const char *buf;       // csv text
+    size_t len;            // length of csv text
+    size_t begin;          // chunk start (start of a line)
+    size_t end;            // chunk end (just after a '\n' or end of text)
+    int n_col;             // number of columns
+    const char (*cols)[MAX_COL_LEN]; // column names
+    const char *dtypes;    // column data types
+    const char *delim;     // delimiters
+    can_dataframe *part;   // rows parsed from this chunk
+    can_dataframe *res;    // final dataframe
+    int offset;            // first row of this chunk in final dataframe
+} can_csv_chunk;
+
+/// @brief helper function for can_read_csv_parallel, parse one chunk into thread local columns
+/// @param arg IO can_csv_chunk
+/// @return 0
+static int can_csv_parse_chunk(void *arg)
+{
+    can_csv_chunk *c = (can_csv_chunk *)arg;
+    c->part = can_csv_read_range(c->buf, c->len, c->begin, c->end, c->n_col, c->cols, c->dtypes, c->delim, -1);
+    return 0;
+}
+
+/// @brief helper function for can_read_csv_parallel, copy thread local columns into final dataframe
+/// @param arg IO can_csv_chunk
+/// @return 0
+static int can_csv_copy_chunk(void *arg)
+{
+    can_csv_chunk *c = (can_csv_chunk *)arg;
+    for (int j = 0; j < c->part->n_col; j++)
+    {
+        size_t size = can_dtype_size(c->part->dtypes[j]);
+        memcpy((char *)c->res->values[j] + size * c->offset, c->part->values[j], size * c->part->n_row);
+    }
+    can_free(c->part);
+    c->part = NULL;
+    return 0;
+}
+
+/// @brief read csv file to dataframe with multiple threads, same arguments and result as can_read_csv_mmap
+/// (file is split at line boundaries into n_thread chunks of at least CAN_CSV_MIN_CHUNK bytes, every chunk is parsed into its own columns,
+/// then chunks are copied into the final dataframe at their row offsets;
+/// warnings of a chunk report byte position instead of line number)
+/// @param file     I csv filepath
+/// @param n_col    I number of columns
+/// @param cols     I column names
+/// @param dtypes   I column data types
+/// @param delim    I delimiters (any of the chars, consecutive delimiters count as one, like strtok)
+/// @param skip_row I number of header row to skip
+/// @param n_thread I number of threads, <= 0 means number of processors, 1 is same as can_read_csv_mmap
+/// @return           dataframe
+can_dataframe *can_read_csv_parallel(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row, int n_thread)
+{
+    if (n_thread <= 0)
+    {
+        n_thread = can_n_processor();
+    }
+    if (n_thread == 1)
+    {
+        return can_read_csv_mmap(file, n_col, cols, dtypes, delim, skip_row);
+    }
+
+    size_t len = 0;
+    const char *buf = can_map_file(file, &len);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "can_read_csv_parallel cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+    size_t pos = can_csv_skip_rows(buf, len, skip_row);
+
+    const size_t min_chunk = CAN_CSV_MIN_CHUNK > 0 ? (size_t)CAN_CSV_MIN_CHUNK : 1;
+    size_t body = len - pos;
+    int n_chunk = n_thread;
+    if ((size_t)n_chunk > body / min_chunk + 1)
+    {
+        n_chunk = (int)(body / min_chunk + 1);
+    }
+    if (n_chunk <= 1)
+    {
+        can_dataframe *df = can_csv_read_range(buf, len, pos, len, n_col, cols, dtypes, delim, skip_row);
+        can_unmap_file(buf, len);
+        return df;
+    }
+
+    // split at line boundaries
+    can_csv_chunk *chunks = (can_csv_chunk *)calloc(n_chunk, sizeof(can_csv_chunk));
+    if (chunks == NULL)
+    {
+        fprintf(stderr, "ERROR: can_read_csv_parallel cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t begin = pos;
+    for (int k = 0; k < n_chunk; k++)
+    {
+        size_t end = len;
+        if (k < n_chunk - 1)
+        {
+            end = pos + body / n_chunk * (k + 1);
+            end = end > begin ? end : begin;
+            const char *nl = (const char *)memchr(buf + end, '\n', len - end);
+            end = nl != NULL ? (size_t)(nl - buf) + 1 : len;
+        }
+        chunks[k].buf = buf;
+        chunks[k].len = len;
+        chunks[k].begin = begin;
+        chunks[k].end = end;
+        chunks[k].n_col = n_col;
+        chunks[k].cols = cols;
+        chunks[k].dtypes = dtypes;
+        chunks[k].delim = delim;
+        begin = end;
+    }
+    can_parallel_run(n_chunk, can_csv_parse_chunk, chunks, sizeof(can_csv_chunk));
+    can_unmap_file(buf, len);
+
+    // prefix offsets of chunks, then copy them into final dataframe
+    int n_row = 0;
+    for (int k = 0; k < n_chunk; k++)
+    {
+        chunks[k].offset = n_row;
+        n_row += chunks[k].part->n_row;
+    }
+    can_dataframe *res = can_alloc(n_row, n_col, cols, dtypes, NULL);
+    for (int k = 0; k < n_chunk; k++)
+    {
+        chunks[k].res = res;
+    }
+    for (int j = 0; j < n_col; j++)
+    {
+        // every chunk has its own string dictionary, recode the others into the one of the first chunk
+        for (int k = 0; k < n_chunk && dtypes[j] == 'S'; k++)
+        {
+            if (k == 0)
+            {
+                can_set_col_dict(res, j, chunks[k].part->dicts[j]);
+            }
+            else
+            {
+                can_recode_into(res, j, chunks[k].part->dicts[j], (int *)chunks[k].part->values[j], chunks[k].part->n_row);
+            }
+        }
+    }
+    for (int j = 0; j < n_col; j++)
+    {
+        // nulls of every chunk (chunks share bitmap words at their borders, so not in parallel)
+        for (int k = 0; k < n_chunk; k++)
+        {
+            can_valid_copy(res, j, chunks[k].offset, chunks[k].part->valid[j], 0, chunks[k].part->n_row);
+        }
+    }
+    can_parallel_run(n_chunk, can_csv_copy_chunk, chunks, sizeof(can_csv_chunk));
+
+    free(chunks);
+    return res;
+}
+
+/// @brief helper function for can_csv_reader, move unparsed bytes to front of buffer and read more of the file
+/// (buffer doubles if it is full of one unfinished line)
+/// @param rd IO reader
+/// @return number of bytes read, 0 at end of file
+static size_t can_csv_reader_fill(can_csv_reader *rd)
+{
+    if (rd->eof)
+    {
+        return 0;
+    }
+    memmove(rd->buf, rd->buf + rd->pos, rd->buf_len - rd->pos);
+    rd->buf_len -= rd->pos;
+    rd->pos = 0;
+    if (rd->buf_len == rd->buf_cap)
+    {
+        char *p = (char *)realloc(rd->buf, rd->buf_cap * 2);
+        if (p == NULL)
+        {
+            fprintf(stderr, "ERROR: can_csv_reader_fill cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        rd->buf = p;
+        rd->buf_cap *= 2;
+    }
+    size_t n = fread(rd->buf + rd->buf_len, 1, rd->buf_cap - rd->buf_len, rd->fp);
+    rd->buf_len += n;
+    if (n == 0)
+    {
+        rd->eof = 1;
+    }
+    return n;
+}
+
+/// @brief open csv file for reading in batches, same arguments as can_read_csv
+/// (only a fixed size buffer of the file is kept in memory, so files larger than RAM can be processed)
+/// @param file     I csv filepath
+/// @param n_col    I number of columns
+/// @param cols     I column names
+/// @param dtypes   I column data types
+/// @param delim    I delimiters (any of the chars, consecutive delimiters count as one, like strtok)
+/// @param skip_row I number of header row to skip
+/// @return reader (close by can_csv_reader_close)
+can_csv_reader *can_csv_reader_open(const char file[MAX_LINE_LEN], int n_col, const char cols[MAX_COL_NUM][MAX_COL_LEN], const char dtypes[MAX_COL_NUM], const char *delim, int skip_row)
+{
+    if (n_col <= 0)
+    {
+        fprintf(stderr, "ERROR: can_csv_reader_open invalid n_col = %d\n", n_col);
+        exit(EXIT_FAILURE);
+    }
+    can_csv_reader *rd = (can_csv_reader *)calloc(1, sizeof(can_csv_reader));
+    if (rd == NULL)
+    {
+        fprintf(stderr, "ERROR: can_csv_reader_open cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    rd->fp = fopen(file, "rb");
+    if (!rd->fp)
+    {
+        fprintf(stderr, "can_csv_reader_open cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+    rd->buf_cap = (size_t)1 << 20;
+    rd->buf = (char *)malloc(rd->buf_cap);
+    rd->delim = (char *)malloc(strlen(delim) + 1);
+    rd->dtypes = (char *)malloc(n_col);
+    rd->cols = (char(*)[MAX_COL_LEN])calloc(n_col, MAX_COL_LEN);
+    if (rd->buf == NULL || rd->delim == NULL || rd->dtypes == NULL || rd->cols == NULL)
+    {
+        fprintf(stderr, "ERROR: can_csv_reader_open cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(rd->delim, delim);
+    rd->n_col = n_col;
+    for (int j = 0; j < n_col; j++)
+    {
+        strncpy(rd->cols[j], cols[j], MAX_COL_LEN);
+        rd->dtypes[j] = dtypes[j];
+    }
+
+    // skip header rows
+    for (int i = 0; i < skip_row; i++)
+    {
+        const char *nl;
+        while ((nl = (const char *)memchr(rd->buf + rd->pos, '\n', rd->buf_len - rd->pos)) == NULL)
+        {
+            rd->pos = rd->buf_len;
+            if (can_csv_reader_fill(rd) == 0)
+            {
+                break;
+            }
+        }
+        if (nl == NULL)
+        {
+            break;
+        }
+        rd->pos = (size_t)(nl - rd->buf) + 1;
+        rd->line_no++;
+    }
+    return rd;
+}
+
+/// @brief read next batch of at most max_rows rows
+/// e.g. can_dataframe *batch = NULL;
+///      while ((batch = can_csv_reader_next_batch(rd, 100000, batch)) != NULL) { ... }
+/// @param rd       IO reader
+/// @param max_rows I max number of rows of batch
+/// @param reuse    IO batch returned by the previous call of this reader to refill in place
+///                    (its buffers are reused, so nothing is reallocated, string dictionaries start empty again),
+///                    or NULL to get a new dataframe;
+///                    reuse is freed when NULL is returned
+/// @return batch dataframe (n_row <= max_rows), NULL at end of file
+can_dataframe *can_csv_reader_next_batch(can_csv_reader *rd, int max_rows, can_dataframe *reuse)
+{
+    if (max_rows <= 0)
+    {
+        fprintf(stderr, "ERROR: can_csv_reader_next_batch max_rows = %d <= 0\n", max_rows);
+        exit(EXIT_FAILURE);
+    }
+
+    can_dataframe *df = reuse;
+    if (df == NULL)
+    {
+        df = can_alloc(max_rows, rd->n_col, rd->cols, rd->dtypes, NULL);
+    }
+    for (int j = 0; j < df->n_col; j++)
+    {
+        can_col_modified(df, j); // values are overwritten
+        can_valid_free(df, j);
+        if (df->dtypes[j] == 'S')
+        {
+            can_col_dict_reset(df, j); // strings of the previous batch are not carried over
+        }
+    }
+    df->n_row = 0;
+    can_grow(df, max_rows, "can_csv_reader_next_batch");
+
+    while (df->n_row < max_rows)
+    {
+        // complete lines of buffer
+        size_t end = rd->buf_len;
+        if (!rd->eof)
+        {
+            while (end > rd->pos && rd->buf[end - 1] != '\n')
+            {
+                end--;
+            }
+        }
+        if (end == rd->pos)
+        {
+            if (can_csv_reader_fill(rd) == 0 && rd->pos == rd->buf_len)
+            {
+                break; // end of file
+            }
+            continue;
+        }
+
+        can_csv_scanner sc;
+        can_csv_scanner_init(&sc, rd->buf, rd->buf_len, rd->delim);
+        rd->pos = can_csv_parse(&sc, rd->pos, end, df, max_rows - df->n_row, &rd->line_no);
+    }
+
+    if (df->n_row == 0)
+    {
+        can_free(df);
+        return NULL;
+    }
+    return df;
+}
+
+/// @brief close reader
+/// @param rd IO reader
+void can_csv_reader_close(can_csv_reader *rd)
+{
+    fclose(rd->fp);
+    free(rd->buf);
+    free(rd->delim);
+    free(rd->dtypes);
+    free(rd->cols);
+    free(rd);
+}
+
+void can_write_csv(const char file[MAX_LINE_LEN], const can_dataframe *df, const char *delim)
+{
+    FILE *fp = fopen(file, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "can_read_csv cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(fp, "Dataframe (%d, %d) , dtypes: %s\n", df->n_row, df->n_col, df->dtypes);
+
+    for (int j = 0; j < df->n_col; j++)
+    {
+        fprintf(fp, "%s%s", df->cols[j], delim);
+    }
+    fprintf(fp, "\n");
+
+    for (int i = 0; i < df->n_row; i++)
+    {
+        for (int j = 0; j < df->n_col; j++)
+        {
+            if (!can_row_valid(df, j, i))
+            {
+                fprintf(fp, "%s%s", CAN_NULL_TOKEN, delim);
+            }
+            else if (df->dtypes[j] == 'I')
+            {
+                fprintf(fp, "% d%s", ((int *)(df->values[j]))[i], delim);
+            }
+            else if (df->dtypes[j] == 'D')
+            {
+                fprintf(fp, "% e%s", ((double *)(df->values[j]))[i], delim);
+            }
+            else if (df->dtypes[j] == 'C')
+            {
+                fprintf(fp, "%c%s", ((char *)(df->values[j]))[i], delim);
+            }
+            else if (df->dtypes[j] == 'f')
+            {
+                fprintf(fp, "% e%s", ((float *)(df->values[j]))[i], delim);
+            }
+            else if (df->dtypes[j] == 'S')
+            {
+                int code = ((int *)(df->values[j]))[i];
+                fprintf(fp, "%s%s", code >= 0 ? can_dict_str(df->dicts[j], code) : CAN_NULL_TOKEN, delim);
+            }
+            else
+            {
+                fprintf(fp, "% lld%s", (long long)can_value_as_int64(df->values[j], df->dtypes[j], i), delim);
+            }
+        }
+        fprintf(fp, "\n");
+    }
+
+    fclose(fp);
+}
+
+/// @brief helper function for can_write_csv_buffered, format integer
+/// @param v   I integer
+/// @param out O text (no NUL terminator)
+/// @return number of chars written
+static inline int can_format_int(long long v, char *out)
+{
+    char tmp[24];
+    int n = 0;
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do
+    {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    int len = 0;
+    if (v < 0)
+    {
+        out[len++] = '-';
+    }
+    while (n > 0)
+    {
+        out[len++] = tmp[--n];
+    }
+    return len;
+}
+
+/// @brief helper function for can_write_csv_buffered, format m / 10^p in fixed notation
+/// @param m   I scaled value
+/// @param p   I number of decimals
+/// @param neg I 1 if negative
+/// @param out O text (no NUL terminator)
+/// @return number of chars written
+static inline int can_format_fixed(uint64_t m, int p, int neg, char *out)
+{
+    char tmp[24];
+    int n = 0;
+    do
+    {
+        tmp[n++] = (char)('0' + m % 10);
+        m /= 10;
+    } while (m != 0);
+    while (n <= p)
+    {
+        tmp[n++] = '0'; // at least one digit before decimal point
+    }
+    int len = 0;
+    if (neg)
+    {
+        out[len++] = '-';
+    }
+    while (n > p)
+    {
+        out[len++] = tmp[--n];
+    }
+    if (p > 0)
+    {
+        out[len++] = '.';
+        while (n > 0)
+        {
+            out[len++] = tmp[--n];
+        }
+    }
+    return len;
+}
+
+/// @brief helper function for can_write_csv_buffered, format double
+/// precision >= 0: fixed notation with precision decimals (like "%.*f"),
+/// precision < 0: shortest text that reads back to exactly the same double
+/// (shortest decimal m / 10^p is searched directly, since m < 2^53 and 10^p <= 10^22 are exact,
+/// m / 10^p is the correctly rounded double of that text, otherwise falls back to "%.17g")
+/// @param v         I double value
+/// @param precision I number of decimals, < 0 means shortest round trip
+/// @param out       O text (no NUL terminator), at least 350 + precision chars
+/// @return number of chars written
+static int can_format_double(double v, int precision, char *out)
+{
+    static const double pow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (v != v || v - v != 0.0) // nan or inf
+    {
+        return sprintf(out, "%g", v);
+    }
+    int neg = signbit(v) != 0;
+    double a = neg ? -v : v;
+
+    if (precision >= 0)
+    {
+        double s = a * pow10[precision <= 22 ? precision : 22];
+        if (precision <= 22 && s < 9007199254740992.0)
+        {
+            uint64_t m = (uint64_t)s;
+            double frac = s - (double)m;
+            // near a tie the product is not exact, let printf round the exact binary value
+            if (frac < 0.4999999 || frac > 0.5000001)
+            {
+                m += frac > 0.5;
+                return can_format_fixed(m, precision, neg, out);
+            }
+        }
+        return sprintf(out, "%.*f", precision, v);
+    }
+
+    if (a == 0.0)
+    {
+        return can_format_fixed(0, 0, neg, out);
+    }
+    if (a >= 1e-5 && a < 1e15)
+    {
+        for (int p = 0; p <= 22; p++)
+        {
+            double s = a * pow10[p];
+            if (s >= 9007199254740992.0)
+            {
+                break;
+            }
+            uint64_t m = (uint64_t)(s + 0.5);
+            if ((double)m / pow10[p] == a)
+            {
+                return can_format_fixed(m, p, neg, out);
+            }
+        }
+    }
+    for (int digits = 15; digits < 17; digits++)
+    {
+        int len = sprintf(out, "%.*g", digits, v);
+        if (strtod(out, NULL) == v)
+        {
+            return len;
+        }
+    }
+    return sprintf(out, "%.17g", v);
+}
+
+/// @brief helper function for can_write_csv_buffered, format float like can_format_double,
+/// precision < 0: shortest text that reads back (as double, then rounded to float) to exactly the same float
+/// @param v         I float value
+/// @param precision I number of decimals, < 0 means shortest round trip
+/// @param out       O text (no NUL terminator), at least 350 + precision chars
+/// @return number of chars written
+static int can_format_float(float v, int precision, char *out)
+{
+    static const double pow10[13] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12};
+    if (precision >= 0 || v != v || v - v != 0.0f || v == 0.0f)
+    {
+        return can_format_double(v, precision, out);
+    }
+    int neg = signbit(v) != 0;
+    double a = neg ? -(double)v : (double)v;
+    if (a >= 1e-5 && a < 1e7)
+    {
+        for (int p = 0; p <= 12; p++)
+        {
+            if (a * pow10[p] >= 9007199254740992.0)
+            {
+                break;
+            }
+            uint64_t m = (uint64_t)(a * pow10[p] + 0.5);
+            if ((float)((double)m / pow10[p]) == (float)a)
+            {
+                return can_format_fixed(m, p, neg, out);
+            }
+        }
+    }
+    for (int digits = 6; digits < 9; digits++)
+    {
+        int len = sprintf(out, "%.*g", digits, (double)v);
+        if ((float)strtod(out, NULL) == v)
+        {
+            return len;
+        }
+    }
+    return sprintf(out, "%.9g", (double)v);
+}
+
+/// @brief write dataframe to csv file through a large output buffer, with hand-written number formatting
+/// (one fwrite per several MB instead of one fprintf per cell; strings are written as they are,
+/// null values as CAN_NULL_TOKEN, which every csv reader reads back as null)
+/// @param file      I csv filepath
+/// @param df        I dataframe
+/// @param delim     I delimiter
+/// @param precision I decimals of double / float columns, < 0 means shortest text that reads back to the same value
+/// @param banner    I 1 write the "Dataframe (r, c) , dtypes: ..." line like can_write_csv,
+///                    0 only column names, so can_read_csv(..., skip_row = 1) reads it back directly
+void can_write_csv_buffered(const char file[MAX_LINE_LEN], const can_dataframe *df, const char *delim, int precision, int banner)
+{
+    FILE *fp = fopen(file, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "can_write_csv_buffered cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+    if (precision > 100)
+    {
+        fprintf(stderr, "WARNING: can_write_csv_buffered precision = %d > 100, will be cut\n", precision);
+        precision = 100;
+    }
+
+    const size_t buf_cap = (size_t)1 << 22;
+    size_t delim_len = strlen(delim);
+    size_t max_cell = 360 + (precision > 0 ? (size_t)precision : 0) + delim_len; // longest "%.*f" of a double
+    if (max_cell < MAX_COL_LEN + delim_len)
+    {
+        max_cell = MAX_COL_LEN + delim_len;
+    }
+    char *buf = (char *)malloc(buf_cap);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "ERROR: can_write_csv_buffered cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t len = 0;
+
+    if (banner)
+    {
+        len += (size_t)sprintf(buf + len, "Dataframe (%d, %d) , dtypes: %.*s\n", df->n_row, df->n_col, df->n_col, df->dtypes);
+    }
+    for (int j = 0; j < df->n_col; j++)
+    {
+        if (j > 0)
+        {
+            memcpy(buf + len, delim, delim_len);
+            len += delim_len;
+        }
+        size_t n = strlen(df->cols[j]);
+        memcpy(buf + len, df->cols[j], n);
+        len += n;
+    }
+    buf[len++] = '\n';
+
+    for (int i = 0; i < df->n_row; i++)
+    {
+        for (int j = 0; j < df->n_col; j++)
+        {
+            if (buf_cap - len < max_cell + 1)
+            {
+                fwrite(buf, 1, len, fp);
+                len = 0;
+            }
+            if (j > 0)
+            {
+                memcpy(buf + len, delim, delim_len);
+                len += delim_len;
+            }
+            if (!can_row_valid(df, j, i))
+            {
+                memcpy(buf + len, CAN_NULL_TOKEN, sizeof(CAN_NULL_TOKEN) - 1);
+                len += sizeof(CAN_NULL_TOKEN) - 1;
+            }
+            else if (df->dtypes[j] == 'I')
+            {
+                len += (size_t)can_format_int(((int *)(df->values[j]))[i], buf + len);
+            }
+            else if (df->dtypes[j] == 'D')
+            {
+                len += (size_t)can_format_double(((double *)(df->values[j]))[i], precision, buf + len);
+            }
+            else if (df->dtypes[j] == 'C')
+            {
+                buf[len++] = ((char *)(df->values[j]))[i];
+            }
+            else if (df->dtypes[j] == 'f')
+            {
+                len += (size_t)can_format_float(((float *)(df->values[j]))[i], precision, buf + len);
+            }
+            else if (df->dtypes[j] == 'S')
+            {
+                // strings may be longer than a cell
+                int code = ((int *)(df->values[j]))[i];
+                const char *str = code >= 0 ? can_dict_str(df->dicts[j], code) : CAN_NULL_TOKEN;
+                size_t n = strlen(str);
+                if (buf_cap - len < n + 1)
+                {
+                    fwrite(buf, 1, len, fp);
+                    len = 0;
+                }
+                if (n + 1 > buf_cap)
+                {
+                    fwrite(str, 1, n, fp);
+                }
+                else
+                {
+                    memcpy(buf + len, str, n);
+                    len += n;
+                }
+            }
+            else
+            {
+                len += (size_t)can_format_int(can_value_as_int64(df->values[j], df->dtypes[j], i), buf + len);
+            }
+        }
+        buf[len++] = '\n';
+    }
+    fwrite(buf, 1, len, fp);
+
+    free(buf);
+    fclose(fp);
+}
+
+/// @brief column entry of binary file header, see can_save_binary
+typedef struct
+{
+    uint64_t offset;   // byte offset of column block from file start (multiple of 64)
+    uint32_t name_len; // length of column name (without NUL)
+    char dtype;        // data type
+    char flags;        // CAN_BINARY_NULLS if validity bitmap follows the column block
+    char pad[2];
+} can_binary_col;
+
+#define CAN_BINARY_MAGIC "CANDASB1"
+#define CAN_BINARY_ENDIAN 0x01020304u
+#define CAN_BINARY_ALIGN 64
+#define CAN_BINARY_NULLS 1
+
+/// @brief helper function for can_save_binary, write n bytes and stop at once on a short write
+/// @param p       I bytes
+/// @param n       I number of bytes
+/// @param fp      I file
+/// @param written IO bytes written so far
+/// @param file    I file path (for error message)
+static void can_binary_write(const void *p, size_t n, FILE *fp, uint64_t *written, const char *file)
+{
+    if (fwrite(p, 1, n, fp) != n)
+    {
+        fprintf(stderr, "ERROR: can_save_binary cannot write file %s\n", file);
+        exit(EXIT_FAILURE);
+    }
+    *written += n;
+}
+
+/// @brief save dataframe to binary columnar file, which can be loaded without parsing by can_load_binary
+/// file layout (native byte order):
+///   "CANDASB1" | uint32 endian tag | uint32 n_col | int64 n_row | n_col x can_binary_col | column names |
+///   column blocks, each n_row contiguous values starting at a multiple of 64 bytes,
+///   'S' column block is followed by its dictionary: int64 n_str | uint64 bytes | strings of codes 0 .. n_str - 1,
+///   each '\0' terminated, then a column with nulls has its validity bitmap: (n_row + 63) / 64 uint64 words
+/// @param file I binary filepath
+/// @param df   I dataframe
+void can_save_binary(const char file[MAX_LINE_LEN], const can_dataframe *df)
+{
+    FILE *fp = fopen(file, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "can_save_binary cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t endian = CAN_BINARY_ENDIAN;
+    uint32_t n_col = (uint32_t)df->n_col;
+    int64_t n_row = df->n_row;
+    uint64_t pos = 8 + sizeof(endian) + sizeof(n_col) + sizeof(n_row) + sizeof(can_binary_col) * n_col;
+    for (int j = 0; j < df->n_col; j++)
+    {
+        pos += strlen(df->cols[j]) + 1;
+    }
+
+    can_binary_col *entries = (can_binary_col *)calloc(n_col > 0 ? n_col : 1, sizeof(can_binary_col));
+    if (entries == NULL)
+    {
+        fprintf(stderr, "ERROR: can_save_binary cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int j = 0; j < df->n_col; j++)
+    {
+        pos = (pos + CAN_BINARY_ALIGN - 1) / CAN_BINARY_ALIGN * CAN_BINARY_ALIGN;
+        entries[j].offset = pos;
+        entries[j].name_len = (uint32_t)strlen(df->cols[j]);
+        entries[j].dtype = df->dtypes[j];
+        pos += can_dtype_size(df->dtypes[j]) * (uint64_t)df->n_row;
+        if (df->dtypes[j] == 'S')
+        {
+            pos += sizeof(int64_t) + sizeof(uint64_t) + (df->dicts[j] != NULL ? df->dicts[j]->arena_len : 0);
+        }
+        if (df->valid[j] != NULL)
+        {
+            entries[j].flags = CAN_BINARY_NULLS;
+            pos += sizeof(uint64_t) * (((uint64_t)df->n_row + 63) / 64);
+        }
+    }
+
+    // header
+    uint64_t written = 0;
+    can_binary_write(CAN_BINARY_MAGIC, 8, fp, &written, file);
+    can_binary_write(&endian, sizeof(endian), fp, &written, file);
+    can_binary_write(&n_col, sizeof(n_col), fp, &written, file);
+    can_binary_write(&n_row, sizeof(n_row), fp, &written, file);
+    can_binary_write(entries, sizeof(can_binary_col) * n_col, fp, &written, file);
+    for (int j = 0; j < df->n_col; j++)
+    {
+        can_binary_write(df->cols[j], entries[j].name_len + 1, fp, &written, file);
+    }
+
+    // aligned column blocks
+    static const char zeros[CAN_BINARY_ALIGN] = {0};
+    for (int j = 0; j < df->n_col; j++)
+    {
+        while (written < entries[j].offset)
+        {
+            uint64_t n = entries[j].offset - written;
+            can_binary_write(zeros, n < CAN_BINARY_ALIGN ? (size_t)n : CAN_BINARY_ALIGN, fp, &written, file);
+        }
+        can_binary_write(df->values[j], can_dtype_size(df->dtypes[j]) * (size_t)df->n_row, fp, &written, file);
+        if (df->dtypes[j] == 'S')
+        {
+            const can_dict *d = df->dicts[j];
+            int64_t n_str = d != NULL ? d->n_str : 0;
+            uint64_t bytes = d != NULL ? d->arena_len : 0;
+            can_binary_write(&n_str, sizeof(n_str), fp, &written, file);
+            can_binary_write(&bytes, sizeof(bytes), fp, &written, file);
+            if (bytes > 0)
+            {
+                can_binary_write(d->arena, bytes, fp, &written, file);
+            }
+        }
+        if (df->valid[j] != NULL)
+        {
+            can_binary_write(df->valid[j], sizeof(uint64_t) * (((size_t)df->n_row + 63) / 64), fp, &written, file);
+        }
+    }
+    free(entries);
+    if (written != pos || fclose(fp) != 0)
+    {
+        fprintf(stderr, "ERROR: can_save_binary cannot write file %s\n", file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// @brief load binary columnar file saved by can_save_binary without parsing or copying:
+/// the file is memory mapped and columns point straight into the mapping
+/// (read-only dataframe: can_set_* will fail, do not write through can_get_*_pointer,
+/// pages are shared with other processes mapping the same file, can_free unmaps the file)
+/// @param file I binary filepath
+/// @return read-only dataframe
+can_dataframe *can_load_binary(const char file[MAX_LINE_LEN])
+{
+    size_t len = 0;
+    const char *buf = can_map_file(file, &len);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "can_load_binary cannot open file %s", file);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t endian = 0;
+    uint32_t n_col = 0;
+    int64_t n_row = 0;
+    size_t head = 8 + sizeof(endian) + sizeof(n_col) + sizeof(n_row);
+    if (len < head || memcmp(buf, CAN_BINARY_MAGIC, 8) != 0)
+    {
+        fprintf(stderr, "ERROR: can_load_binary %s is not a candas binary file\n", file);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&endian, buf + 8, sizeof(endian));
+    memcpy(&n_col, buf + 12, sizeof(n_col));
+    memcpy(&n_row, buf + 16, sizeof(n_row));
+    if (endian != CAN_BINARY_ENDIAN)
+    {
+        fprintf(stderr, "ERROR: can_load_binary %s is saved with different byte order\n", file);
+        exit(EXIT_FAILURE);
+    }
+    if (n_col == 0 || n_col > (len - head) / sizeof(can_binary_col) || n_col > INT_MAX || n_row < 0 || n_row > INT_MAX)
+    {
+        fprintf(stderr, "ERROR: can_load_binary %s has invalid header\n", file);
+        exit(EXIT_FAILURE);
+    }
+
+    can_dataframe *df = can_frame_new((int)n_row, (int)n_col, NULL, 0, "can_load_binary");
+    df->mapping = buf;
+    df->mapping_len = len;
+
+    const char *name = buf + head + sizeof(can_binary_col) * n_col;
+    for (uint32_t j = 0; j < n_col; j++)
+    {
+        can_binary_col entry;
+        memcpy(&entry, buf + head + sizeof(can_binary_col) * j, sizeof(can_binary_col));
+        if (!can_dtype_valid(entry.dtype) ||
+            entry.offset % CAN_BINARY_ALIGN != 0 ||
+            entry.offset + can_dtype_size(entry.dtype) * (uint64_t)n_row > len ||
+            (size_t)(name - buf) + entry.name_len + 1 > len)
+        {
+            fprintf(stderr, "ERROR: can_load_binary %s has invalid column %u\n", file, j);
+            exit(EXIT_FAILURE);
+        }
+        if (entry.name_len >= MAX_COL_LEN)
+        {
+            fprintf(stderr, "WARNING: can_load_binary col name %.*s exceed MAX_COL_LEN = %d, col name will be cut\n", (int)entry.name_len, name, MAX_COL_LEN);
+        }
+        strncpy(df->cols[j], name, MAX_COL_LEN - 1);
+        df->dtypes[j] = entry.dtype;
+        df->values[j] = (void *)(buf + entry.offset);
+        name += entry.name_len + 1;
+        size_t at = entry.offset + can_dtype_size(entry.dtype) * (size_t)n_row;
+        if (entry.dtype == 'S')
+        {
+            // dictionary is rebuilt in memory, codes stay in the mapping
+            int64_t n_str = 0;
+            uint64_t bytes = 0;
+            if (at + sizeof(n_str) + sizeof(bytes) <= len)
+            {
+                memcpy(&n_str, buf + at, sizeof(n_str));
+                memcpy(&bytes, buf + at + sizeof(n_str), sizeof(bytes));
+            }
+            at += sizeof(n_str) + sizeof(bytes);
+            if (at > len || bytes > len - at || n_str < 0 || n_str > INT_MAX || (bytes > 0 && buf[at + bytes - 1] != '\0'))
+            {
+                fprintf(stderr, "ERROR: can_load_binary %s has invalid dictionary of column %u\n", file, j);
+                exit(EXIT_FAILURE);
+            }
+            can_dict *d = can_col_dict(df, (int)j);
+            for (size_t k = 0; k < bytes && d->n_str < n_str; k += strlen(buf + at + k) + 1)
+            {
+                can_dict_intern(d, buf + at + k, strlen(buf + at + k));
+            }
+            int bad = d->n_str != n_str;
+            for (int i = 0; i < (int)n_row && !bad; i++)
+            {
+                int code;
+                memcpy(&code, buf + entry.offset + sizeof(int) * (size_t)i, sizeof(int));
+                bad = code < MISS_STR || code >= n_str;
+            }
+            if (bad)
+            {
+                fprintf(stderr, "ERROR: can_load_binary %s has invalid dictionary of column %u\n", file, j);
+                exit(EXIT_FAILURE);
+            }
+            at += bytes;
+        }
+        if (entry.flags & CAN_BINARY_NULLS)
+        {
+            // validity bitmap is small, copied so that it can be owned like any other
+            size_t n_word = ((size_t)n_row + 63) / 64;
+            if (at > len || sizeof(uint64_t) * n_word > len - at)
+            {
+                fprintf(stderr, "ERROR: can_load_binary %s has invalid validity bitmap of column %u\n", file, j);
+                exit(EXIT_FAILURE);
+            }
+            uint64_t *valid = can_valid_col(df, (int)j);
+            memcpy(valid, buf + at, sizeof(uint64_t) * n_word);
+            if (n_row & 63)
+            {
+                valid[n_word - 1] |= ~(((uint64_t)1 << (n_row & 63)) - 1); // rows past n_row stay valid
+            }
+        }
+    }
+    can_build_col_hash(df);
+    return df;
+}
+
+/// @brief print n_row of df on screen
+/// @param df     I dataframe to be shown
+/// @param n_row  I n row
+void can_print(const can_dataframe *df, int n_row)
+{
+    if (n_row > df->n_row)
+    {
+        fprintf(stderr, "WARNING: can_print n_row > df->n_row, will be cut\n");
+        n_row = df->n_row;
+    }
+
+    printf("Dataframe (%d, %d) , dtypes: %s\n", df->n_row, df->n_col, df->dtypes);
+
+    for (int j = 0; j < df->n_col; j++)
+    {
+        printf("%s\t", df->cols[j]);
+    }
+    printf("\n");
+
+    for (int i = 0; i < n_row; i++)
+    {
+        for (int j = 0; j < df->n_col; j++)
+        {
+            if (df->dtypes[j] == 'I')
+            {
+                printf("% d\t", ((int *)(df->values[j]))[i]);
+            }
+            else if (df->dtypes[j] == 'D')
+            {
+                printf("% e\t", ((double *)(df->values[j]))[i]);
+            }
+            else if (df->dtypes[j] == 'C')
+            {
+                printf("%c\t", ((char *)(df->values[j]))[i]);
+            }
+            else if (df->dtypes[j] == 'f')
+            {
+                printf("% e\t", ((float *)(df->values[j]))[i]);
+            }
+            else if (df->dtypes[j] == 'S')
+            {
+                int code = ((int *)(df->values[j]))[i];
+                printf("%s\t", code >= 0 ? can_dict_str(df->dicts[j], code) : "");
+            }
+            else
+            {
+                printf("% lld\t", (long long)can_value_as_int64(df->values[j], df->dtypes[j], i));
+            }
+        }
+        printf("\n");
+    }
+}
+
+/// @brief get int type value by row and col name
+/// @param df  I dataframe
+/// @param row I row number(start from 0)
+/// @param col I col name
+/// @return integer type value
+int can_get_int(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_get_int row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_get_int invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_get_int cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'I')
+    {
+        fprintf(stderr, "ERORR: can_get_int found col=%s but it is not integer type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    int res = ((int *)df->values[found_col])[row];
+    return res;
+}
+
+/// @brief get double type value by row and col name (float columns are widened)
+/// @param df  I dataframe
+/// @param row I row number(start from 0)
+/// @param col I col name
+/// @return double type value
+double can_get_double(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_get_double row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_get_double invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_get_double cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (!can_dtype_accepts(df->dtypes[found_col], 'D'))
+    {
+        fprintf(stderr, "ERORR: can_get_double found col=%s but it is not double type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    double res = can_value_as_double(df->values[found_col], df->dtypes[found_col], row);
+    return res;
+}
+
+/// @brief get char type value by row and col name
+/// @param df  I dataframe
+/// @param row I row number(start from 0)
+/// @param col I col name
+/// @return char type value
+char can_get_char(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_get_char row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_get_char invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_get_char cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'C')
+    {
+        fprintf(stderr, "ERORR: can_get_char found col=%s but it is not char type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    char res = ((char *)df->values[found_col])[row];
+    return res;
+}
+
+/// @brief get value of any integer column ('I'/'b'/'h'/'l'/'u') by row and col name
+/// @param df  I dataframe
+/// @param row I row number(start from 0)
+/// @param col I col name
+/// @return int64 type value
+int64_t can_get_int64(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERROR: can_get_int64 row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERROR: can_get_int64 invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_get_int64 cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (!can_dtype_is_int(df->dtypes[found_col]))
+    {
+        fprintf(stderr, "ERROR: can_get_int64 found col=%s but it is not integer type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    return can_value_as_int64(df->values[found_col], df->dtypes[found_col], row);
+}
+
+/// @brief get string value by row and col name
+/// @param df  I dataframe
+/// @param row I row number(start from 0)
+/// @param col I col name of string type
+/// @return string (owned by the column dictionary, valid while a dataframe sharing it lives), NULL if missing
+const char *can_get_str(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERROR: can_get_str row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERROR: can_get_str invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_get_str cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'S')
+    {
+        fprintf(stderr, "ERROR: can_get_str found col=%s but it is not string type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    int code = ((int *)df->values[found_col])[row];
+    return code >= 0 ? can_dict_str(df->dicts[found_col], code) : NULL;
+}
+
+/// @brief set int type value of df
+/// @param df    IO dataframe
+/// @param row   I number of row
+/// @param col   I column name
+/// @param value I given integer type value
+void can_set_int(can_dataframe *df, int row, char col[MAX_COL_LEN], int value)
+{
+    if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_set_int dataframe is read-only (loaded by can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_set_int row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_set_int invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_set_int cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'I')
+    {
+        fprintf(stderr, "ERORR: can_set_int found col=%s but it is not char type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    ((int *)df->values[found_col])[row] = value;
+    can_set_row_valid(df, found_col, row);
+    can_col_modified(df, found_col);
+}
+
+/// @brief set double type value of df (rounded for float columns)
+/// @param df    IO dataframe
+/// @param row   I number of row
+/// @param col   I column name
+/// @param value I given double type value
+void can_set_double(can_dataframe *df, int row, char col[MAX_COL_LEN], double value)
+{
+    if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_set_double dataframe is read-only (loaded by can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_set_double row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_set_double invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_set_double cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (!can_dtype_accepts(df->dtypes[found_col], 'D'))
+    {
+        fprintf(stderr, "ERORR: can_set_double found col=%s but it is not char type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    if (df->dtypes[found_col] == 'f')
+    {
+        ((float *)df->values[found_col])[row] = (float)value;
+    }
+    else
+    {
+        ((double *)df->values[found_col])[row] = value;
+    }
+    can_set_row_valid(df, found_col, row);
+    can_col_modified(df, found_col);
+}
+
+/// @brief set char type value of df
+/// @param df    IO dataframe
+/// @param row   I number of row
+/// @param col   I column name
+/// @param value I given char type value
+void can_set_char(can_dataframe *df, int row, char col[MAX_COL_LEN], char value)
+{
+    if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_set_char dataframe is read-only (loaded by can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_set_char row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_set_char invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_set_char cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'C')
+    {
+        fprintf(stderr, "ERORR: can_set_char found col=%s but it is not char type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    ((char *)df->values[found_col])[row] = value;
+    can_set_row_valid(df, found_col, row);
+    can_col_modified(df, found_col);
+}
+
+/// @brief set value of any integer column ('I'/'b'/'h'/'l'/'u') of df
+/// @param df    IO dataframe
+/// @param row   I number of row
+/// @param col   I column name
+/// @param value I given value, must fit in the column type
+void can_set_int64(can_dataframe *df, int row, char col[MAX_COL_LEN], int64_t value)
+{
+    if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_set_int64 dataframe is read-only (loaded by can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERROR: can_set_int64 row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERROR: can_set_int64 invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_set_int64 cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (!can_dtype_is_int(df->dtypes[found_col]))
+    {
+        fprintf(stderr, "ERROR: can_set_int64 found col=%s but it is not integer type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    int64_t tmin, tmax;
+    can_int_limits(df->dtypes[found_col], &tmin, &tmax);
+    if (value < tmin || value > tmax)
+    {
+        fprintf(stderr, "ERROR: can_set_int64 value=%lld does not fit in col=%s of type %c\n", (long long)value, col, df->dtypes[found_col]);
+        exit(EXIT_FAILURE);
+    }
+    can_value_set_int64(df->values[found_col], df->dtypes[found_col], row, value);
+    can_set_row_valid(df, found_col, row);
+    can_col_modified(df, found_col);
+}
+
+/// @brief set string value of df (added to the column dictionary if new)
+/// @param df    IO dataframe
+/// @param row   I number of row
+/// @param col   I column name of string type
+/// @param value I given string (copied), NULL means missing
+void can_set_str(can_dataframe *df, int row, char col[MAX_COL_LEN], const char *value)
+{
+    if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_set_str dataframe is read-only (loaded by can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERROR: can_set_str row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERROR: can_set_str invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_set_str cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'S')
+    {
+        fprintf(stderr, "ERROR: can_set_str found col=%s but it is not string type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    if (value != NULL)
+    {
+        ((int *)df->values[found_col])[row] = can_dict_intern(can_col_dict(df, found_col), value, strlen(value));
+        can_set_row_valid(df, found_col, row);
+    }
+    else
+    {
+        can_set_row_null(df, found_col, row);
+    }
+    can_col_modified(df, found_col);
+}
+
+/// @brief whether value of df is null (missing)
+/// @param df  I dataframe
+/// @param row I number of row
+/// @param col I column name
+/// @return 1 if null, 0 if not
+int can_is_null(const can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (row >= df->n_row || row < 0)
+    {
+        fprintf(stderr, "ERROR: can_is_null invalid row=%d, df->n_row=%d\n", row, df->n_row);
+        exit(EXIT_FAILURE);
+    }
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_is_null cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    return !can_row_valid(df, found_col, row);
+}
+
+/// @brief set value of df null (the MISS_* value of its type is stored too), any set function makes it valid again
+/// @param df  IO dataframe
+/// @param row I  number of row
+/// @param col I  column name
+void can_set_null(can_dataframe *df, int row, char col[MAX_COL_LEN])
+{
+    if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_set_null dataframe is read-only (loaded by can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (row >= df->n_row || row < 0)
+    {
+        fprintf(stderr, "ERROR: can_set_null invalid row=%d, df->n_row=%d\n", row, df->n_row);
+        exit(EXIT_FAILURE);
+    }
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_set_null cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_set_row_null(df, found_col, row);
+    can_col_modified(df, found_col);
+}
+
+/// @brief number of null values in a column of df
+/// @param df  I dataframe
+/// @param col I column name
+/// @return null count (0 without validity bitmap)
+int can_null_count(const can_dataframe *df, char col[MAX_COL_LEN])
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_null_count cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    if (df->valid[found_col] == NULL)
+    {
+        return 0;
+    }
+    int n_valid = 0;
+    for (int w = 0; w < (df->n_row + 63) / 64; w++)
+    {
+        n_valid += can_popcount64(can_valid_word(df->valid[found_col], w, df->n_row));
+    }
+    return df->n_row - n_valid;
+}
+
+/// @brief resolve column by name once, for fast access by can_hget_* / can_hset_* in loops
+/// @param df  I dataframe
+/// @param col I column name
+/// @return column handle (valid as long as df's columns are not changed)
+can_col_handle can_get_col_handle(const can_dataframe *df, char col[MAX_COL_LEN])
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_get_col_handle cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_col_handle h = {found_col, df->dtypes[found_col]};
+    return h;
+}
+
+/// @brief get int type value by column handle (no row / type check)
+/// @param df  I dataframe
+/// @param h   I handle of int column
+/// @param row I row number(start from 0)
+/// @return integer type value
+static inline int can_hget_int(const can_dataframe *df, can_col_handle h, int row)
+{
+    return ((const int *)df->values[h.col])[row];
+}
+
+/// @brief get double type value by column handle (no row / type check)
+/// @param df  I dataframe
+/// @param h   I handle of double column
+/// @param row I row number(start from 0)
+/// @return double type value
+static inline double can_hget_double(const can_dataframe *df, can_col_handle h, int row)
+{
+    return ((const double *)df->values[h.col])[row];
+}
+
+/// @brief get char type value by column handle (no row / type check)
+/// @param df  I dataframe
+/// @param h   I handle of char column
+/// @param row I row number(start from 0)
+/// @return char type value
+static inline char can_hget_char(const can_dataframe *df, can_col_handle h, int row)
+{
+    return ((const char *)df->values[h.col])[row];
+}
+
+/// @brief get value of any integer column ('I' / 'b' / 'h' / 'l' / 'u') by column handle (no row / type check)
+/// @param df  I dataframe
+/// @param h   I handle of integer column
+/// @param row I row number(start from 0)
+/// @return integer value widened to int64
+static inline int64_t can_hget_int64(const can_dataframe *df, can_col_handle h, int row)
+{
+    return can_value_as_int64(df->values[h.col], h.dtype, row);
+}
+
+/// @brief set int type value by column handle (no row / type / read-only check)
+/// @param df    IO dataframe
+/// @param h     I  handle of int column
+/// @param row   I  row number(start from 0)
+/// @param value I  given integer type value
+static inline void can_hset_int(can_dataframe *df, can_col_handle h, int row, int value)
+{
+    ((int *)df->values[h.col])[row] = value;
+    can_set_row_valid(df, h.col, row);
+    can_col_modified(df, h.col);
+}
+
+/// @brief set double type value by column handle (no row / type / read-only check)
+/// @param df    IO dataframe
+/// @param h     I  handle of double column
+/// @param row   I  row number(start from 0)
+/// @param value I  given double type value
+static inline void can_hset_double(can_dataframe *df, can_col_handle h, int row, double value)
+{
+    ((double *)df->values[h.col])[row] = value;
+    can_set_row_valid(df, h.col, row);
+    can_col_modified(df, h.col);
+}
+
+/// @brief set char type value by column handle (no row / type / read-only check)
+/// @param df    IO dataframe
+/// @param h     I  handle of char column
+/// @param row   I  row number(start from 0)
+/// @param value I  given char type value
+static inline void can_hset_char(can_dataframe *df, can_col_handle h, int row, char value)
+{
+    ((char *)df->values[h.col])[row] = value;
+    can_set_row_valid(df, h.col, row);
+    can_col_modified(df, h.col);
+}
+
+/// @brief set value of any integer column by column handle (no row / type / range / read-only check,
+/// value is converted like a C cast)
+/// @param df    IO dataframe
+/// @param h     I  handle of integer column
+/// @param row   I  row number(start from 0)
+/// @param value I  given integer value
+static inline void can_hset_int64(can_dataframe *df, can_col_handle h, int row, int64_t value)
+{
+    can_value_set_int64(df->values[h.col], h.dtype, row, value);
+    can_set_row_valid(df, h.col, row);
+    can_col_modified(df, h.col);
+}
+
+/// @brief return the pointer to df's col of integer type
+/// @param df  I dataframe
+/// @param col I column name
+/// @return integer pointer (shallow copy)
+/// (values may be written through it; zone maps / index of col are invalidated when the pointer is taken,
+/// but later writes through it are not seen: call can_mark_modified(df, col) after writing,
+/// otherwise filters that ran in between rebuilt them and keep using the old values)
+int *can_get_int_pointer(can_dataframe *df, char col[MAX_COL_LEN])
+{
+    // check if col exist, and data type is int
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_get_int_pointer cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'I')
+    {
+        fprintf(stderr, "ERORR: can_get_int_pointer found col=%s, but it is not integer type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_col_modified(df, found_col);
+    return df->values[found_col];
+}
+
+/// @brief return the pointer to df's col of double type
+/// @param df  I dataframe
+/// @param col I column name
+/// @return double pointer (shallow copy)
+/// (values may be written through it; zone maps / index of col are invalidated when the pointer is taken,
+/// but later writes through it are not seen: call can_mark_modified(df, col) after writing,
+/// otherwise filters that ran in between rebuilt them and keep using the old values)
+double *can_get_double_pointer(can_dataframe *df, char col[MAX_COL_LEN])
+{
+    // check if col exist, and data type is double
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_get_double_pointer cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'D')
+    {
+        fprintf(stderr, "ERORR: can_get_double_pointer found col=%s, but it is not double type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_col_modified(df, found_col);
+    return df->values[found_col];
+}
+
+/// @brief return the pointer to df's col of char type
+/// @param df  I dataframe
+/// @param col I column name
+/// @return char pointer (shallow copy)
+/// (values may be written through it; zone maps / index of col are invalidated when the pointer is taken,
+/// but later writes through it are not seen: call can_mark_modified(df, col) after writing,
+/// otherwise filters that ran in between rebuilt them and keep using the old values)
+char *can_get_char_pointer(can_dataframe *df, char col[MAX_COL_LEN])
+{
+    // check if col exist, and data type is char
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_get_char_pointer cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'C')
+    {
+        fprintf(stderr, "ERORR: can_get_char_pointer found col=%s, but it is not char type\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_col_modified(df, found_col);
+    return df->values[found_col];
+}
+
+/// @brief return the pointer to df's col of any data type, e.g. (int16_t *)can_get_pointer(df, "ANT1", 'h')
+/// @param df    I dataframe
+/// @param col   I column name
+/// @param dtype I expected data type of col
+/// @return pointer to values (shallow copy), same rules as can_get_int_pointer
+void *can_get_pointer(can_dataframe *df, char col[MAX_COL_LEN], char dtype)
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_get_pointer cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != dtype)
+    {
+        fprintf(stderr, "ERROR: can_get_pointer found col=%s, but it is not %c type\n", col, dtype);
+        exit(EXIT_FAILURE);
+    }
+    can_col_modified(df, found_col);
+    return df->values[found_col];
+}
+
+/// @brief tell dataframe that values of col were written through a pointer, invalidate its derived data (zone maps, index)
+/// @param df  IO dataframe
+/// @param col I  column name, NULL means all columns
+void can_mark_modified(can_dataframe *df, const char *col)
+{
+    for (int j = 0; j < df->n_col; j++)
+    {
+        if (col == NULL || strncmp(df->cols[j], col, MAX_COL_LEN) == 0)
+        {
+            can_col_modified(df, j);
+        }
+    }
+}
+
+/// @brief let filters keep min / max of the non-null values of every block of block_rows rows of each column,
+/// built lazily by the first filter on a column and dropped by can_set_* / can_hset_* / can_get_*_pointer /
+/// can_mark_modified (writes through a raw column pointer need can_mark_modified),
+/// filters then skip blocks that cannot match and take blocks that match entirely without testing rows
+/// (useful when values are clustered, e.g. time ordered data)
+/// @param df         IO dataframe
+/// @param block_rows I  rows per block, multiple of CAN_PRED_CHUNK (4096), e.g. 4096 or 65536, 0 to disable
+void can_enable_zone_maps(can_dataframe *df, int block_rows)
+{
+    if (block_rows < 0 || block_rows % CAN_PRED_CHUNK != 0)
+    {
+        fprintf(stderr, "ERROR: can_enable_zone_maps block_rows = %d is not a multiple of %d\n", block_rows, CAN_PRED_CHUNK);
+        exit(EXIT_FAILURE);
+    }
+    can_mark_modified(df, NULL);
+    df->zone_rows = block_rows;
+}
+
+/// @brief select one column by name from dataframe
+/// @param df  I dataframe
+/// @param col I column name
+/// @return sub dataframe (deep copy)
+can_dataframe *can_select_col(const can_dataframe *df, char col[MAX_COL_LEN])
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_select_col cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    can_dataframe *res = can_alloc_cols_of(df, df->n_row, 1, &found_col, "can_select_col");
+    memcpy(res->values[0], df->values[found_col], can_dtype_size(res->dtypes[0]) * df->n_row);
+    can_valid_copy(res, 0, 0, df->valid[found_col], 0, df->n_row);
+    return res;
+}
+
+/// @brief select multiple columns from a dataframe
+/// @param df    I dataframe
+/// @param n_col I number of columns selected
+/// @param cols  I column names
+/// @return sub dataframe (deep copy)
+can_dataframe *can_select_cols(const can_dataframe *df, int n_col, char cols[MAX_COL_NUM][MAX_COL_LEN])
+{
+    int *src_cols = (int *)can_malloc(sizeof(int) * n_col, "can_select_cols");
+    for (int k = 0; k < n_col; k++)
+    {
+        char *col = cols[k];
+        int found_col = can_find_col(df, col);
+        if (found_col == -1)
+        {
+            fprintf(stderr, "ERORR: can_select_cols cannot found col=%s\n", col);
+            exit(EXIT_FAILURE);
+        }
+        src_cols[k] = found_col;
+    }
+    can_dataframe *res = can_alloc_cols_of(df, df->n_row, n_col, src_cols, "can_select_cols");
+    for (int k = 0; k < n_col; k++)
+    {
+        memcpy(res->values[k], df->values[src_cols[k]], can_dtype_size(res->dtypes[k]) * df->n_row);
+        can_valid_copy(res, k, 0, df->valid[src_cols[k]], 0, df->n_row);
+    }
+    free(src_cols);
+    return res;
+}
+
+/// @brief select one row from dataframe
+/// @param df  I dataframe
+/// @param row I number of row
+/// @return sub dataframe (deep copy)
+can_dataframe *can_select_row(const can_dataframe *df, int row)
+{
+    if (row >= df->n_row)
+    {
+        fprintf(stderr, "ERORR: can_select_row row=%d >= df->n_row\n", row);
+        exit(EXIT_FAILURE);
+    }
+    else if (row < 0)
+    {
+        fprintf(stderr, "ERORR: can_select_row invalid row=%d < 0\n", row);
+        exit(EXIT_FAILURE);
+    }
+
+    return can_take_rows(df, &row, 1);
+}
+
+/// @brief select multiple rows (not necessarily in ascending order) from a dataframe
+/// @param df    I dataframe
+/// @param n_row I number of rows
+/// @param rows  I rows number
+/// @return sub dataframe (deep copy)
+can_dataframe *can_select_rows(const can_dataframe *df, int n_row, int *rows)
+{
+    for (int k = 0; k < n_row; k++)
+    {
+        int row = rows[k];
+        if (row >= df->n_row)
+        {
+            fprintf(stderr, "ERORR: can_select_rows row=%d >= df->n_row\n", row);
+            exit(EXIT_FAILURE);
+        }
+        else if (row < 0)
+        {
+            fprintf(stderr, "ERORR: can_select_rows invalid row=%d < 0\n", row);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return can_take_rows(df, rows, n_row);
+}
+
+/// @brief helper function, whether the running cpu supports AVX2 (checked once)
+/// @return 1 if supported, 0 otherwise
+static int can_cpu_has_avx2(void)
+{
+#if CANDAS_HAVE_AVX2_DISPATCH
+    static int has_avx2 = -1;
+    if (has_avx2 < 0)
+    {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return has_avx2;
+#else
+    return 0;
+#endif
+}
+
+#if CANDAS_HAVE_AVX2_DISPATCH
+/// @brief helper function, AVX2 kernel of can_mask_range_int, handles whole 64 row words only
+/// @return number of rows handled
+__attribute__((target("avx2"))) static int can_mask_range_int_avx2(const int *vs, int n, int min, int max, uint64_t *mask)
+{
+    const __m256i lo = _mm256_set1_epi32(min);
+    const __m256i hi = _mm256_set1_epi32(max);
+    int i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 64; b += 8)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(vs + i + b));
+            __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(lo, x), _mm256_cmpgt_epi32(x, hi));
+            word |= (uint64_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xff) << b;
+        }
+        mask[i >> 6] = word;
+    }
+    return i;
+}
+
+/// @brief helper function, AVX2 kernel of can_mask_range_double, handles whole 64 row words only
+/// @return number of rows handled
+__attribute__((target("avx2"))) static int can_mask_range_double_avx2(const double *vs, int n, double min, double max, uint64_t *mask)
+{
+    const __m256d lo = _mm256_set1_pd(min);
+    const __m256d hi = _mm256_set1_pd(max);
+    int i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 64; b += 4)
+        {
+            __m256d x = _mm256_loadu_pd(vs + i + b);
+            __m256d in = _mm256_and_pd(_mm256_cmp_pd(x, lo, _CMP_GE_OQ), _mm256_cmp_pd(x, hi, _CMP_LE_OQ));
+            word |= (uint64_t)_mm256_movemask_pd(in) << b;
+        }
+        mask[i >> 6] = word;
+    }
+    return i;
+}
+
+/// @brief helper function, AVX2 kernel of can_mask_range_char, handles whole 64 row words only
+/// @return number of rows handled
+__attribute__((target("avx2"))) static int can_mask_range_char_avx2(const char *vs, int n, char min, char max, uint64_t *mask)
+{
+    // signed byte compare, shift unsigned char into signed range
+    const __m256i bias = _mm256_set1_epi8(CHAR_MIN < 0 ? 0 : (char)0x80);
+    const __m256i lo = _mm256_xor_si256(_mm256_set1_epi8(min), bias);
+    const __m256i hi = _mm256_xor_si256(_mm256_set1_epi8(max), bias);
+    int i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 64; b += 32)
+        {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(vs + i + b)), bias);
+            __m256i out = _mm256_or_si256(_mm256_cmpgt_epi8(lo, x), _mm256_cmpgt_epi8(x, hi));
+            word |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(out) << b;
+        }
+        mask[i >> 6] = word;
+    }
+    return i;
+}
+#endif
+
+#if !defined(CANDAS_NO_SIMD) && defined(__SSE2__)
+/// @brief helper function, SSE2 kernel of can_mask_range_int, handles whole 64 row words only
+/// @return number of rows handled
+static int can_mask_range_int_sse2(const int *vs, int n, int min, int max, uint64_t *mask)
+{
+    const __m128i lo = _mm_set1_epi32(min);
+    const __m128i hi = _mm_set1_epi32(max);
+    int i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 64; b += 4)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(vs + i + b));
+            __m128i out = _mm_or_si128(_mm_cmpgt_epi32(lo, x), _mm_cmpgt_epi32(x, hi));
+            word |= (uint64_t)(~_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xf) << b;
+        }
+        mask[i >> 6] = word;
+    }
+    return i;
+}
+
+/// @brief helper function, SSE2 kernel of can_mask_range_double, handles whole 64 row words only
+/// @return number of rows handled
+static int can_mask_range_double_sse2(const double *vs, int n, double min, double max, uint64_t *mask)
+{
+    const __m128d lo = _mm_set1_pd(min);
+    const __m128d hi = _mm_set1_pd(max);
+    int i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 64; b += 2)
+        {
+            __m128d x = _mm_loadu_pd(vs + i + b);
+            __m128d in = _mm_and_pd(_mm_cmpge_pd(x, lo), _mm_cmple_pd(x, hi));
+            word |= (uint64_t)_mm_movemask_pd(in) << b;
+        }
+        mask[i >> 6] = word;
+    }
+    return i;
+}
+
+/// @brief helper function, SSE2 kernel of can_mask_range_char, handles whole 64 row words only
+/// @return number of rows handled
+static int can_mask_range_char_sse2(const char *vs, int n, char min, char max, uint64_t *mask)
+{
+    // signed byte compare, shift unsigned char into signed range
+    const __m128i bias = _mm_set1_epi8(CHAR_MIN < 0 ? 0 : (char)0x80);
+    const __m128i lo = _mm_xor_si128(_mm_set1_epi8(min), bias);
+    const __m128i hi = _mm_xor_si128(_mm_set1_epi8(max), bias);
+    int i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 64; b += 16)
+        {
+            __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(vs + i + b)), bias);
+            __m128i out = _mm_or_si128(_mm_cmpgt_epi8(lo, x), _mm_cmpgt_epi8(x, hi));
+            word |= (uint64_t)(~_mm_movemask_epi8(out) & 0xffff) << b;
+        }
+        mask[i >> 6] = word;
+    }
+    return i;
+}
+#endif
+
+/// @brief helper function, set bit i of mask if min <= vs[i] <= max
+/// @param vs   I values
+/// @param n    I number of values
+/// @param min  I min value
+/// @param max  I max value
+/// @param mask O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_int(const int *vs, int n, int min, int max, uint64_t *mask)
+{
+    int i = 0;
+#if CANDAS_HAVE_AVX2_DISPATCH
+    if (can_cpu_has_avx2())
+    {
+        i = can_mask_range_int_avx2(vs, n, min, max, mask);
+    }
+    else
+#endif
+    {
+#if !defined(CANDAS_NO_SIMD) && defined(__SSE2__)
+        i = can_mask_range_int_sse2(vs, n, min, max, mask);
+#endif
+    }
+    for (; i < n; i += 64)
+    {
+        uint64_t word = 0;
+        int n_bit = n - i < 64 ? n - i : 64;
+        for (int b = 0; b < n_bit; b++)
+        {
+            word |= (uint64_t)(vs[i + b] >= min && vs[i + b] <= max) << b;
+        }
+        mask[i >> 6] = word;
+    }
+}
+
+/// @brief helper function, set bit i of mask if min <= vs[i] <= max (NaN never matches)
+/// @param vs   I values
+/// @param n    I number of values
+/// @param min  I min value
+/// @param max  I max value
+/// @param mask O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_double(const double *vs, int n, double min, double max, uint64_t *mask)
+{
+    int i = 0;
+#if CANDAS_HAVE_AVX2_DISPATCH
+    if (can_cpu_has_avx2())
+    {
+        i = can_mask_range_double_avx2(vs, n, min, max, mask);
+    }
+    else
+#endif
+    {
+#if !defined(CANDAS_NO_SIMD) && defined(__SSE2__)
+        i = can_mask_range_double_sse2(vs, n, min, max, mask);
+#endif
+    }
+    for (; i < n; i += 64)
+    {
+        uint64_t word = 0;
+        int n_bit = n - i < 64 ? n - i : 64;
+        for (int b = 0; b < n_bit; b++)
+        {
+            word |= (uint64_t)(vs[i + b] >= min && vs[i + b] <= max) << b;
+        }
+        mask[i >> 6] = word;
+    }
+}
+
+/// @brief helper function, set bit i of mask if min <= vs[i] <= max
+/// @param vs   I values
+/// @param n    I number of values
+/// @param min  I min value
+/// @param max  I max value
+/// @param mask O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_char(const char *vs, int n, char min, char max, uint64_t *mask)
+{
+    int i = 0;
+#if CANDAS_HAVE_AVX2_DISPATCH
+    if (can_cpu_has_avx2())
+    {
+        i = can_mask_range_char_avx2(vs, n, min, max, mask);
+    }
+    else
+#endif
+    {
+#if !defined(CANDAS_NO_SIMD) && defined(__SSE2__)
+        i = can_mask_range_char_sse2(vs, n, min, max, mask);
+#endif
+    }
+    for (; i < n; i += 64)
+    {
+        uint64_t word = 0;
+        int n_bit = n - i < 64 ? n - i : 64;
+        for (int b = 0; b < n_bit; b++)
+        {
+            word |= (uint64_t)(vs[i + b] >= min && vs[i + b] <= max) << b;
+        }
+        mask[i >> 6] = word;
+    }
+}
+
+/// @brief helper function, set bit i of mask if lo <= vs[i] <= hi, for int8 / int16 / int64 / uint32 columns
+/// @param vs    I values
+/// @param dtype I data type 'b' / 'h' / 'l' / 'u'
+/// @param n     I number of values
+/// @param lo    I min value
+/// @param hi    I max value
+/// @param mask  O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_int64(const void *vs, char dtype, int n, int64_t lo, int64_t hi, uint64_t *mask)
+{
+    for (int i = 0; i < n; i += 64)
+    {
+        uint64_t word = 0;
+        int n_bit = n - i < 64 ? n - i : 64;
+        switch (dtype)
+        {
+        case 'b':
+            for (int b = 0; b < n_bit; b++)
+            {
+                int64_t v = ((const int8_t *)vs)[i + b];
+                word |= (uint64_t)(v >= lo && v <= hi) << b;
+            }
+            break;
+        case 'h':
+            for (int b = 0; b < n_bit; b++)
+            {
+                int64_t v = ((const int16_t *)vs)[i + b];
+                word |= (uint64_t)(v >= lo && v <= hi) << b;
+            }
+            break;
+        case 'u':
+            for (int b = 0; b < n_bit; b++)
+            {
+                int64_t v = ((const uint32_t *)vs)[i + b];
+                word |= (uint64_t)(v >= lo && v <= hi) << b;
+            }
+            break;
+        default:
+            for (int b = 0; b < n_bit; b++)
+            {
+                int64_t v = ((const int64_t *)vs)[i + b];
+                word |= (uint64_t)(v >= lo && v <= hi) << b;
+            }
+            break;
+        }
+        mask[i >> 6] = word;
+    }
+}
+
+/// @brief helper function, set bit i of mask if min <= vs[i] <= max for float column (NaN never matches)
+/// @param vs   I values
+/// @param n    I number of values
+/// @param min  I min value
+/// @param max  I max value
+/// @param mask O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_float(const float *vs, int n, double min, double max, uint64_t *mask)
+{
+    for (int i = 0; i < n; i += 64)
+    {
+        uint64_t word = 0;
+        int n_bit = n - i < 64 ? n - i : 64;
+        for (int b = 0; b < n_bit; b++)
+        {
+            double v = vs[i + b]; // exact, compared in double so bounds are not rounded
+            word |= (uint64_t)(v >= min && v <= max) << b;
+        }
+        mask[i >> 6] = word;
+    }
+}
+
+/// @brief helper function, zone map of column j, built now if zone maps are enabled but not built yet
+/// (the map is a cache, so it is stored in a const dataframe; do not filter one dataframe from several threads
+/// before its zone maps are built)
+/// @param df I dataframe
+/// @param j  I column index
+/// @return zone map, NULL if zone maps are disabled
+static const can_zone_map *can_zone_map_get(const can_dataframe *df, int j)
+{
+    if (df->zone_rows <= 0)
+    {
+        return NULL;
+    }
+    else if (df->zones[j] != NULL)
+    {
+        return df->zones[j];
+    }
+
+    int n_block = (df->n_row + df->zone_rows - 1) / df->zone_rows;
+    can_zone_map *zm = (can_zone_map *)calloc(1, sizeof(can_zone_map));
+    if (zm == NULL)
+    {
+        fprintf(stderr, "ERROR: can_zone_map_get cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    zm->n_block = n_block;
+    zm->min = (double *)malloc(sizeof(double) * (n_block > 0 ? n_block : 1));
+    zm->max = (double *)malloc(sizeof(double) * (n_block > 0 ? n_block : 1));
+    zm->has_nan = (unsigned char *)calloc(n_block > 0 ? n_block : 1, 1);
+    if (zm->min == NULL || zm->max == NULL || zm->has_nan == NULL)
+    {
+        fprintf(stderr, "ERROR: can_zone_map_get cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int b = 0; b < n_block; b++)
+    {
+        int start = b * df->zone_rows;
+        int end = start + df->zone_rows < df->n_row ? start + df->zone_rows : df->n_row;
+        if (df->dtypes[j] == 'I')
+        {
+            const int *vs = (const int *)df->values[j];
+            int lo = INT_MAX, hi = INT_MIN;
+            for (int i = start; i < end; i++)
+            {
+                if (!can_row_valid(df, j, i))
+                {
+                    continue;
+                }
+                lo = vs[i] < lo ? vs[i] : lo;
+                hi = vs[i] > hi ? vs[i] : hi;
+            }
+            zm->min[b] = lo;
+            zm->max[b] = hi;
+        }
+        else if (df->dtypes[j] == 'D')
+        {
+            const double *vs = (const double *)df->values[j];
+            double lo = INFINITY, hi = -INFINITY;
+            int has_nan = 0;
+            for (int i = start; i < end; i++)
+            {
+                if (!can_row_valid(df, j, i))
+                {
+                    continue;
+                }
+                lo = vs[i] < lo ? vs[i] : lo; // NaN compares false, never taken
+                hi = vs[i] > hi ? vs[i] : hi;
+                has_nan |= vs[i] != vs[i];
+            }
+            zm->min[b] = lo;
+            zm->max[b] = hi;
+            zm->has_nan[b] = (unsigned char)has_nan;
+        }
+        else if (df->dtypes[j] == 'l')
+        {
+            const int64_t *vs = (const int64_t *)df->values[j];
+            int64_t lo = INT64_MAX, hi = INT64_MIN;
+            for (int i = start; i < end; i++)
+            {
+                if (!can_row_valid(df, j, i))
+                {
+                    continue;
+                }
+                lo = vs[i] < lo ? vs[i] : lo;
+                hi = vs[i] > hi ? vs[i] : hi;
+            }
+            // beyond 2^53 doubles are rounded, round outward so the map never excludes a value
+            double d_lo = (double)lo, d_hi = (double)hi;
+            if (d_lo >= 9223372036854775808.0 || (int64_t)d_lo > lo)
+            {
+                d_lo = can_double_step(d_lo, 0);
+            }
+            if (d_hi < 9223372036854775808.0 && (int64_t)d_hi < hi)
+            {
+                d_hi = can_double_step(d_hi, 1);
+            }
+            zm->min[b] = d_lo;
+            zm->max[b] = d_hi;
+        }
+        else if (df->dtypes[j] != 'C')
+        {
+            // int8 / int16 / uint32 / float / string codes, exact in double
+            const void *vs = df->values[j];
+            double lo = INFINITY, hi = -INFINITY;
+            int has_nan = 0;
+            for (int i = start; i < end; i++)
+            {
+                if (!can_row_valid(df, j, i))
+                {
+                    continue;
+                }
+                double v = can_value_as_double(vs, df->dtypes[j], i);
+                lo = v < lo ? v : lo;
+                hi = v > hi ? v : hi;
+                has_nan |= v != v;
+            }
+            zm->min[b] = lo;
+            zm->max[b] = hi;
+            zm->has_nan[b] = (unsigned char)has_nan;
+        }
+        else
+        {
+            const char *vs = (const char *)df->values[j];
+            char lo = CHAR_MAX, hi = CHAR_MIN;
+            for (int i = start; i < end; i++)
+            {
+                if (!can_row_valid(df, j, i))
+                {
+                    continue;
+                }
+                lo = vs[i] < lo ? vs[i] : lo;
+                hi = vs[i] > hi ? vs[i] : hi;
+            }
+            zm->min[b] = lo;
+            zm->max[b] = hi;
+        }
+    }
+    ((can_dataframe *)df)->zones[j] = zm;
+    return zm;
+}
+
+/// @brief helper function, bit mask of n values whose value is in [min, max], vector kernel of the data type
+/// @param vs    I values
+/// @param dtype I data type
+/// @param n     I number of values
+/// @param min   I min value (int / char converted exactly)
+/// @param max   I max value
+/// @param mask  O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_values(const void *vs, char dtype, int n, double min, double max, uint64_t *mask)
+{
+    if (dtype == 'D')
+    {
+        can_mask_range_double((const double *)vs, n, min, max, mask);
+        return;
+    }
+    else if (dtype == 'f')
+    {
+        can_mask_range_float((const float *)vs, n, min, max, mask);
+        return;
+    }
+
+    // integer and char columns, bounds clamped to integers of the type
+    int64_t tmin, tmax, lo, hi;
+    can_int_limits(dtype, &tmin, &tmax);
+    if (!can_int_range(min, max, tmin, tmax, &lo, &hi))
+    {
+        memset(mask, 0, sizeof(uint64_t) * ((n + 63) / 64));
+    }
+    else if (dtype == 'I' || dtype == 'S')
+    {
+        can_mask_range_int((const int *)vs, n, (int)lo, (int)hi, mask);
+    }
+    else if (dtype == 'C')
+    {
+        can_mask_range_char(vs, n, (char)lo, (char)hi, mask);
+    }
+    else
+    {
+        can_mask_range_int64(vs, dtype, n, lo, hi, mask);
+    }
+}
+
+/// @brief helper function, set bit of rows [start, start + n) of column j whose value is in [min, max],
+/// zone map (if enabled) decides whole blocks without reading values
+/// @param df    I dataframe
+/// @param j     I column index
+/// @param min   I min value (int / char converted exactly)
+/// @param max   I max value
+/// @param start I first row, multiple of CAN_PRED_CHUNK
+/// @param n     I number of rows, at most CAN_PRED_CHUNK
+/// @param mask  O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_range_chunk(const can_dataframe *df, int j, double min, double max, int start, int n, uint64_t *mask)
+{
+    const can_zone_map *zm = can_zone_map_get(df, j);
+    if (zm != NULL)
+    {
+        // chunk lies in one block because block_rows is a multiple of CAN_PRED_CHUNK
+        int b = start / df->zone_rows;
+        if (zm->max[b] < min || zm->min[b] > max || min > max)
+        {
+            memset(mask, 0, sizeof(uint64_t) * ((n + 63) / 64));
+            return;
+        }
+        else if (!zm->has_nan[b] && zm->min[b] >= min && zm->max[b] <= max)
+        {
+            memset(mask, 0xff, sizeof(uint64_t) * ((n + 63) / 64));
+            if (n & 63)
+            {
+                mask[(n - 1) / 64] = ((uint64_t)1 << (n & 63)) - 1;
+            }
+            return;
+        }
+    }
+
+    can_mask_range_values((const char *)df->values[j] + (size_t)start * can_dtype_size(df->dtypes[j]), df->dtypes[j], n, min, max, mask);
+}
+
+// defined with can_create_index
+static int can_index_mask(const can_dataframe *df, int j, int n_range, const double *min, const double *max, uint64_t *mask);
+
+/// @brief helper function, clear rows of mask whose value of column j is null (nothing to do without bitmap)
+/// @param df    I  dataframe
+/// @param j     I  column index
+/// @param start I  first row (multiple of 64)
+/// @param n     I  number of rows
+/// @param mask  IO (n + 63) / 64 words, bit 0 is row start
+static void can_mask_and_valid(const can_dataframe *df, int j, int start, int n, uint64_t *mask)
+{
+    if (df->valid[j] == NULL)
+    {
+        return;
+    }
+    const uint64_t *valid = df->valid[j] + start / 64;
+    for (int w = 0; w < (n + 63) / 64; w++)
+    {
+        mask[w] &= valid[w];
+    }
+}
+
+/// @brief helper function, bit mask of all rows of column j whose value is in [min, max]
+/// @param df   I dataframe
+/// @param j    I column index
+/// @param min  I min value (int / char converted exactly)
+/// @param max  I max value
+/// @param mask O (df->n_row + 63) / 64 words
+static void can_mask_range_col(const can_dataframe *df, int j, double min, double max, uint64_t *mask)
+{
+    // indexed column and few matching rows, binary search instead of scanning
+    if (df->indexes[j] == NULL || !can_index_mask(df, j, 1, &min, &max, mask))
+    {
+        for (int start = 0; start < df->n_row; start += CAN_PRED_CHUNK)
+        {
+            int n = df->n_row - start < CAN_PRED_CHUNK ? df->n_row - start : CAN_PRED_CHUNK;
+            can_mask_range_chunk(df, j, min, max, start, n, mask + start / 64);
+        }
+    }
+    can_mask_and_valid(df, j, 0, df->n_row, mask);
+}
+
+/// @brief helper function, alloc a zeroed row bit mask
+/// @param n    I number of rows
+/// @param func I caller name for error message
+/// @return (n + 63) / 64 words
+static uint64_t *can_mask_alloc(int n, const char *func)
+{
+    uint64_t *mask = (uint64_t *)calloc((size_t)(n > 0 ? (n + 63) / 64 : 1), sizeof(uint64_t));
+    if (mask == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    return mask;
+}
+
+/// @brief helper function, number of rows set in mask
+/// @param mask I row bit mask
+/// @param n    I number of rows
+/// @return count
+static int can_mask_count(const uint64_t *mask, int n)
+{
+    int count = 0;
+    for (int w = 0; w < (n + 63) / 64; w++)
+    {
+        count += can_popcount64(mask[w]);
+    }
+    return count;
+}
+
+/// @brief helper function, copy values of src whose row is set in mask to the front of dst (columnar compaction)
+/// @param dst   O compacted values
+/// @param src   I values
+/// @param dtype I data type
+/// @param mask  I row bit mask
+/// @param n     I number of rows of src
+static void can_compact_col(void *dst, const void *src, char dtype, const uint64_t *mask, int n)
+{
+    size_t size = can_dtype_size(dtype);
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    for (int w = 0; w < (n + 63) / 64; w++)
+    {
+        uint64_t word = mask[w];
+        const char *base = s + (size_t)w * 64 * size;
+        if (word == 0)
+        {
+            continue;
+        }
+        else if (word == UINT64_MAX)
+        {
+            // run of whole words selected (e.g. blocks matched by zone map), bulk copy
+            int w_end = w + 1;
+            while (w_end < (n + 63) / 64 && mask[w_end] == UINT64_MAX)
+            {
+                w_end++;
+            }
+            memcpy(d, base, (size_t)(w_end - w) * 64 * size);
+            d += (size_t)(w_end - w) * 64 * size;
+            w = w_end - 1;
+            continue;
+        }
+        switch (size)
+        {
+        case 8:
+            while (word != 0)
+            {
+                memcpy(d, base + (size_t)can_ctz64(word) * 8, 8);
+                d += 8;
+                word &= word - 1;
+            }
+            break;
+        case 4:
+            while (word != 0)
+            {
+                memcpy(d, base + (size_t)can_ctz64(word) * 4, 4);
+                d += 4;
+                word &= word - 1;
+            }
+            break;
+        case 2:
+            while (word != 0)
+            {
+                memcpy(d, base + (size_t)can_ctz64(word) * 2, 2);
+                d += 2;
+                word &= word - 1;
+            }
+            break;
+        default:
+            while (word != 0)
+            {
+                *d = base[can_ctz64(word)];
+                d += 1;
+                word &= word - 1;
+            }
+            break;
+        }
+    }
+}
+
+/// @brief helper function, new dataframe with rows of df that are set in mask, one compaction pass per column
+/// @param df   I dataframe
+/// @param mask I row bit mask
+/// @return sub dataframe (deep copy)
+static can_dataframe *can_take_mask(const can_dataframe *df, const uint64_t *mask)
+{
+    int n_row = can_mask_count(mask, df->n_row);
+    can_dataframe *res = can_alloc(n_row, df->n_col, df->cols, df->dtypes, NULL);
+    can_share_dicts(res, df);
+    for (int j = 0; j < res->n_col; j++)
+    {
+        can_compact_col(res->values[j], df->values[j], res->dtypes[j], mask, df->n_row);
+        can_valid_compact(res, j, df->valid[j], df->n_row, mask);
+    }
+    return res;
+}
+
+/// @brief helper function, append rows set in mask to selection vector
+/// @param mask I row bit mask
+/// @param n    I number of rows
+/// @param sel  O selected rows in ascending order
+/// @return number of selected rows
+static int can_mask_to_rows(const uint64_t *mask, int n, int *sel)
+{
+    int n_sel = 0;
+    for (int w = 0; w < (n + 63) / 64; w++)
+    {
+        uint64_t word = mask[w];
+        while (word != 0)
+        {
+            sel[n_sel++] = w * 64 + can_ctz64(word);
+            word &= word - 1;
+        }
+    }
+    return n_sel;
+}
+
+/// @brief filter rows that have value of col between min and max
+/// @param df  I dataframe
+/// @param col I col name that have double (or float) date type
+/// @param min I min value
+/// @param max I max value
+/// @return     filtered dataframe
+can_dataframe *can_filter_double(const can_dataframe *df, char col[MAX_COL_LEN], double min, double max)
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_filter_double cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (!can_dtype_accepts(df->dtypes[found_col], 'D'))
+    {
+        fprintf(stderr, "ERORR: can_filter_double found col=%s but it is not double type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    // rows that satisfy condition as bit mask
+    uint64_t *mask = can_mask_alloc(df->n_row, "can_filter_double");
+    can_mask_range_col(df, found_col, min, max, mask);
+
+    // compact every column once
+    can_dataframe *res = can_take_mask(df, mask);
+    free(mask);
+    return res;
+}
+
+/// @brief filter rows that have value of col between min and max
+/// @param df  I dataframe
+/// @param col I col name that have int date type
+/// @param min I min value
+/// @param max I max value
+/// @return     filtered dataframe
+can_dataframe *can_filter_int(const can_dataframe *df, char col[MAX_COL_LEN], int min, int max)
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_filter_int cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'I')
+    {
+        fprintf(stderr, "ERORR: can_filter_int found col=%s but it is not int type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    // rows that satisfy condition as bit mask
+    uint64_t *mask = can_mask_alloc(df->n_row, "can_filter_int");
+    can_mask_range_col(df, found_col, min, max, mask);
+
+    // compact every column once
+    can_dataframe *res = can_take_mask(df, mask);
+    free(mask);
+    return res;
+}
+
+/// @brief filter rows that have value of col between min and max
+/// @param df  I dataframe
+/// @param col I col name that have any integer date type ('I' / 'b' / 'h' / 'l' / 'u')
+/// @param min I min value
+/// @param max I max value
+/// @return     filtered dataframe
+can_dataframe *can_filter_int64(const can_dataframe *df, char col[MAX_COL_LEN], int64_t min, int64_t max)
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_filter_int64 cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (!can_dtype_is_int(df->dtypes[found_col]))
+    {
+        fprintf(stderr, "ERROR: can_filter_int64 found col=%s but it is not integer type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    // rows that satisfy condition as bit mask
+    uint64_t *mask = can_mask_alloc(df->n_row, "can_filter_int64");
+    const int64_t exact = (int64_t)1 << 53;
+    if (min >= -exact && min <= exact && max >= -exact && max <= exact)
+    {
+        // bounds exact in double, zone maps and index can be used
+        can_mask_range_col(df, found_col, (double)min, (double)max, mask);
+    }
+    else
+    {
+        const void *vs = df->values[found_col];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            int64_t v = can_value_as_int64(vs, df->dtypes[found_col], i);
+            mask[i >> 6] |= (uint64_t)(v >= min && v <= max) << (i & 63);
+        }
+        can_mask_and_valid(df, found_col, 0, df->n_row, mask);
+    }
+
+    // compact every column once
+    can_dataframe *res = can_take_mask(df, mask);
+    free(mask);
+    return res;
+}
+
+/// @brief filter rows that have value of col between min and max
+/// @param df  I dataframe
+/// @param col I col name that have char date type
+/// @param min I min value
+/// @param max I max value
+/// @return     filtered dataframe
+can_dataframe *can_filter_char(const can_dataframe *df, char col[MAX_COL_LEN], char min, char max)
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERORR: can_filter_char cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'C')
+    {
+        fprintf(stderr, "ERORR: can_filter_char found col=%s but it is not char type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    // rows that satisfy condition as bit mask
+    uint64_t *mask = can_mask_alloc(df->n_row, "can_filter_char");
+    can_mask_range_col(df, found_col, min, max, mask);
+
+    // compact every column once
+    can_dataframe *res = can_take_mask(df, mask);
+    free(mask);
+    return res;
+}
+
+/// @brief filter rows that have value of col equal to value
+/// (string is looked up once in the column dictionary, then rows are compared by integer code)
+/// @param df    I dataframe
+/// @param col   I col name that have string date type
+/// @param value I string
+/// @return     filtered dataframe
+can_dataframe *can_filter_str(const can_dataframe *df, char col[MAX_COL_LEN], const char *value)
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_filter_str cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (df->dtypes[found_col] != 'S')
+    {
+        fprintf(stderr, "ERROR: can_filter_str found col=%s but it is not string type\n", col);
+        exit(EXIT_FAILURE);
+    }
+
+    // rows that satisfy condition as bit mask, none if string is not in dictionary
+    uint64_t *mask = can_mask_alloc(df->n_row, "can_filter_str");
+    int code = can_dict_find(df->dicts[found_col], value, strlen(value));
+    if (code >= 0)
+    {
+        can_mask_range_col(df, found_col, code, code, mask);
+    }
+
+    // compact every column once
+    can_dataframe *res = can_take_mask(df, mask);
+    free(mask);
+    return res;
+}
+
+/// @brief helper function, qsort comparator of int
+static int can_cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/// @brief helper function, qsort comparator of int64
+static int can_cmp_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/// @brief helper function, qsort comparator of double
+static int can_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/// @brief helper function, alloc predicate node
+/// @param op    I CAN_PRED_*
+/// @param col   I column name of leaf, NULL for AND / OR / NOT
+/// @param dtype I data type of leaf
+/// @param func  I caller name for error message
+/// @return predicate node
+static can_pred *can_pred_new(int op, const char *col, char dtype, const char *func)
+{
+    can_pred *p = (can_pred *)calloc(1, sizeof(can_pred));
+    if (p == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    p->op = op;
+    p->dtype = dtype;
+    if (col != NULL)
+    {
+        strncpy(p->col, col, MAX_COL_LEN - 1);
+    }
+    return p;
+}
+
+/// @brief predicate min <= col <= max
+/// @param col I col name that have double data type
+/// @param min I min value
+/// @param max I max value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_range_double(char col[MAX_COL_LEN], double min, double max)
+{
+    can_pred *p = can_pred_new(CAN_PRED_RANGE, col, 'D', "can_pred_range_double");
+    p->min = min;
+    p->max = max;
+    return p;
+}
+
+/// @brief predicate min <= col <= max
+/// @param col I col name that have int data type
+/// @param min I min value
+/// @param max I max value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_range_int(char col[MAX_COL_LEN], int min, int max)
+{
+    can_pred *p = can_pred_new(CAN_PRED_RANGE, col, 'I', "can_pred_range_int");
+    p->min = min;
+    p->max = max;
+    return p;
+}
+
+/// @brief predicate min <= col <= max for any integer column ('I' / 'b' / 'h' / 'l' / 'u'),
+/// bounds are kept as double so they are exact within +-2^53
+/// @param col I col name that have integer data type
+/// @param min I min value
+/// @param max I max value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_range_int64(char col[MAX_COL_LEN], int64_t min, int64_t max)
+{
+    can_pred *p = can_pred_new(CAN_PRED_RANGE, col, 'l', "can_pred_range_int64");
+    p->min = (double)min;
+    p->max = (double)max;
+    return p;
+}
+
+/// @brief predicate min <= col <= max
+/// @param col I col name that have char data type
+/// @param min I min value
+/// @param max I max value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_range_char(char col[MAX_COL_LEN], char min, char max)
+{
+    can_pred *p = can_pred_new(CAN_PRED_RANGE, col, 'C', "can_pred_range_char");
+    p->min = min;
+    p->max = max;
+    return p;
+}
+
+/// @brief predicate col == value
+/// @param col   I col name that have double data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_eq_double(char col[MAX_COL_LEN], double value)
+{
+    return can_pred_range_double(col, value, value);
+}
+
+/// @brief predicate col == value
+/// @param col   I col name that have int data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_eq_int(char col[MAX_COL_LEN], int value)
+{
+    return can_pred_range_int(col, value, value);
+}
+
+/// @brief predicate col == value for any integer column (exact within +-2^53)
+/// @param col   I col name that have integer data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_eq_int64(char col[MAX_COL_LEN], int64_t value)
+{
+    return can_pred_range_int64(col, value, value);
+}
+
+/// @brief predicate col == value
+/// @param col   I col name that have char data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_eq_char(char col[MAX_COL_LEN], char value)
+{
+    return can_pred_range_char(col, value, value);
+}
+
+/// @brief helper function for can_pred_ne_*, NOT eq AND NOT null, so that null rows never match like other comparisons
+/// @param eq I predicate col == value (owned by result)
+/// @return predicate (free by can_pred_free)
+static can_pred *can_pred_ne_of(can_pred *eq)
+{
+    return can_pred_and(can_pred_not(can_pred_is_null(eq->col)), can_pred_not(eq));
+}
+
+/// @brief predicate col != value (false on null rows, NOT of can_pred_eq_double matches them)
+/// @param col   I col name that have double data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_ne_double(char col[MAX_COL_LEN], double value)
+{
+    return can_pred_ne_of(can_pred_eq_double(col, value));
+}
+
+/// @brief predicate col != value (false on null rows, NOT of can_pred_eq_int matches them)
+/// @param col   I col name that have int data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_ne_int(char col[MAX_COL_LEN], int value)
+{
+    return can_pred_ne_of(can_pred_eq_int(col, value));
+}
+
+/// @brief predicate col != value for any integer column (exact within +-2^53, false on null rows, NOT of can_pred_eq_int64 matches them)
+/// @param col   I col name that have integer data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_ne_int64(char col[MAX_COL_LEN], int64_t value)
+{
+    return can_pred_ne_of(can_pred_eq_int64(col, value));
+}
+
+/// @brief predicate col != value (false on null rows, NOT of can_pred_eq_char matches them)
+/// @param col   I col name that have char data type
+/// @param value I value
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_ne_char(char col[MAX_COL_LEN], char value)
+{
+    return can_pred_ne_of(can_pred_eq_char(col, value));
+}
+
+/// @brief predicate col in {values[0], ..., values[n - 1]} (NaN never matches)
+/// @param col    I col name that have double data type
+/// @param n      I number of values
+/// @param values I values (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_in_double(char col[MAX_COL_LEN], int n, const double *values)
+{
+    can_pred *p = can_pred_new(CAN_PRED_IN, col, 'D', "can_pred_in_double");
+    double *set = (double *)malloc(sizeof(double) * (n > 0 ? n : 1));
+    if (set == NULL)
+    {
+        fprintf(stderr, "ERROR: can_pred_in_double cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < n; k++)
+    {
+        if (!isnan(values[k]))
+        {
+            set[p->n_set++] = values[k];
+        }
+    }
+    qsort(set, p->n_set, sizeof(double), can_cmp_double);
+    p->set = set;
+    return p;
+}
+
+/// @brief predicate col in {values[0], ..., values[n - 1]}
+/// @param col    I col name that have int data type
+/// @param n      I number of values
+/// @param values I values (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_in_int(char col[MAX_COL_LEN], int n, const int *values)
+{
+    can_pred *p = can_pred_new(CAN_PRED_IN, col, 'I', "can_pred_in_int");
+    int *set = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (set == NULL)
+    {
+        fprintf(stderr, "ERROR: can_pred_in_int cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(set, values, sizeof(int) * n);
+    qsort(set, n, sizeof(int), can_cmp_int);
+    p->n_set = n;
+    p->set = set;
+    return p;
+}
+
+/// @brief predicate col in {values[0], ..., values[n - 1]} for any integer column (compared exactly)
+/// @param col    I col name that have integer data type
+/// @param n      I number of values
+/// @param values I values (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_in_int64(char col[MAX_COL_LEN], int n, const int64_t *values)
+{
+    can_pred *p = can_pred_new(CAN_PRED_IN, col, 'l', "can_pred_in_int64");
+    int64_t *set = (int64_t *)malloc(sizeof(int64_t) * (n > 0 ? n : 1));
+    if (set == NULL)
+    {
+        fprintf(stderr, "ERROR: can_pred_in_int64 cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(set, values, sizeof(int64_t) * n);
+    qsort(set, n, sizeof(int64_t), can_cmp_int64);
+    p->n_set = n;
+    p->set = set;
+    return p;
+}
+
+/// @brief predicate col in {values[0], ..., values[n - 1]}
+/// @param col    I col name that have char data type
+/// @param n      I number of values
+/// @param values I values (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_in_char(char col[MAX_COL_LEN], int n, const char *values)
+{
+    can_pred *p = can_pred_new(CAN_PRED_IN, col, 'C', "can_pred_in_char");
+    char *set = (char *)malloc(n > 0 ? n : 1);
+    if (set == NULL)
+    {
+        fprintf(stderr, "ERROR: can_pred_in_char cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(set, values, n);
+    p->n_set = n;
+    p->set = set;
+    return p;
+}
+
+/// @brief predicate col == value of string column
+/// @param col   I column name of string type
+/// @param value I string (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_eq_str(char col[MAX_COL_LEN], const char *value)
+{
+    return can_pred_in_str(col, 1, &value);
+}
+
+/// @brief predicate col != value of string column (false on null rows, NOT of can_pred_eq_str matches them)
+/// @param col   I column name of string type
+/// @param value I string (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_ne_str(char col[MAX_COL_LEN], const char *value)
+{
+    return can_pred_ne_of(can_pred_eq_str(col, value));
+}
+
+/// @brief predicate col in values of string column
+/// (strings are turned into codes of the column dictionary when evaluated, rows are compared by code)
+/// @param col    I column name of string type
+/// @param n      I number of values
+/// @param values I strings (copied)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_in_str(char col[MAX_COL_LEN], int n, const char *const *values)
+{
+    can_pred *p = can_pred_new(CAN_PRED_IN, col, 'S', "can_pred_in_str");
+    size_t len = 0;
+    for (int k = 0; k < n; k++)
+    {
+        len += strlen(values[k]) + 1;
+    }
+    char *set = (char *)malloc(len > 0 ? len : 1);
+    if (set == NULL)
+    {
+        fprintf(stderr, "ERROR: can_pred_in_str cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    len = 0;
+    for (int k = 0; k < n; k++)
+    {
+        size_t l = strlen(values[k]) + 1;
+        memcpy(set + len, values[k], l);
+        len += l;
+    }
+    p->n_set = n;
+    p->set = set;
+    return p;
+}
+
+/// @brief helper function, codes in dictionary d of strings of string predicate (strings d lacks are dropped)
+/// @param d     I dictionary of column, may be NULL
+/// @param p     I CAN_PRED_IN predicate of string column
+/// @param codes O sorted codes, p->n_set at most
+/// @return number of codes
+static int can_pred_str_codes(const can_dict *d, const can_pred *p, int *codes)
+{
+    int n = 0;
+    const char *s = (const char *)p->set;
+    for (int k = 0; k < p->n_set; k++)
+    {
+        size_t len = strlen(s);
+        int code = can_dict_find(d, s, len);
+        if (code >= 0)
+        {
+            codes[n++] = code;
+        }
+        s += len + 1;
+    }
+    qsort(codes, n, sizeof(int), can_cmp_int);
+    return n;
+}
+
+/// @brief predicate a AND b
+/// @param a I predicate (owned by result)
+/// @param b I predicate (owned by result)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_and(can_pred *a, can_pred *b)
+{
+    can_pred *p = can_pred_new(CAN_PRED_AND, NULL, 0, "can_pred_and");
+    p->a = a;
+    p->b = b;
+    return p;
+}
+
+/// @brief predicate a OR b
+/// @param a I predicate (owned by result)
+/// @param b I predicate (owned by result)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_or(can_pred *a, can_pred *b)
+{
+    can_pred *p = can_pred_new(CAN_PRED_OR, NULL, 0, "can_pred_or");
+    p->a = a;
+    p->b = b;
+    return p;
+}
+
+/// @brief predicate col is null (comparisons are false on null rows, so NOT of a comparison matches them)
+/// @param col I col name of any data type
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_is_null(char col[MAX_COL_LEN])
+{
+    return can_pred_new(CAN_PRED_NULL, col, 0, "can_pred_is_null");
+}
+
+/// @brief predicate NOT a
+/// @param a I predicate (owned by result)
+/// @return predicate (free by can_pred_free)
+can_pred *can_pred_not(can_pred *a)
+{
+    can_pred *p = can_pred_new(CAN_PRED_NOT, NULL, 0, "can_pred_not");
+    p->a = a;
+    return p;
+}
+
+/// @brief free predicate and all its children
+/// @param p IO predicate
+void can_pred_free(can_pred *p)
+{
+    if (p == NULL)
+    {
+        return;
+    }
+    can_pred_free(p->a);
+    can_pred_free(p->b);
+    free(p->set);
+    free(p);
+}
+
+/// @brief helper function, check that every column of predicate exists in df with the right data type
+/// @param df   I dataframe
+/// @param p    I predicate
+/// @param func I caller name for error message
+static void can_pred_check(const can_dataframe *df, const can_pred *p, const char *func)
+{
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR || p->op == CAN_PRED_NOT)
+    {
+        can_pred_check(df, p->a, func);
+        if (p->b != NULL)
+        {
+            can_pred_check(df, p->b, func);
+        }
+        return;
+    }
+    int found_col = can_find_col(df, p->col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: %s cannot found col=%s\n", func, p->col);
+        exit(EXIT_FAILURE);
+    }
+    else if (p->op != CAN_PRED_NULL && !can_dtype_accepts(df->dtypes[found_col], p->dtype))
+    {
+        fprintf(stderr, "ERROR: %s found col=%s but it is not %c type\n", func, p->col, p->dtype);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// @brief helper function, set bit i of mask if vs[i] is in set of CAN_PRED_IN predicate
+/// @param vs    I values
+/// @param dtype I data type of values (accepted by p->dtype)
+/// @param n     I number of values
+/// @param p     I CAN_PRED_IN predicate
+/// @param mask  O (n + 63) / 64 words, bits past n are cleared
+static void can_mask_in(const void *vs, char dtype, int n, const can_pred *p, uint64_t *mask)
+{
+    memset(mask, 0, sizeof(uint64_t) * ((n + 63) / 64));
+    if (p->dtype == 'C')
+    {
+        // lookup table of all chars
+        unsigned char in_set[256] = {0};
+        for (int k = 0; k < p->n_set; k++)
+        {
+            in_set[(unsigned char)((const char *)p->set)[k]] = 1;
+        }
+        const char *v = (const char *)vs;
+        for (int i = 0; i < n; i++)
+        {
+            mask[i >> 6] |= (uint64_t)in_set[(unsigned char)v[i]] << (i & 63);
+        }
+    }
+    else if (p->dtype == 'I')
+    {
+        // binary search of sorted set
+        const int *v = (const int *)vs;
+        const int *set = (const int *)p->set;
+        for (int i = 0; i < n; i++)
+        {
+            int lo = 0, hi = p->n_set;
+            while (lo < hi)
+            {
+                int mid = (lo + hi) >> 1;
+                if (set[mid] < v[i])
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            mask[i >> 6] |= (uint64_t)(lo < p->n_set && set[lo] == v[i]) << (i & 63);
+        }
+    }
+    else if (p->dtype == 'l')
+    {
+        // any integer column, widened to int64
+        const int64_t *set = (const int64_t *)p->set;
+        for (int i = 0; i < n; i++)
+        {
+            int64_t v = can_value_as_int64(vs, dtype, i);
+            int lo = 0, hi = p->n_set;
+            while (lo < hi)
+            {
+                int mid = (lo + hi) >> 1;
+                if (set[mid] < v)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            mask[i >> 6] |= (uint64_t)(lo < p->n_set && set[lo] == v) << (i & 63);
+        }
+    }
+    else
+    {
+        // double or float column
+        const double *set = (const double *)p->set;
+        for (int i = 0; i < n; i++)
+        {
+            double v = dtype == 'f' ? (double)((const float *)vs)[i] : ((const double *)vs)[i];
+            int lo = 0, hi = p->n_set;
+            while (lo < hi)
+            {
+                int mid = (lo + hi) >> 1;
+                if (set[mid] < v)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            mask[i >> 6] |= (uint64_t)(lo < p->n_set && set[lo] == v) << (i & 63);
+        }
+    }
+}
+
+/// @brief helper function, evaluate range / in leaf of predicate on rows [start, start + n) of column j,
+/// one vector kernel over the column slice (or zone map decides the whole chunk), null rows not cleared
+/// @param df    I dataframe (columns checked by can_pred_check)
+/// @param p     I CAN_PRED_RANGE / CAN_PRED_IN predicate
+/// @param j     I column index of p->col
+/// @param start I first row, multiple of 64
+/// @param n     I number of rows, at most CAN_PRED_CHUNK
+/// @param mask  O (n + 63) / 64 words, bits past n are cleared
+static void can_pred_eval_leaf(const can_dataframe *df, const can_pred *p, int j, int start, int n, uint64_t *mask)
+{
+    int n_word = (n + 63) / 64;
+    if (p->op == CAN_PRED_RANGE)
+    {
+        can_mask_range_chunk(df, j, p->min, p->max, start, n, mask);
+        return;
+    }
+    if (p->dtype == 'S')
+    {
+        // strings to codes of this column's dictionary, then same as an int set (one code is a range)
+        int codes[64];
+        int *set = p->n_set <= 64 ? codes : (int *)malloc(sizeof(int) * p->n_set);
+        if (set == NULL)
+        {
+            fprintf(stderr, "ERROR: can_filter cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        can_pred q = *p;
+        q.dtype = 'I';
+        q.set = set;
+        q.n_set = can_pred_str_codes(df->dicts[j], p, set);
+        if (q.n_set == 0)
+        {
+            memset(mask, 0, sizeof(uint64_t) * n_word);
+        }
+        else if (q.n_set == 1)
+        {
+            can_mask_range_chunk(df, j, set[0], set[0], start, n, mask);
+        }
+        else
+        {
+            can_pred_eval_leaf(df, &q, j, start, n, mask);
+        }
+        if (set != codes)
+        {
+            free(set);
+        }
+        return;
+    }
+    const can_zone_map *zm = can_zone_map_get(df, j);
+    if (zm != NULL && p->n_set > 0)
+    {
+        // int / double sets are sorted, char sets are small
+        double set_min, set_max;
+        if (p->dtype == 'I')
+        {
+            set_min = ((const int *)p->set)[0];
+            set_max = ((const int *)p->set)[p->n_set - 1];
+        }
+        else if (p->dtype == 'D')
+        {
+            set_min = ((const double *)p->set)[0];
+            set_max = ((const double *)p->set)[p->n_set - 1];
+        }
+        else if (p->dtype == 'l')
+        {
+            // rounding to double is monotone, never skips a block holding a value of the set
+            set_min = (double)((const int64_t *)p->set)[0];
+            set_max = (double)((const int64_t *)p->set)[p->n_set - 1];
+        }
+        else
+        {
+            set_min = CHAR_MAX;
+            set_max = CHAR_MIN;
+            for (int k = 0; k < p->n_set; k++)
+            {
+                char c = ((const char *)p->set)[k];
+                set_min = c < set_min ? c : set_min;
+                set_max = c > set_max ? c : set_max;
+            }
+        }
+        int b = start / df->zone_rows;
+        if (set_max < zm->min[b] || set_min > zm->max[b])
+        {
+            memset(mask, 0, sizeof(uint64_t) * n_word);
+            return;
+        }
+    }
+    can_mask_in((const char *)df->values[j] + (size_t)start * can_dtype_size(df->dtypes[j]), df->dtypes[j], n, p, mask);
+}
+
+/// @brief helper function, evaluate predicate on rows [start, start + n) of df into mask
+/// @param df    I dataframe (columns checked by can_pred_check)
+/// @param p     I predicate
+/// @param start I first row, multiple of 64
+/// @param n     I number of rows, at most CAN_PRED_CHUNK
+/// @param mask  O (n + 63) / 64 words, bits past n are cleared
+static void can_pred_eval(const can_dataframe *df, const can_pred *p, int start, int n, uint64_t *mask)
+{
+    int n_word = (n + 63) / 64;
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR)
+    {
+        can_pred_eval(df, p->a, start, n, mask);
+
+        // skip right side when left side already decides every row of the chunk
+        int count = can_mask_count(mask, n);
+        if ((p->op == CAN_PRED_AND && count == 0) || (p->op == CAN_PRED_OR && count == n))
+        {
+            return;
+        }
+
+        uint64_t other[CAN_PRED_CHUNK / 64];
+        can_pred_eval(df, p->b, start, n, other);
+        for (int w = 0; w < n_word; w++)
+        {
+            mask[w] = p->op == CAN_PRED_AND ? mask[w] & other[w] : mask[w] | other[w];
+        }
+        return;
+    }
+    else if (p->op == CAN_PRED_NOT)
+    {
+        can_pred_eval(df, p->a, start, n, mask);
+        for (int w = 0; w < n_word; w++)
+        {
+            mask[w] = ~mask[w];
+        }
+        if (n & 63)
+        {
+            mask[n_word - 1] &= ((uint64_t)1 << (n & 63)) - 1;
+        }
+        return;
+    }
+
+    // leaf, null rows never match a comparison
+    int j = can_find_col(df, p->col);
+    if (p->op == CAN_PRED_NULL)
+    {
+        for (int w = 0; w < n_word; w++)
+        {
+            mask[w] = df->valid[j] != NULL ? ~can_valid_word(df->valid[j] + start / 64, w, n) : 0;
+        }
+        if (n & 63)
+        {
+            mask[n_word - 1] &= ((uint64_t)1 << (n & 63)) - 1;
+        }
+        return;
+    }
+    can_pred_eval_leaf(df, p, j, start, n, mask);
+    can_mask_and_valid(df, j, start, n, mask);
+}
+
+/// @brief helper function, evaluate predicate by the index of its columns when it is a range / in clause
+/// on an indexed column, or an AND with such a clause (other side only runs on chunks that still have rows)
+/// @param df   I dataframe (columns checked by can_pred_check)
+/// @param p    I predicate
+/// @param mask O (df->n_row + 63) / 64 words, untouched if 0 is returned
+/// @return 1 if evaluated, 0 if no index applies or too many rows match
+static int can_pred_mask_indexed(const can_dataframe *df, const can_pred *p, uint64_t *mask)
+{
+    if (p->op == CAN_PRED_RANGE || p->op == CAN_PRED_IN)
+    {
+        int j = can_find_col(df, p->col);
+        if (df->indexes[j] == NULL)
+        {
+            return 0;
+        }
+        else if (p->op == CAN_PRED_RANGE)
+        {
+            if (!can_index_mask(df, j, 1, &p->min, &p->max, mask))
+            {
+                return 0;
+            }
+            can_mask_and_valid(df, j, 0, df->n_row, mask);
+            return 1;
+        }
+
+        // every value of set is a range of its own
+        double *vs = (double *)malloc(sizeof(double) * (p->n_set > 0 ? p->n_set : 1));
+        if (vs == NULL)
+        {
+            fprintf(stderr, "ERROR: can_filter cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        if (p->dtype == 'S')
+        {
+            // index of string column is on codes
+            int *codes = (int *)malloc(sizeof(int) * (p->n_set > 0 ? p->n_set : 1));
+            if (codes == NULL)
+            {
+                fprintf(stderr, "ERROR: can_filter cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            int n_code = can_pred_str_codes(df->dicts[j], p, codes);
+            for (int k = 0; k < n_code; k++)
+            {
+                vs[k] = codes[k];
+            }
+            free(codes);
+            int done = can_index_mask(df, j, n_code, vs, vs, mask);
+            free(vs);
+            if (done)
+            {
+                can_mask_and_valid(df, j, 0, df->n_row, mask);
+            }
+            return done;
+        }
+        for (int k = 0; k < p->n_set; k++)
+        {
+            if (p->dtype == 'l')
+            {
+                int64_t x = ((const int64_t *)p->set)[k];
+                if (x > ((int64_t)1 << 53) || x < -((int64_t)1 << 53))
+                {
+                    // not exact as double bound, scan instead
+                    free(vs);
+                    return 0;
+                }
+                vs[k] = (double)x;
+                continue;
+            }
+            vs[k] = p->dtype == 'I' ? ((const int *)p->set)[k] : (p->dtype == 'D' ? ((const double *)p->set)[k] : ((const char *)p->set)[k]);
+        }
+        int done = can_index_mask(df, j, p->n_set, vs, vs, mask);
+        free(vs);
+        if (done)
+        {
+            can_mask_and_valid(df, j, 0, df->n_row, mask);
+        }
+        return done;
+    }
+    else if (p->op != CAN_PRED_AND)
+    {
+        return 0;
+    }
+
+    const can_pred *rest = p->b;
+    if (!can_pred_mask_indexed(df, p->a, mask))
+    {
+        if (!can_pred_mask_indexed(df, p->b, mask))
+        {
+            return 0;
+        }
+        rest = p->a;
+    }
+    for (int start = 0; start < df->n_row; start += CAN_PRED_CHUNK)
+    {
+        int n = df->n_row - start < CAN_PRED_CHUNK ? df->n_row - start : CAN_PRED_CHUNK;
+        int n_word = (n + 63) / 64;
+        uint64_t *chunk = mask + start / 64;
+        int any = 0;
+        for (int w = 0; w < n_word && !any; w++)
+        {
+            any = chunk[w] != 0;
+        }
+        if (any)
+        {
+            uint64_t other[CAN_PRED_CHUNK / 64];
+            can_pred_eval(df, rest, start, n, other);
+            for (int w = 0; w < n_word; w++)
+            {
+                chunk[w] &= other[w];
+            }
+        }
+    }
+    return 1;
+}
+
+/// @brief helper function, evaluate predicate on all rows of df into one bit mask
+/// @param df   I dataframe (columns checked by can_pred_check)
+/// @param p    I predicate
+/// @param mask O (df->n_row + 63) / 64 words
+static void can_pred_mask(const can_dataframe *df, const can_pred *p, uint64_t *mask)
+{
+    if (can_pred_mask_indexed(df, p, mask))
+    {
+        return;
+    }
+
+    // chunks keep the intermediate masks of all clauses in L1 cache
+    for (int start = 0; start < df->n_row; start += CAN_PRED_CHUNK)
+    {
+        int n = df->n_row - start < CAN_PRED_CHUNK ? df->n_row - start : CAN_PRED_CHUNK;
+        can_pred_eval(df, p, start, n, mask + start / 64);
+    }
+}
+
+/// @brief filter rows that satisfy a compound predicate, evaluated in one pass and copied once
+/// @param df I dataframe
+/// @param p  I predicate built by can_pred_* (not freed)
+/// @return filtered dataframe
+can_dataframe *can_filter(const can_dataframe *df, const can_pred *p)
+{
+    can_pred_check(df, p, "can_filter");
+
+    uint64_t *mask = can_mask_alloc(df->n_row, "can_filter");
+    can_pred_mask(df, p, mask);
+
+    // compact every column once
+    can_dataframe *res = can_take_mask(df, mask);
+    free(mask);
+    return res;
+}
+
+/// @brief view of all rows of df, no data is copied (df must outlive the view)
+/// @param df I parent dataframe
+/// @return view (free by can_view_free)
+can_view *can_view_of(const can_dataframe *df)
+{
+    can_view *v = (can_view *)calloc(1, sizeof(can_view));
+    if (v == NULL)
+    {
+        fprintf(stderr, "ERROR: can_view_of cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    v->parent = df;
+    v->n_sel = df->n_row;
+    v->sel = NULL; // all rows
+    return v;
+}
+
+/// @brief free view (parent dataframe is not touched)
+/// @param v IO view
+void can_view_free(can_view *v)
+{
+    free(v->sel);
+    free(v);
+}
+
+/// @brief helper function for can_view_filter_*, resolve filter column of view's parent and make selection vector explicit
+/// @param v     IO view
+/// @param col   I  column name
+/// @param dtype I  expected data type
+/// @param func  I  caller name for error message
+/// @return column index in parent
+static int can_view_prepare(can_view *v, const char *col, char dtype, const char *func)
+{
+    int found_col = can_find_col(v->parent, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: %s cannot found col=%s\n", func, col);
+        exit(EXIT_FAILURE);
+    }
+    else if (v->parent->dtypes[found_col] != dtype)
+    {
+        fprintf(stderr, "ERROR: %s found col=%s but it is not %c type\n", func, col, dtype);
+        exit(EXIT_FAILURE);
+    }
+    if (v->sel == NULL)
+    {
+        v->sel = (int *)malloc(sizeof(int) * (v->parent->n_row > 0 ? v->parent->n_row : 1));
+        if (v->sel == NULL)
+        {
+            fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+            exit(EXIT_FAILURE);
+        }
+        v->n_sel = -1; // rows not selected yet, filter scans whole column
+    }
+    return found_col;
+}
+
+/// @brief keep rows of view whose value of col is between min and max (refine selection, no data copied)
+/// @param v   IO view
+/// @param col I  col name that have double data type
+/// @param min I  min value
+/// @param max I  max value
+void can_view_filter_double(can_view *v, char col[MAX_COL_LEN], double min, double max)
+{
+    int found_col = can_view_prepare(v, col, 'D', "can_view_filter_double");
+    const double *vs = (const double *)v->parent->values[found_col];
+    int n_keep = 0;
+    if (v->n_sel < 0)
+    {
+        // first filter scans the whole column with the vector kernel
+        uint64_t *mask = can_mask_alloc(v->parent->n_row, "can_view_filter_double");
+        can_mask_range_col(v->parent, found_col, min, max, mask);
+        n_keep = can_mask_to_rows(mask, v->parent->n_row, v->sel);
+        free(mask);
+    }
+    else
+    {
+        // later filters only test selected rows
+        for (int k = 0; k < v->n_sel; k++)
+        {
+            int i = v->sel[k];
+            if (vs[i] >= min && vs[i] <= max && can_row_valid(v->parent, found_col, i))
+            {
+                v->sel[n_keep++] = i;
+            }
+        }
+    }
+    v->n_sel = n_keep;
+}
+
+/// @brief keep rows of view whose value of col is between min and max (refine selection, no data copied)
+/// @param v   IO view
+/// @param col I  col name that have int data type
+/// @param min I  min value
+/// @param max I  max value
+void can_view_filter_int(can_view *v, char col[MAX_COL_LEN], int min, int max)
+{
+    int found_col = can_view_prepare(v, col, 'I', "can_view_filter_int");
+    const int *vs = (const int *)v->parent->values[found_col];
+    int n_keep = 0;
+    if (v->n_sel < 0)
+    {
+        // first filter scans the whole column with the vector kernel
+        uint64_t *mask = can_mask_alloc(v->parent->n_row, "can_view_filter_int");
+        can_mask_range_col(v->parent, found_col, min, max, mask);
+        n_keep = can_mask_to_rows(mask, v->parent->n_row, v->sel);
+        free(mask);
+    }
+    else
+    {
+        // later filters only test selected rows
+        for (int k = 0; k < v->n_sel; k++)
+        {
+            int i = v->sel[k];
+            if (vs[i] >= min && vs[i] <= max && can_row_valid(v->parent, found_col, i))
+            {
+                v->sel[n_keep++] = i;
+            }
+        }
+    }
+    v->n_sel = n_keep;
+}
+
+/// @brief keep rows of view whose value of col is between min and max (refine selection, no data copied)
+/// @param v   IO view
+/// @param col I  col name that have char data type
+/// @param min I  min value
+/// @param max I  max value
+void can_view_filter_char(can_view *v, char col[MAX_COL_LEN], char min, char max)
+{
+    int found_col = can_view_prepare(v, col, 'C', "can_view_filter_char");
+    const char *vs = (const char *)v->parent->values[found_col];
+    int n_keep = 0;
+    if (v->n_sel < 0)
+    {
+        // first filter scans the whole column with the vector kernel
+        uint64_t *mask = can_mask_alloc(v->parent->n_row, "can_view_filter_char");
+        can_mask_range_col(v->parent, found_col, min, max, mask);
+        n_keep = can_mask_to_rows(mask, v->parent->n_row, v->sel);
+        free(mask);
+    }
+    else
+    {
+        // later filters only test selected rows
+        for (int k = 0; k < v->n_sel; k++)
+        {
+            int i = v->sel[k];
+            if (vs[i] >= min && vs[i] <= max && can_row_valid(v->parent, found_col, i))
+            {
+                v->sel[n_keep++] = i;
+            }
+        }
+    }
+    v->n_sel = n_keep;
+}
+
+/// @brief copy selected rows of view into a new dataframe, only for the requested columns
+/// @param v     I view
+/// @param n_col I number of columns, 0 means all columns of parent
+/// @param cols  I column names (ignored if n_col is 0)
+/// @return dataframe (deep copy)
+can_dataframe *can_view_materialize(const can_view *v, int n_col, char cols[MAX_COL_NUM][MAX_COL_LEN])
+{
+    const can_dataframe *df = v->parent;
+    if (n_col <= 0)
+    {
+        n_col = df->n_col;
+        cols = NULL;
+    }
+    int *src_cols = (int *)can_malloc(sizeof(int) * n_col, "can_view_materialize");
+    for (int k = 0; k < n_col; k++)
+    {
+        src_cols[k] = cols == NULL ? k : can_find_col(df, cols[k]);
+        if (src_cols[k] == -1)
+        {
+            fprintf(stderr, "ERROR: can_view_materialize cannot found col=%s\n", cols[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int n_row = v->sel == NULL ? df->n_row : v->n_sel;
+    can_dataframe *res = can_alloc_cols_of(df, n_row, n_col, src_cols, "can_view_materialize");
+    for (int k = 0; k < n_col; k++)
+    {
+        if (v->sel == NULL)
+        {
+            memcpy(res->values[k], df->values[src_cols[k]], can_dtype_size(res->dtypes[k]) * n_row);
+            can_valid_copy(res, k, 0, df->valid[src_cols[k]], 0, n_row);
+        }
+        else
+        {
+            can_gather_col(res->values[k], df->values[src_cols[k]], res->dtypes[k], v->sel, n_row);
+            if (df->valid[src_cols[k]] != NULL)
+            {
+                can_valid_gather(res, k, df, src_cols[k], v->sel, n_row);
+            }
+        }
+    }
+    free(src_cols);
+    return res;
+}
+
+/// @brief rows [begin, end) of the result of can_concat_rows_n, copied by one thread
+typedef struct
+{
+    can_dataframe *res;
+    can_dataframe *const *frames;
+    const int *offset; // first row of every frame in res, n + 1 (last is total rows)
+    int begin;
+    int end;
+} can_concat_job;
+
+/// @brief helper function for can_concat_rows_n, memcpy the segments of every column that fall in [begin, end)
+/// @param arg IO can_concat_job
+/// @return 0
+static int can_concat_copy(void *arg)
+{
+    can_concat_job *c = (can_concat_job *)arg;
+    if (c->begin >= c->end)
+    {
+        return 0;
+    }
+    int first = 0;
+    while (c->offset[first + 1] <= c->begin)
+    {
+        first++;
+    }
+    for (int j = 0; j < c->res->n_col; j++)
+    {
+        size_t size = can_dtype_size(c->res->dtypes[j]);
+        int f = first;
+        for (int row = c->begin; row < c->end; f++)
+        {
+            int stop = c->offset[f + 1] < c->end ? c->offset[f + 1] : c->end;
+            memcpy((char *)c->res->values[j] + size * row, (const char *)c->frames[f]->values[j] + size * (row - c->offset[f]), size * (stop - row));
+            row = stop;
+        }
+    }
+    return 0;
+}
+
+/// @brief helper function for can_concat_row / can_concat_rows_n, check schemas once, alloc result once,
+/// then copy disjoint row ranges on n_thread threads
+/// @param n        I number of frames
+/// @param frames   I frames with same column names and data types
+/// @param n_thread I number of threads (1 copies on the calling thread)
+/// @param func     I caller name for error message
+/// @return concatenated dataframe
+static can_dataframe *can_concat_rows_impl(int n, can_dataframe *const frames[], int n_thread, const char *func)
+{
+    if (n <= 0)
+    {
+        fprintf(stderr, "ERROR: %s n = %d <= 0\n", func, n);
+        exit(EXIT_FAILURE);
+    }
+
+    // check if have same cols
+    const can_dataframe *df1 = frames[0];
+    int *offset = (int *)malloc(sizeof(int) * (n + 1));
+    if (offset == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    offset[0] = 0;
+    for (int f = 0; f < n; f++)
+    {
+        const can_dataframe *df2 = frames[f];
+        if (df1->n_col != df2->n_col)
+        {
+            fprintf(stderr, "ERROR: %s df1->n_col != df%d->n_col\n", func, f + 1);
+            exit(EXIT_FAILURE);
+        }
+        for (int j = 0; j < df1->n_col; j++)
+        {
+            if (strcmp(df1->cols[j], df2->cols[j]) != 0)
+            {
+                fprintf(stderr, "ERROR: %s column of df1 %s have different name with df%d\n", func, df1->cols[j], f + 1);
+                exit(EXIT_FAILURE);
+            }
+
+            if (df1->dtypes[j] != df2->dtypes[j])
+            {
+                fprintf(stderr, "ERROR: %s column of df1 %s have different data type with df%d\n", func, df1->cols[j], f + 1);
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (df2->n_row > INT_MAX - offset[f])
+        {
+            fprintf(stderr, "ERROR: %s too many rows\n", func);
+            exit(EXIT_FAILURE);
+        }
+        offset[f + 1] = offset[f] + df2->n_row;
+    }
+
+    // every thread copies an equal share of rows of every column
+    can_dataframe *res = can_alloc(offset[n], df1->n_col, df1->cols, df1->dtypes, NULL);
+    int n_job = n_thread < offset[n] ? n_thread : (offset[n] > 0 ? offset[n] : 1);
+    can_concat_job *jobs = (can_concat_job *)malloc(sizeof(can_concat_job) * n_job);
+    if (jobs == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < n_job; k++)
+    {
+        jobs[k].res = res;
+        jobs[k].frames = frames;
+        jobs[k].offset = offset;
+        jobs[k].begin = (int)((int64_t)offset[n] * k / n_job);
+        jobs[k].end = (int)((int64_t)offset[n] * (k + 1) / n_job);
+    }
+    if (n_job == 1)
+    {
+        can_concat_copy(&jobs[0]);
+    }
+    else
+    {
+        can_parallel_run(n_job, can_concat_copy, jobs, sizeof(can_concat_job));
+    }
+
+    // nulls of every frame (frames share bitmap words at their borders, so not in parallel)
+    for (int j = 0; j < res->n_col; j++)
+    {
+        for (int f = 0; f < n; f++)
+        {
+            can_valid_copy(res, j, offset[f], frames[f]->valid[j], 0, frames[f]->n_row);
+        }
+    }
+
+    // string columns: share the dictionary if all frames have the same one, otherwise recode into a new one
+    for (int j = 0; j < res->n_col; j++)
+    {
+        if (res->dtypes[j] != 'S')
+        {
+            continue;
+        }
+        int same = 1;
+        for (int f = 1; f < n && same; f++)
+        {
+            same = frames[f]->dicts[j] == df1->dicts[j];
+        }
+        if (same)
+        {
+            can_set_col_dict(res, j, df1->dicts[j]);
+            continue;
+        }
+        for (int f = 0; f < n; f++)
+        {
+            can_recode_into(res, j, frames[f]->dicts[j], (int *)res->values[j] + offset[f], frames[f]->n_row);
+        }
+    }
+
+    free(jobs);
+    free(offset);
+    return res;
+}
+
+/// @brief concatenate two dataframe by row
+/// @param df1 I dataframe 1
+/// @param df2 I dataframe 2
+/// @return concatenated dataframe
+can_dataframe *can_concat_row(const can_dataframe *df1, const can_dataframe *df2)
+{
+    can_dataframe *const frames[2] = {(can_dataframe *)df1, (can_dataframe *)df2};
+    return can_concat_rows_impl(2, frames, 1, "can_concat_row");
+}
+
+/// @brief concatenate many dataframes by row at once (schemas checked once, result allocated once,
+/// one memcpy per column segment), instead of n - 1 pairwise can_concat_row that copy all prior rows every time
+/// @param n      I number of frames, >= 1
+/// @param frames I frames with same column names and data types, in order
+/// @return concatenated dataframe
+can_dataframe *can_concat_rows_n(int n, can_dataframe *const frames[])
+{
+    return can_concat_rows_impl(n, frames, 1, "can_concat_rows_n");
+}
+
+/// @brief same as can_concat_rows_n, rows of the result are split into n_thread disjoint ranges copied in parallel
+/// @param n        I number of frames, >= 1
+/// @param frames   I frames with same column names and data types, in order
+/// @param n_thread I number of threads, <= 0 means number of processors
+/// @return concatenated dataframe
+can_dataframe *can_concat_rows_n_parallel(int n, can_dataframe *const frames[], int n_thread)
+{
+    if (n_thread <= 0)
+    {
+        n_thread = can_n_processor();
+    }
+    return can_concat_rows_impl(n, frames, n_thread, "can_concat_rows_n_parallel");
+}
+
+/// @brief make room for n_row rows in every column, so appending up to n_row rows does not reallocate
+/// (pointers from can_get_*_pointer become invalid if columns move)
+/// @param df    IO dataframe
+/// @param n_row I rows to hold
+void can_reserve(can_dataframe *df, int n_row)
+{
+    if (n_row <= df->capacity)
+    {
+        return;
+    }
+    else if (df->mapping != NULL)
+    {
+        fprintf(stderr, "ERROR: can_reserve dataframe is read-only (can_load_binary)\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int j = 0; j < df->n_col; j++)
+    {
+        can_col_resize(df, j, df->n_row, n_row, "can_reserve");
+    }
+    df->capacity = n_row;
+}
+
+/// @brief append one row in place, capacity doubles when full (amortized O(1)),
+/// e.g. can_append_row(df, 'A', 1.5, 19354) for dtypes "CDI"
+/// (pointers from can_get_*_pointer become invalid if columns move)
+/// @param df  IO dataframe
+/// @param ... I  value of every column in order: int for 'I', double for 'D' and 'f' (write 1.0, not 1), char for 'C',
+///              int for 'b' / 'h', uint32_t for 'u', int64_t for 'l' (write (int64_t)1), const char * for 'S' (NULL for missing)
+void can_append_row(can_dataframe *df, ...)
+{
+    can_grow(df, df->n_row + 1, "can_append_row");
+
+    int i = df->n_row;
+    va_list ap;
+    va_start(ap, df);
+    for (int j = 0; j < df->n_col; j++)
+    {
+        if (df->dtypes[j] == 'I')
+        {
+            ((int *)df->values[j])[i] = va_arg(ap, int);
+        }
+        else if (df->dtypes[j] == 'D')
+        {
+            ((double *)df->values[j])[i] = va_arg(ap, double);
+        }
+        else if (df->dtypes[j] == 'C')
+        {
+            ((char *)df->values[j])[i] = (char)va_arg(ap, int); // char is promoted to int
+        }
+        else if (df->dtypes[j] == 'f')
+        {
+            ((float *)df->values[j])[i] = (float)va_arg(ap, double); // float is promoted to double
+        }
+        else if (df->dtypes[j] == 'l')
+        {
+            ((int64_t *)df->values[j])[i] = va_arg(ap, int64_t);
+        }
+        else if (df->dtypes[j] == 'u')
+        {
+            ((uint32_t *)df->values[j])[i] = va_arg(ap, uint32_t);
+        }
+        else if (df->dtypes[j] == 'S')
+        {
+            const char *str = va_arg(ap, const char *);
+            if (str != NULL)
+            {
+                ((int *)df->values[j])[i] = can_dict_intern(can_col_dict(df, j), str, strlen(str));
+            }
+            else
+            {
+                can_set_row_null(df, j, i);
+            }
+        }
+        else
+        {
+            can_value_set_int64(df->values[j], df->dtypes[j], i, va_arg(ap, int)); // int8 / int16 are promoted to int
+        }
+        can_col_modified(df, j);
+    }
+    va_end(ap);
+    df->n_row++;
+}
+
+/// @brief append all rows of src after the rows of dst in place, capacity doubles when full
+/// (same columns required as can_concat_row, one memcpy per column;
+/// pointers from can_get_*_pointer become invalid if columns move)
+/// @param dst IO dataframe
+/// @param src I  dataframe with same column names and data types (may be dst itself)
+void can_append_frame(can_dataframe *dst, const can_dataframe *src)
+{
+    if (dst->n_col != src->n_col)
+    {
+        fprintf(stderr, "ERROR: can_append_frame dst->n_col != src->n_col\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int j = 0; j < dst->n_col; j++)
+    {
+        if (strcmp(dst->cols[j], src->cols[j]) != 0)
+        {
+            fprintf(stderr, "ERROR: can_append_frame column of dst %s have different name with src\n", dst->cols[j]);
+            exit(EXIT_FAILURE);
+        }
+
+        if (dst->dtypes[j] != src->dtypes[j])
+        {
+            fprintf(stderr, "ERROR: can_append_frame column of dst %s have different data type with src\n", dst->cols[j]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (src->n_row > INT_MAX - dst->n_row)
+    {
+        fprintf(stderr, "ERROR: can_append_frame too many rows\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // src may be dst, whose columns move when growing
+    int n = src->n_row;
+    can_grow(dst, dst->n_row + n, "can_append_frame");
+    for (int j = 0; j < dst->n_col; j++)
+    {
+        size_t size = can_dtype_size(dst->dtypes[j]);
+        memcpy((char *)dst->values[j] + size * dst->n_row, src->values[j], size * n);
+        if (dst->dtypes[j] == 'S')
+        {
+            // codes of src's dictionary to codes of dst's
+            can_recode_into(dst, j, src->dicts[j], (int *)dst->values[j] + dst->n_row, n);
+        }
+        can_valid_copy(dst, j, dst->n_row, src->valid[j], 0, n);
+        can_col_modified(dst, j);
+    }
+    dst->n_row += n;
+}
+
+/// @brief concatenate two dataframe by col
+/// @param df1 I dataframe 1
+/// @param df2 I dataframe 2
+/// @return concatenated dataframe
+can_dataframe *can_concat_col(const can_dataframe *df1, const can_dataframe *df2)
+{
+    // check they have same row
+    if (df1->n_row != df2->n_row)
+    {
+        fprintf(stderr, "ERORR: can_concat_col df1->n_row = %d != df2->n_row = %d\n", df1->n_row, df2->n_row);
+        exit(EXIT_FAILURE);
+    }
+
+    int n_col = df1->n_col + df2->n_col;
+    char(*cols)[MAX_COL_LEN] = (char(*)[MAX_COL_LEN])can_malloc((size_t)MAX_COL_LEN * n_col, "can_concat_col");
+    char *dtypes = (char *)can_malloc(n_col, "can_concat_col");
+    for (int j = 0; j < df1->n_col; j++)
+    {
+        strncpy(cols[j], df1->cols[j], MAX_COL_LEN);
+        dtypes[j] = df1->dtypes[j];
+    }
+    for (int j = df1->n_col; j < df1->n_col + df2->n_col; j++)
+    {
+        strncpy(cols[j], df2->cols[j - df1->n_col], MAX_COL_LEN);
+        dtypes[j] = df2->dtypes[j - df1->n_col];
+    }
+    can_dataframe *res = can_alloc(df1->n_row, n_col, cols, dtypes, NULL);
+    free(cols);
+    free(dtypes);
+
+    // copy codes of string columns as they are, sharing the dictionary of their source
+    for (int j = 0; j < n_col; j++)
+    {
+        const can_dataframe *src = j < df1->n_col ? df1 : df2;
+        int j_src = j < df1->n_col ? j : j - df1->n_col;
+        memcpy(res->values[j], src->values[j_src], can_dtype_size(res->dtypes[j]) * res->n_row);
+        can_valid_copy(res, j, 0, src->valid[j_src], 0, res->n_row);
+        if (res->dtypes[j] == 'S')
+        {
+            can_set_col_dict(res, j, src->dicts[j_src]);
+        }
+    }
+    return res;
+}
+
+/// @brief helper function for can_merge_left, mix 64 bit key into a well distributed hash (murmur3 finalizer)
+/// @param x I key bits
+/// @return hash value
+static inline uint64_t can_hash_u64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/// @brief open addressing (linear probing) hash table from 64 bit key to row number
+typedef struct
+{
+    int mask;       // capacity - 1, capacity is power of 2
+    int *rows;      // row number stored in slot, -1 means empty slot
+    uint64_t *keys; // key stored in slot
+} can_hash_table;
+
+/// @brief helper function, init hash table that can hold n_key keys with load factor <= 0.5
+/// @param ht    O hash table
+/// @param n_key I max number of keys to be inserted
+static void can_hash_init(can_hash_table *ht, int n_key)
+{
+    int cap = 16;
+    while (cap < 2 * n_key)
+    {
+        cap <<= 1;
+    }
+    ht->mask = cap - 1;
+    ht->rows = (int *)malloc(sizeof(int) * cap);
+    ht->keys = (uint64_t *)malloc(sizeof(uint64_t) * cap);
+    if (ht->rows == NULL || ht->keys == NULL)
+    {
+        fprintf(stderr, "ERROR: can_hash_init cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(ht->rows, 0xff, sizeof(int) * cap); // all -1
+}
+
+/// @brief helper function, insert key if absent
+/// @param ht  IO hash table
+/// @param key I key bits
+/// @param row I row number of key
+/// @return row number already stored for key (first inserted wins), or row if key is new
+static inline int can_hash_insert(can_hash_table *ht, uint64_t key, int row)
+{
+    int slot = (int)(can_hash_u64(key) & (uint64_t)ht->mask);
+    while (ht->rows[slot] != -1)
+    {
+        if (ht->keys[slot] == key)
+        {
+            return ht->rows[slot];
+        }
+        slot = (slot + 1) & ht->mask;
+    }
+    ht->rows[slot] = row;
+    ht->keys[slot] = key;
+    return row;
+}
+
+/// @brief helper function, find key
+/// @param ht  I hash table
+/// @param key I key bits
+/// @return row number stored for key, -1 if not found
+static inline int can_hash_find(const can_hash_table *ht, uint64_t key)
+{
+    int slot = (int)(can_hash_u64(key) & (uint64_t)ht->mask);
+    while (ht->rows[slot] != -1)
+    {
+        if (ht->keys[slot] == key)
+        {
+            return ht->rows[slot];
+        }
+        slot = (slot + 1) & ht->mask;
+    }
+    return -1;
+}
+
+/// @brief helper function, free hash table
+/// @param ht IO hash table
+static void can_hash_free(can_hash_table *ht)
+{
+    free(ht->rows);
+    free(ht->keys);
+    ht->rows = NULL;
+    ht->keys = NULL;
+}
+
+/// @brief helper function, load one column as 64 bit key words
+/// (double keys use exact bit pattern, so 0.0 != -0.0 and NaN matches the NaN with same bits)
+/// @param df I dataframe
+/// @param j  I column index
+/// @return key words of n_row (need free)
+static uint64_t *can_load_key_bits(const can_dataframe *df, int j)
+{
+    uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * (df->n_row > 0 ? df->n_row : 1));
+    if (keys == NULL)
+    {
+        fprintf(stderr, "ERROR: can_load_key_bits cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    if (df->dtypes[j] == 'I')
+    {
+        const int *vs = (const int *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = (uint64_t)(uint32_t)vs[i];
+        }
+    }
+    else if (df->dtypes[j] == 'D')
+    {
+        memcpy(keys, df->values[j], sizeof(double) * df->n_row);
+    }
+    else if (df->dtypes[j] == 'C')
+    {
+        const char *vs = (const char *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = (uint64_t)(unsigned char)vs[i];
+        }
+    }
+    else
+    {
+        // other types by raw bits of their size (float also exact bit pattern)
+        size_t size = can_dtype_size(df->dtypes[j]);
+        const unsigned char *vs = (const unsigned char *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            uint64_t bits = 0;
+            memcpy(&bits, vs + (size_t)i * size, size);
+            keys[i] = bits;
+        }
+    }
+    return keys;
+}
+
+/// @brief helper function for can_merge_left, matched row of df2 for every row of df1 by hash join
+/// @param df1        I left dataframe
+/// @param found_col1 I key column index of df1
+/// @param df2        I right dataframe
+/// @param found_col2 I key column index of df2 (same data type)
+/// @return first matched row of df2 for each row of df1, -1 if not matched, n_row of df1 (need free)
+static int *can_merge_match(const can_dataframe *df1, int found_col1, const can_dataframe *df2, int found_col2)
+{
+    // build: hash table on df2's key col, only first found row of each key is kept
+    uint64_t *keys2 = can_load_key_bits(df2, found_col2);
+    if (df2->dtypes[found_col2] == 'S' && df2->dicts[found_col2] != df1->dicts[found_col1])
+    {
+        // string keys are codes, translate df2's codes to df1's dictionary (strings df1 lacks match nothing)
+        int *map = can_dict_remap(df1->dicts[found_col1], df2->dicts[found_col2], 0);
+        for (int i2 = 0; i2 < df2->n_row; i2++)
+        {
+            int code = (int)(uint32_t)keys2[i2];
+            keys2[i2] = (uint64_t)(uint32_t)(code >= 0 ? map[code] : MISS_STR);
+        }
+        free(map);
+    }
+    can_hash_table ht;
+    can_hash_init(&ht, df2->n_row);
+    for (int i2 = 0; i2 < df2->n_row; i2++)
+    {
+        if (can_row_valid(df2, found_col2, i2)) // null key matches nothing
+        {
+            can_hash_insert(&ht, keys2[i2], i2);
+        }
+    }
+    free(keys2);
+
+    // probe: matched row of df2 for every row of df1 (-1 if not matched)
+    uint64_t *keys1 = can_load_key_bits(df1, found_col1);
+    int *match = (int *)malloc(sizeof(int) * (df1->n_row > 0 ? df1->n_row : 1));
+    if (match == NULL)
+    {
+        fprintf(stderr, "ERROR: can_merge_match cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i1 = 0; i1 < df1->n_row; i1++)
+    {
+        match[i1] = can_row_valid(df1, found_col1, i1) ? can_hash_find(&ht, keys1[i1]) : -1;
+    }
+    free(keys1);
+    can_hash_free(&ht);
+    return match;
+}
+
+/// @brief merge two dataframe, keep left dataframe unchange,
+/// (df2's key col should be unique, if not unique, first found will be matched)
+/// (double key col is matched by exact bit equality, be very careful because of "0.1+0.2!=0.3" problem of float numbers)
+/// (left rows without match get MISS_INT / MISS_DOUBLE / MISS_CHAR in df2's columns, which are null there;
+/// null keys match nothing)
+/// internally hash join: build hash table on df2's key col once, probe it with df1's key col, O(n1 + n2)
+/// @param df1     I left dataframe
+/// @param df2     I right dataframe
+/// @param key_col I the key column name
+/// @return merged dataframe (deep copy)
+can_dataframe *can_merge_left(const can_dataframe *df1, const can_dataframe *df2, char key_col[MAX_COL_LEN])
+{
+    // check they both have key col
+    int found_col1 = can_find_col(df1, key_col);
+    if (found_col1 == -1)
+    {
+        fprintf(stderr, "ERORR: can_merge_left df1 do not have key_col %s\n", key_col);
+        exit(EXIT_FAILURE);
+    }
+    int found_col2 = can_find_col(df2, key_col);
+    if (found_col2 == -1)
+    {
+        fprintf(stderr, "ERORR: can_merge_left df1 have key_col %s, but df2 do not have key_col\n", key_col);
+        exit(EXIT_FAILURE);
+    }
+
+    // check if their key col are of same type
+    if (df1->dtypes[found_col1] != df2->dtypes[found_col2])
+    {
+        fprintf(stderr, "ERORR: can_merge_left df1, df2 have same key col but different type %c, %c\n", df1->dtypes[found_col1], df2->dtypes[found_col2]);
+        exit(EXIT_FAILURE);
+    }
+
+    int n_col = df1->n_col + df2->n_col - 1; // only keep left key col
+    char(*cols)[MAX_COL_LEN] = (char(*)[MAX_COL_LEN])can_malloc((size_t)MAX_COL_LEN * n_col, "can_merge_left");
+    char *dtypes = (char *)can_malloc(n_col, "can_merge_left");
+    int *src_cols = (int *)can_malloc(sizeof(int) * n_col, "can_merge_left"); // df2's column index of each merged column
+    for (int j = 0; j < df1->n_col; j++)
+    {
+        strncpy(cols[j], df1->cols[j], MAX_COL_LEN);
+        dtypes[j] = df1->dtypes[j];
+    }
+    int col_i = df1->n_col;
+    for (int j2 = 0; j2 < df2->n_col; j2++)
+    {
+        if (j2 == found_col2)
+        {
+            continue;
+        }
+        strncpy(cols[col_i], df2->cols[j2], MAX_COL_LEN);
+        dtypes[col_i] = df2->dtypes[j2];
+        src_cols[col_i] = j2;
+        col_i++;
+    }
+    can_dataframe *res = can_alloc(df1->n_row, n_col, cols, dtypes, NULL);
+    free(cols);
+    free(dtypes);
+
+    // left columns are kept unchanged
+    for (int j = 0; j < df1->n_col; j++)
+    {
+        memcpy(res->values[j], df1->values[j], can_dtype_size(df1->dtypes[j]) * df1->n_row);
+        can_valid_copy(res, j, 0, df1->valid[j], 0, df1->n_row);
+        if (res->dtypes[j] == 'S')
+        {
+            can_set_col_dict(res, j, df1->dicts[j]);
+        }
+    }
+
+    int *match = can_merge_match(df1, found_col1, df2, found_col2);
+
+    // gather df2's columns by matched row
+    for (int j = df1->n_col; j < res->n_col; j++)
+    {
+        can_gather_col(res->values[j], df2->values[src_cols[j]], res->dtypes[j], match, res->n_row);
+        can_valid_gather(res, j, df2, src_cols[j], match, res->n_row); // unmatched rows are null
+        if (res->dtypes[j] == 'S')
+        {
+            can_set_col_dict(res, j, df2->dicts[src_cols[j]]);
+        }
+    }
+
+    free(src_cols);
+    free(match);
+    return res;
+}
+
+/// @brief helper function for can_sort, map column values to unsigned 64 bit keys
+/// whose unsigned order equals the value order
+/// (int / char flip sign bit, double / float flip sign bit or all bits, -0.0 equals 0.0, NaN goes to the end,
+/// string is rank of its code in string order + 1, missing string goes first; keys use the low can_sort_key_width bits)
+/// @param df I dataframe
+/// @param j  I column index
+/// @return normalized keys of n_row (need free)
+static uint64_t *can_load_sort_keys(const can_dataframe *df, int j)
+{
+    uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * (df->n_row > 0 ? df->n_row : 1));
+    if (keys == NULL)
+    {
+        fprintf(stderr, "ERROR: can_load_sort_keys cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    if (df->dtypes[j] == 'I')
+    {
+        const int *vs = (const int *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = (uint64_t)((uint32_t)vs[i] ^ 0x80000000u);
+        }
+    }
+    else if (df->dtypes[j] == 'D')
+    {
+        const double *vs = (const double *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            double v = vs[i];
+            uint64_t bits;
+            if (v == 0.0)
+            {
+                v = 0.0; // -0.0 => 0.0
+            }
+            else if (v != v)
+            {
+                bits = 0xffffffffffffffffULL; // NaN is greater than everything
+                keys[i] = bits;
+                continue;
+            }
+            memcpy(&bits, &v, sizeof(double));
+            keys[i] = (bits & 0x8000000000000000ULL) ? ~bits : (bits | 0x8000000000000000ULL);
+        }
+    }
+    else if (df->dtypes[j] == 'C')
+    {
+        const char *vs = (const char *)df->values[j];
+        unsigned char flip = (char)-1 < 0 ? 0x80 : 0x00; // plain char may be signed or unsigned
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = (uint64_t)((unsigned char)vs[i] ^ flip);
+        }
+    }
+    else if (df->dtypes[j] == 'f')
+    {
+        const float *vs = (const float *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            float v = vs[i];
+            uint32_t bits;
+            if (v == 0.0f)
+            {
+                v = 0.0f; // -0.0 => 0.0
+            }
+            else if (v != v)
+            {
+                keys[i] = 0xffffffffULL; // NaN is greater than everything
+                continue;
+            }
+            memcpy(&bits, &v, sizeof(float));
+            keys[i] = (bits & 0x80000000u) ? (uint32_t)~bits : (bits | 0x80000000u);
+        }
+    }
+    else if (df->dtypes[j] == 'u')
+    {
+        const uint32_t *vs = (const uint32_t *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = vs[i];
+        }
+    }
+    else if (df->dtypes[j] == 'S')
+    {
+        // codes are in insertion order, rank them by string once
+        const int *vs = (const int *)df->values[j];
+        int *rank = can_dict_ranks(df->dicts[j]);
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = vs[i] >= 0 ? (uint64_t)rank[vs[i]] + 1 : 0;
+        }
+        free(rank);
+    }
+    else
+    {
+        // int8 / int16 / int64, flip sign bit at the width of the type
+        char dtype = df->dtypes[j];
+        int width = (int)can_dtype_size(dtype) * 8;
+        uint64_t sign = (uint64_t)1 << (width - 1);
+        uint64_t all = width == 64 ? UINT64_MAX : ((uint64_t)1 << width) - 1;
+        for (int i = 0; i < df->n_row; i++)
+        {
+            keys[i] = ((uint64_t)can_value_as_int64(df->values[j], dtype, i) ^ sign) & all;
+        }
+    }
+    return keys;
+}
+
+/// @brief helper function for can_sort, stable LSD radix sort (8 bits per pass) of keys,
+/// passes where all keys have the same digit are skipped
+/// @param keys    IO keys of n (in sorted order after return)
+/// @param n       I number of keys
+/// @param n_bytes I number of low bytes of keys to sort (1 ~ 8)
+/// @param perm    O row number of every sorted key (stable)
+static void can_radix_argsort(uint64_t *keys, int n, int n_bytes, int *perm)
+{
+    for (int i = 0; i < n; i++)
+    {
+        perm[i] = i;
+    }
+    if (n <= 1)
+    {
+        return;
+    }
+
+    // histogram of all passes in one read
+    size_t(*hist)[256] = calloc(n_bytes, sizeof(*hist));
+    uint64_t *keys_tmp = (uint64_t *)malloc(sizeof(uint64_t) * n);
+    if (hist == NULL || keys_tmp == NULL)
+    {
+        fprintf(stderr, "ERROR: can_radix_argsort cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t k = keys[i];
+        for (int b = 0; b < n_bytes; b++)
+        {
+            hist[b][(k >> (8 * b)) & 0xff]++;
+        }
+    }
+
+    if (n_bytes <= 4)
+    {
+        // narrow keys: pack (key, row) into one word, so every pass moves 8 bytes instead of 12
+        uint64_t *w_src = keys, *w_dst = keys_tmp;
+        for (int i = 0; i < n; i++)
+        {
+            keys[i] = (keys[i] << 32) | (uint32_t)i;
+        }
+        for (int b = 0; b < n_bytes; b++)
+        {
+            int shift = 32 + 8 * b;
+            if (hist[b][(w_src[0] >> shift) & 0xff] == (size_t)n)
+            {
+                continue; // every key has same digit
+            }
+
+            size_t offset[256];
+            size_t sum = 0;
+            for (int d = 0; d < 256; d++)
+            {
+                offset[d] = sum;
+                sum += hist[b][d];
+            }
+            for (int i = 0; i < n; i++)
+            {
+                w_dst[offset[(w_src[i] >> shift) & 0xff]++] = w_src[i];
+            }
+
+            uint64_t *w_swap = w_src;
+            w_src = w_dst;
+            w_dst = w_swap;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            perm[i] = (int)(uint32_t)w_src[i];
+            keys[i] = w_src[i] >> 32;
+        }
+
+        free(hist);
+        free(keys_tmp);
+        return;
+    }
+
+    int *perm_tmp = (int *)malloc(sizeof(int) * n);
+    if (perm_tmp == NULL)
+    {
+        fprintf(stderr, "ERROR: can_radix_argsort cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t *k_src = keys, *k_dst = keys_tmp;
+    int *p_src = perm, *p_dst = perm_tmp;
+    for (int b = 0; b < n_bytes; b++)
+    {
+        int shift = 8 * b;
+        if (hist[b][(k_src[0] >> shift) & 0xff] == (size_t)n)
+        {
+            continue; // every key has same digit
+        }
+
+        size_t offset[256];
+        size_t sum = 0;
+        for (int d = 0; d < 256; d++)
+        {
+            offset[d] = sum;
+            sum += hist[b][d];
+        }
+        for (int i = 0; i < n; i++)
+        {
+            size_t pos = offset[(k_src[i] >> shift) & 0xff]++;
+            k_dst[pos] = k_src[i];
+            p_dst[pos] = p_src[i];
+        }
+
+        uint64_t *k_swap = k_src;
+        k_src = k_dst;
+        k_dst = k_swap;
+        int *p_swap = p_src;
+        p_src = p_dst;
+        p_dst = p_swap;
+    }
+
+    if (k_src != keys)
+    {
+        memcpy(keys, k_src, sizeof(uint64_t) * n);
+        memcpy(perm, p_src, sizeof(int) * n);
+    }
+
+    free(hist);
+    free(keys_tmp);
+    free(perm_tmp);
+}
+
+/// @brief helper function for can_sort, number of bits of normalized key of dtype
+/// @param dtype I data type
+/// @return key width in bits
+static inline int can_sort_key_width(char dtype)
+{
+    return (int)can_dtype_size(dtype) * 8;
+}
+
+/// @brief helper function for can_sort / can_groupby_agg, expand key columns into sort keys,
+/// a key column with validity bitmap is preceded by a 1 bit null flag key, columns without nulls add nothing
+/// @param df        I dataframe
+/// @param n_keys    I number of key columns
+/// @param key_idx   I column index of keys
+/// @param ascending I 1 ascending / 0 descending of every key, NULL means all ascending
+/// @param items     O column index of every sort key, -1 - column index for its null flag (room for 2 * n_keys)
+/// @param flips     O 1 if sort key is bit inverted (descending value key), may be NULL
+/// @return number of sort keys
+static int can_sort_key_items(const can_dataframe *df, int n_keys, const int *key_idx, const int *ascending, int *items, int *flips)
+{
+    int n_item = 0;
+    for (int k = 0; k < n_keys; k++)
+    {
+        if (df->valid[key_idx[k]] != NULL)
+        {
+            if (flips != NULL)
+            {
+                flips[n_item] = 0; // nulls first / last does not depend on direction
+            }
+            items[n_item++] = -1 - key_idx[k];
+        }
+        if (flips != NULL)
+        {
+            flips[n_item] = ascending != NULL && !ascending[k];
+        }
+        items[n_item++] = key_idx[k];
+    }
+    return n_item;
+}
+
+/// @brief helper function for can_sort, number of bits of sort key item (see can_sort_key_items)
+/// @param df   I dataframe
+/// @param item I sort key item
+/// @return key width in bits
+static inline int can_sort_item_width(const can_dataframe *df, int item)
+{
+    return item >= 0 ? can_sort_key_width(df->dtypes[item]) : 1;
+}
+
+/// @brief helper function for can_sort, keys of sort key item: normalized values, or null flag
+/// that is 1 for the rows that go last
+/// @param df         I dataframe
+/// @param item       I sort key item
+/// @param nulls_last I 1 null rows go last, 0 first
+/// @return keys of n_row (need free)
+static uint64_t *can_load_sort_item(const can_dataframe *df, int item, int nulls_last)
+{
+    if (item >= 0)
+    {
+        return can_load_sort_keys(df, item);
+    }
+    const uint64_t *valid = df->valid[-1 - item];
+    uint64_t *keys = (uint64_t *)can_malloc(sizeof(uint64_t) * (df->n_row > 0 ? df->n_row : 1), "can_load_sort_keys");
+    for (int i = 0; i < df->n_row; i++)
+    {
+        keys[i] = ((valid[i >> 6] >> (i & 63)) & 1) ^ (uint64_t)nulls_last;
+    }
+    return keys;
+}
+
+/// @brief helper function for can_sort, stable sorted order by multiple key columns
+/// keys are packed from left to right into groups of at most 64 bits (descending keys are bit inverted),
+/// then groups are radix sorted from last to first, so keys that fit in 64 bits together take one sort
+/// @param df        I dataframe
+/// @param n_keys    I number of key columns
+/// @param key_idx   I column index of keys, first key is most significant
+/// @param ascending  I 1 ascending / 0 descending of every key, NULL means all ascending
+/// @param nulls_last I 1 null values of a key go after all others, 0 before (either direction)
+/// @return row numbers of df in sorted order, n_row of df (need free)
+static int *can_argsort_index(const can_dataframe *df, int n_keys, const int *key_idx, const int *ascending, int nulls_last)
+{
+    int n = df->n_row;
+    int *order = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int *group_order = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    uint64_t *packed = (uint64_t *)malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+    if (order == NULL || group_order == NULL || packed == NULL)
+    {
+        fprintf(stderr, "ERROR: can_argsort cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+
+    // null flags of nullable keys are keys of their own
+    int *items = (int *)can_malloc(sizeof(int) * 2 * n_keys, "can_argsort");
+    int *flips = (int *)can_malloc(sizeof(int) * 2 * n_keys, "can_argsort");
+    int n_item = can_sort_key_items(df, n_keys, key_idx, ascending, items, flips);
+
+    // split keys into groups [group_begin, group_end) that fit in 64 bits
+    int *group_begin = (int *)can_malloc(sizeof(int) * n_item, "can_argsort");
+    int *group_end = (int *)can_malloc(sizeof(int) * n_item, "can_argsort");
+    int n_group = 0;
+    int width = 0;
+    for (int k = 0; k < n_item; k++)
+    {
+        int w = can_sort_item_width(df, items[k]);
+        if (n_group == 0 || width + w > 64)
+        {
+            group_begin[n_group] = k;
+            n_group++;
+            width = 0;
+        }
+        width += w;
+        group_end[n_group - 1] = k + 1;
+    }
+
+    // LSD over groups: sort by least significant group first, then stable sort by more significant ones
+    for (int g = n_group - 1; g >= 0; g--)
+    {
+        int group_width = 0;
+        memset(packed, 0, sizeof(uint64_t) * (n > 0 ? n : 1));
+        for (int k = group_begin[g]; k < group_end[g]; k++)
+        {
+            int w = can_sort_item_width(df, items[k]);
+            uint64_t mask = w == 64 ? 0xffffffffffffffffULL : ((1ULL << w) - 1);
+            uint64_t flip = flips[k] ? mask : 0;
+            uint64_t *keys = can_load_sort_item(df, items[k], nulls_last);
+            for (int i = 0; i < n; i++)
+            {
+                // w == 64 only happens for a single key group, where packed is 0
+                packed[i] = (w == 64 ? 0 : (packed[i] << w)) | (keys[order[i]] ^ flip);
+            }
+            free(keys);
+            group_width += w;
+        }
+
+        can_radix_argsort(packed, n, (group_width + 7) / 8, group_order);
+        for (int i = 0; i < n; i++)
+        {
+            group_order[i] = order[group_order[i]];
+        }
+        int *swap = order;
+        order = group_order;
+        group_order = swap;
+    }
+
+    free(items);
+    free(flips);
+    free(group_begin);
+    free(group_end);
+    free(group_order);
+    free(packed);
+    return order;
+}
+
+/// @brief sorted order of dataframe by key column in ascending order (stable, equal keys keep their row order)
+/// internally radix sort, int / char keys take 4 / 1 passes, double keys take up to 8 passes
+/// @param df      I dataframe
+/// @param key_col I key column name
+/// @return row numbers of df in sorted order, n_row of df (need free)
+int *can_argsort(const can_dataframe *df, char key_col[MAX_COL_LEN])
+{
+    int found_col = can_find_col(df, key_col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_argsort df do not have key col %s\n", key_col);
+        exit(EXIT_FAILURE);
+    }
+
+    return can_argsort_index(df, 1, &found_col, NULL, 1);
+}
+
+/// @brief sorted order of dataframe by multiple key columns (stable), e.g. keys {"ANCHOR", "ANT1", "N"}
+/// with ascending {1, 0, 1} sorts by ANCHOR, then ANT1 descending for same ANCHOR, then N
+/// (int and char keys with total width <= 64 bits are packed into one key and take a single radix sort,
+/// null values of a key go last, see can_argsort_by_nulls)
+/// @param df        I dataframe
+/// @param n_keys    I number of key columns
+/// @param cols      I key column names, first key is most significant
+/// @param ascending I 1 ascending / 0 descending of every key, NULL means all ascending
+/// @return row numbers of df in sorted order, n_row of df (need free)
+int *can_argsort_by(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending)
+{
+    return can_argsort_by_nulls(df, n_keys, cols, ascending, 1);
+}
+
+/// @brief sorted order of dataframe by multiple key columns (stable) with null values of keys first or last
+/// (a key with validity bitmap gets a 1 bit null flag key in front of it, keys without nulls cost nothing)
+/// @param df         I dataframe
+/// @param n_keys     I number of key columns
+/// @param cols       I key column names, first key is most significant
+/// @param ascending  I 1 ascending / 0 descending of every key, NULL means all ascending
+/// @param nulls_last I 1 null values go after all others (default of can_argsort_by), 0 before, either direction
+/// @return row numbers of df in sorted order, n_row of df (need free)
+int *can_argsort_by_nulls(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending, int nulls_last)
+{
+    if (n_keys <= 0)
+    {
+        fprintf(stderr, "ERROR: can_argsort_by invalid n_keys = %d\n", n_keys);
+        exit(EXIT_FAILURE);
+    }
+
+    int *key_idx = (int *)can_malloc(sizeof(int) * n_keys, "can_argsort_by");
+    for (int k = 0; k < n_keys; k++)
+    {
+        int found_col = can_find_col(df, cols[k]);
+        if (found_col == -1)
+        {
+            fprintf(stderr, "ERROR: can_argsort_by df do not have key col %s\n", cols[k]);
+            exit(EXIT_FAILURE);
+        }
+        key_idx[k] = found_col;
+    }
+
+    int *order = can_argsort_index(df, n_keys, key_idx, ascending, nulls_last);
+    free(key_idx);
+    return order;
+}
+
+/// @brief sort dataframe in ascending order (stable)
+/// @param df      I dataframe
+/// @param key_col I key column name
+/// @return sorted dataframe
+can_dataframe *can_sort(const can_dataframe *df, char key_col[MAX_COL_LEN])
+{
+    int *order = can_argsort(df, key_col);
+
+    // gather every column once by the sorted order
+    can_dataframe *res = can_take_rows(df, order, df->n_row);
+
+    free(order);
+    return res;
+}
+
+/// @brief sort dataframe by multiple key columns with ascending / descending of each key (stable)
+/// @param df        I dataframe
+/// @param n_keys    I number of key columns
+/// @param cols      I key column names, first key is most significant
+/// @param ascending I 1 ascending / 0 descending of every key, NULL means all ascending
+/// @return sorted dataframe
+can_dataframe *can_sort_by(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending)
+{
+    int *order = can_argsort_by(df, n_keys, cols, ascending);
+
+    can_dataframe *res = can_take_rows(df, order, df->n_row);
+
+    free(order);
+    return res;
+}
+
+/// @brief sort dataframe by multiple key columns (stable) with null values of keys first or last
+/// @param df         I dataframe
+/// @param n_keys     I number of key columns
+/// @param cols       I key column names, first key is most significant
+/// @param ascending  I 1 ascending / 0 descending of every key, NULL means all ascending
+/// @param nulls_last I 1 null values go after all others, 0 before
+/// @return sorted dataframe
+can_dataframe *can_sort_by_nulls(const can_dataframe *df, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending, int nulls_last)
+{
+    int *order = can_argsort_by_nulls(df, n_keys, cols, ascending, nulls_last);
+
+    can_dataframe *res = can_take_rows(df, order, df->n_row);
+
+    free(order);
+    return res;
+}
+
+/// @brief helper function, normalized keys of range [min, max] of dtype, same order as can_load_sort_keys
+/// (integer / char bounds are clamped to integers of the type, float bounds rounded inward)
+/// @param dtype I data type
+/// @param min   I min value
+/// @param max   I max value
+/// @param lo    O key of smallest value in range
+/// @param hi    O key of largest value in range
+/// @return 1 if not empty, 0 if no value of the type is in range (also NaN bounds)
+static inline int can_index_key_range(char dtype, double min, double max, uint64_t *lo, uint64_t *hi)
+{
+    if (dtype == 'D')
+    {
+        if (!(min <= max))
+        {
+            return 0;
+        }
+        double v[2] = {min == 0.0 ? 0.0 : min, max == 0.0 ? 0.0 : max}; // -0.0 => 0.0
+        for (int k = 0; k < 2; k++)
+        {
+            uint64_t bits;
+            memcpy(&bits, &v[k], sizeof(double));
+            *(k == 0 ? lo : hi) = (bits & 0x8000000000000000ULL) ? ~bits : (bits | 0x8000000000000000ULL);
+        }
+        return 1;
+    }
+    else if (dtype == 'f')
+    {
+        // smallest float >= min and largest float <= max
+        float f_lo = min > FLT_MAX ? INFINITY : (float)min;
+        float f_hi = max < -FLT_MAX ? -INFINITY : (float)max;
+        if ((double)f_lo < min)
+        {
+            f_lo = can_float_step(f_lo, 1);
+        }
+        if ((double)f_hi > max)
+        {
+            f_hi = can_float_step(f_hi, 0);
+        }
+        if (!(f_lo <= f_hi))
+        {
+            return 0;
+        }
+        float v[2] = {f_lo == 0.0f ? 0.0f : f_lo, f_hi == 0.0f ? 0.0f : f_hi}; // -0.0 => 0.0
+        for (int k = 0; k < 2; k++)
+        {
+            uint32_t bits;
+            memcpy(&bits, &v[k], sizeof(float));
+            *(k == 0 ? lo : hi) = (bits & 0x80000000u) ? (uint32_t)~bits : (bits | 0x80000000u);
+        }
+        return 1;
+    }
+
+    int64_t tmin, tmax, v_lo, v_hi;
+    can_int_limits(dtype, &tmin, &tmax);
+    if (!can_int_range(min, max, tmin, tmax, &v_lo, &v_hi))
+    {
+        return 0;
+    }
+    if (dtype == 'u')
+    {
+        *lo = (uint64_t)v_lo;
+        *hi = (uint64_t)v_hi;
+        return 1;
+    }
+    // flip sign bit at the width of the type, plain char may be signed or unsigned
+    int width = (int)can_dtype_size(dtype) * 8;
+    uint64_t sign = dtype == 'C' && (char)-1 > 0 ? 0 : (uint64_t)1 << (width - 1);
+    uint64_t all = width == 64 ? UINT64_MAX : ((uint64_t)1 << width) - 1;
+    *lo = ((uint64_t)v_lo ^ sign) & all;
+    *hi = ((uint64_t)v_hi ^ sign) & all;
+    return 1;
+}
+
+/// @brief helper function, (re)build index of column j from its current values
+/// @param df IO dataframe
+/// @param j  I  column index
+static void can_index_build(can_dataframe *df, int j)
+{
+    can_index *ix = df->indexes[j];
+    if (ix == NULL)
+    {
+        ix = (can_index *)calloc(1, sizeof(can_index));
+        if (ix == NULL)
+        {
+            fprintf(stderr, "ERROR: can_create_index cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        df->indexes[j] = ix;
+    }
+    free(ix->perm);
+    free(ix->keys);
+
+    // stable radix argsort, keys end up sorted alongside perm
+    if (df->dtypes[j] == 'S')
+    {
+        // filters look up string codes, so index codes (as 'I') instead of string order
+        ix->keys = (uint64_t *)malloc(sizeof(uint64_t) * (df->n_row > 0 ? df->n_row : 1));
+        if (ix->keys == NULL)
+        {
+            fprintf(stderr, "ERROR: can_create_index cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        const int *vs = (const int *)df->values[j];
+        for (int i = 0; i < df->n_row; i++)
+        {
+            ix->keys[i] = (uint64_t)((uint32_t)vs[i] ^ 0x80000000u);
+        }
+    }
+    else
+    {
+        ix->keys = can_load_sort_keys(df, j);
+    }
+    ix->perm = (int *)malloc(sizeof(int) * (df->n_row > 0 ? df->n_row : 1));
+    if (ix->perm == NULL)
+    {
+        fprintf(stderr, "ERROR: can_create_index cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    can_radix_argsort(ix->keys, df->n_row, can_sort_key_width(df->dtypes[j]) / 8, ix->perm);
+    ix->n = df->n_row;
+    ix->stale = 0;
+}
+
+/// @brief helper function, first position of index whose key is >= key (or > key)
+/// @param ix    I index
+/// @param key   I normalized key
+/// @param upper I 0 for >= key, 1 for > key
+/// @return position in [0, ix->n]
+static int can_index_search(const can_index *ix, uint64_t key, int upper)
+{
+    int lo = 0, hi = ix->n;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (ix->keys[mid] < key || (upper && ix->keys[mid] == key))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/// @brief helper function, bit mask of rows of indexed column j whose value is in any range [min[r], max[r]],
+/// by binary search on the index (rebuilt first if stale, which is not thread safe),
+/// nothing is done when more than 1 / CAN_INDEX_SCAN_RATIO of rows match, a scan is faster then
+/// @param df      I dataframe, column j has an index
+/// @param j       I column index
+/// @param n_range I number of ranges
+/// @param min     I min value of every range (int / char converted exactly)
+/// @param max     I max value of every range
+/// @param mask    O (df->n_row + 63) / 64 words, untouched if 0 is returned
+/// @return 1 if mask is built, 0 if caller should scan
+static int can_index_mask(const can_dataframe *df, int j, int n_range, const double *min, const double *max, uint64_t *mask)
+{
+    if (df->indexes[j]->stale)
+    {
+        can_index_build((can_dataframe *)df, j);
+    }
+    const can_index *ix = df->indexes[j];
+
+    // count first, binary search is cheap
+    int64_t count = 0;
+    uint64_t lo, hi;
+    for (int r = 0; r < n_range; r++)
+    {
+        if (can_index_key_range(df->dtypes[j], min[r], max[r], &lo, &hi)) // false for NaN bounds
+        {
+            count += can_index_search(ix, hi, 1) - can_index_search(ix, lo, 0);
+        }
+    }
+    if (count > df->n_row / CAN_INDEX_SCAN_RATIO)
+    {
+        return 0;
+    }
+
+    memset(mask, 0, sizeof(uint64_t) * ((df->n_row + 63) / 64));
+    for (int r = 0; r < n_range; r++)
+    {
+        if (can_index_key_range(df->dtypes[j], min[r], max[r], &lo, &hi))
+        {
+            int end = can_index_search(ix, hi, 1);
+            for (int k = can_index_search(ix, lo, 0); k < end; k++)
+            {
+                int row = ix->perm[k];
+                mask[row >> 6] |= (uint64_t)1 << (row & 63);
+            }
+        }
+    }
+    return 1;
+}
+
+/// @brief build a sorted index of col (stable order of rows by value), range / equal / in filters on col
+/// (can_filter_*, can_filter, can_view_filter_*, can_query_*) then binary search it and only touch matching rows
+/// when few rows match. can_set_* / can_hset_* / can_get_*_pointer / can_mark_modified mark the index stale,
+/// the next filter that uses it rebuilds it first (batch writes before filtering). Writes through a raw column
+/// pointer are not tracked: call can_mark_modified after them, or filters keep using the index of the old values
+/// @param df  IO dataframe
+/// @param col I  column name
+void can_create_index(can_dataframe *df, char col[MAX_COL_LEN])
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_create_index cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_index_build(df, found_col);
+}
+
+/// @brief drop index of col built by can_create_index (nothing happens if col has no index)
+/// @param df  IO dataframe
+/// @param col I  column name
+void can_drop_index(can_dataframe *df, char col[MAX_COL_LEN])
+{
+    int found_col = can_find_col(df, col);
+    if (found_col == -1)
+    {
+        fprintf(stderr, "ERROR: can_drop_index cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    can_index_free(df->indexes[found_col]);
+    df->indexes[found_col] = NULL;
+}
+
+/// @brief helper function for can_groupby_agg / can_unique, load key columns as row-major 64 bit words,
+/// keys are packed from left to right into words of at most 64 bits (equal words <=> equal keys,
+/// -0.0 equals 0.0 and all NaN are equal), word order equals ascending key order
+/// @param df      I dataframe
+/// @param n_keys  I number of key columns
+/// @param key_idx I column index of keys
+/// @param n_word  O number of words per row
+/// @return key words, n_row * n_word (need free)
+static uint64_t *can_load_group_keys(const can_dataframe *df, int n_keys, const int *key_idx, int *n_word)
+{
+    // number of words, same packing as can_argsort_index (null flag of nullable key makes null rows one group)
+    int *items = (int *)can_malloc(sizeof(int) * 2 * n_keys, "can_load_group_keys");
+    int n_item = can_sort_key_items(df, n_keys, key_idx, NULL, items, NULL);
+    int width = 0;
+    *n_word = 0;
+    for (int k = 0; k < n_item; k++)
+    {
+        int w = can_sort_item_width(df, items[k]);
+        if (*n_word == 0 || width + w > 64)
+        {
+            (*n_word)++;
+            width = 0;
+        }
+        width += w;
+    }
+
+    if (n_item == 1)
+    {
+        free(items);
+        return can_load_sort_keys(df, key_idx[0]);
+    }
+
+    int n = df->n_row;
+    size_t n_total = (size_t)n * *n_word;
+    uint64_t *words = (uint64_t *)calloc(n_total > 0 ? n_total : 1, sizeof(uint64_t));
+    if (words == NULL)
+    {
+        fprintf(stderr, "ERROR: can_load_group_keys cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    int word = -1;
+    width = 0;
+    for (int k = 0; k < n_item; k++)
+    {
+        int w = can_sort_item_width(df, items[k]);
+        if (word == -1 || width + w > 64)
+        {
+            word++;
+            width = 0;
+        }
+        width += w;
+        uint64_t *keys = can_load_sort_item(df, items[k], 1);
+        uint64_t *dst = words + word;
+        for (int i = 0; i < n; i++)
+        {
+            // w == 64 only happens for a word of a single key, which is still 0
+            dst[(size_t)i * *n_word] = (w == 64 ? 0 : (dst[(size_t)i * *n_word] << w)) | keys[i];
+        }
+        free(keys);
+    }
+    free(items);
+    return words;
+}
+
+/// @brief helper function for can_groupby_agg / can_unique, assign group id to every row by its key words,
+/// group ids follow order of first appearance;
+/// sorted keys are grouped by detecting runs, otherwise by an open addressing hash table
+/// @param words     I key words of every row, n * n_word
+/// @param n         I number of rows
+/// @param n_word    I number of words per row
+/// @param gid       O group id of every row, n
+/// @param first_row O first row of every group (need free), n_group
+/// @return number of groups
+static int can_group_ids(const uint64_t *words, int n, int n_word, int *gid, int **first_row)
+{
+    *first_row = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (*first_row == NULL)
+    {
+        fprintf(stderr, "ERROR: can_group_ids cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // sorted input: every key is one run, no hashing needed
+    int sorted = 1;
+    for (int i = 1; i < n && sorted; i++)
+    {
+        const uint64_t *prev = words + (size_t)(i - 1) * n_word;
+        const uint64_t *cur = words + (size_t)i * n_word;
+        for (int w = 0; w < n_word; w++)
+        {
+            if (prev[w] != cur[w])
+            {
+                sorted = prev[w] < cur[w];
+                break;
+            }
+        }
+    }
+    int n_group = 0;
+    if (sorted)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (i == 0 || memcmp(words + (size_t)(i - 1) * n_word, words + (size_t)i * n_word, sizeof(uint64_t) * n_word) != 0)
+            {
+                (*first_row)[n_group++] = i;
+            }
+            gid[i] = n_group - 1;
+        }
+        return n_group;
+    }
+
+    // hash table from key words to group id, grows when half full
+    int cap = 1024;
+    int *slots = (int *)malloc(sizeof(int) * cap);
+    uint64_t *hashes = (uint64_t *)malloc(sizeof(uint64_t) * (n > 0 ? n : 1)); // hash of every group
+    if (slots == NULL || hashes == NULL)
+    {
+        fprintf(stderr, "ERROR: can_group_ids cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(slots, 0xff, sizeof(int) * cap); // all -1
+    for (int i = 0; i < n; i++)
+    {
+        const uint64_t *key = words + (size_t)i * n_word;
+        if (n_word == 1 && i > 0 && key[0] == key[-1])
+        {
+            // same key as previous row
+            gid[i] = gid[i - 1];
+            continue;
+        }
+        uint64_t h = can_hash_u64(key[0]);
+        for (int w = 1; w < n_word; w++)
+        {
+            h = can_hash_u64(h ^ key[w]);
+        }
+        int slot = (int)(h & (uint64_t)(cap - 1));
+        if (n_word == 1)
+        {
+            // single word key, hash is a bijection of the key
+            while (slots[slot] != -1 && hashes[slots[slot]] != h)
+            {
+                slot = (slot + 1) & (cap - 1);
+            }
+        }
+        else
+        {
+            while (slots[slot] != -1)
+            {
+                int g = slots[slot];
+                if (hashes[g] == h && memcmp(words + (size_t)(*first_row)[g] * n_word, key, sizeof(uint64_t) * n_word) == 0)
+                {
+                    break;
+                }
+                slot = (slot + 1) & (cap - 1);
+            }
+        }
+        if (slots[slot] != -1)
+        {
+            gid[i] = slots[slot];
+            continue;
+        }
+
+        // new group
+        hashes[n_group] = h;
+        (*first_row)[n_group] = i;
+        slots[slot] = n_group;
+        gid[i] = n_group++;
+        if (2 * n_group > cap)
+        {
+            cap *= 2;
+            int *grown = (int *)realloc(slots, sizeof(int) * cap);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "ERROR: can_group_ids cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            slots = grown;
+            memset(slots, 0xff, sizeof(int) * cap);
+            for (int g = 0; g < n_group; g++)
+            {
+                int s = (int)(hashes[g] & (uint64_t)(cap - 1));
+                while (slots[s] != -1)
+                {
+                    s = (s + 1) & (cap - 1);
+                }
+                slots[s] = g;
+            }
+        }
+    }
+    free(slots);
+    free(hashes);
+    return n_group;
+}
+
+/// @brief helper function for can_groupby_agg, default output column name "<col>_<op>"
+/// @param spec I aggregation
+/// @param name O column name
+static void can_agg_name(const can_agg_spec *spec, char name[MAX_COL_LEN])
+{
+    const char *op_names[] = {"sum", "mean", "count", "min", "max", "var", "first", "last"};
+    if (spec->name[0] != '\0')
+    {
+        strncpy(name, spec->name, MAX_COL_LEN - 1);
+    }
+    else if (spec->col[0] == '\0')
+    {
+        snprintf(name, MAX_COL_LEN, "%s", op_names[spec->op]);
+    }
+    else
+    {
+        snprintf(name, MAX_COL_LEN, "%.*s_%s", MAX_COL_LEN - 7, spec->col, op_names[spec->op]);
+    }
+}
+
+/// @brief helper function for can_groupby_agg, aggregate column j_src that has a validity bitmap into column j of res,
+/// only valid rows are visited (64 rows per bitmap word); sum of no value is 0, other results of no value are null
+/// @param res     IO result dataframe, n_group rows
+/// @param j       I  output column index
+/// @param df      I  dataframe
+/// @param j_src   I  aggregated column index
+/// @param op      I  CAN_AGG_*
+/// @param gid     I  group id of every row
+/// @param n_group I  number of groups
+static void can_agg_nullable(can_dataframe *res, int j, const can_dataframe *df, int j_src, int op, const int *gid, int n_group)
+{
+    int n = df->n_row;
+    const uint64_t *valid = df->valid[j_src];
+    const void *vs = df->values[j_src];
+    char dtype = df->dtypes[j_src];
+    int *count = (int *)calloc(n_group > 0 ? n_group : 1, sizeof(int));
+    int *pick = (int *)malloc(sizeof(int) * (n_group > 0 ? n_group : 1));
+    if (count == NULL || pick == NULL)
+    {
+        fprintf(stderr, "ERROR: can_groupby_agg cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int g = 0; g < n_group; g++)
+    {
+        pick[g] = -1;
+    }
+    for (int w = 0; w < (n + 63) / 64; w++)
+    {
+        for (uint64_t m = can_valid_word(valid, w, n); m != 0; m &= m - 1)
+        {
+            int i = w * 64 + can_ctz64(m);
+            count[gid[i]]++;
+            pick[gid[i]] = op == CAN_AGG_FIRST && pick[gid[i]] >= 0 ? pick[gid[i]] : i;
+        }
+    }
+
+    if (op == CAN_AGG_COUNT)
+    {
+        memcpy(res->values[j], count, sizeof(int) * n_group);
+    }
+    else if (op == CAN_AGG_FIRST || op == CAN_AGG_LAST || op == CAN_AGG_MIN || op == CAN_AGG_MAX)
+    {
+        if (op == CAN_AGG_MIN || op == CAN_AGG_MAX)
+        {
+            // row of smallest / largest normalized key, first such row on ties,
+            // first NaN of a group wins both min and max (NaN propagates, as without nulls)
+            uint64_t *keys = can_load_sort_keys(df, j_src);
+            int is_real = dtype == 'D' || dtype == 'f';
+            for (int g = 0; g < n_group; g++)
+            {
+                pick[g] = -1;
+            }
+            for (int w = 0; w < (n + 63) / 64; w++)
+            {
+                for (uint64_t m = can_valid_word(valid, w, n); m != 0; m &= m - 1)
+                {
+                    int i = w * 64 + can_ctz64(m);
+                    int b = pick[gid[i]];
+                    double x = is_real ? can_value_as_double(vs, dtype, i) : 0.0;
+                    double y = is_real && b >= 0 ? can_value_as_double(vs, dtype, b) : 0.0;
+                    if (y != y)
+                    {
+                        continue;
+                    }
+                    if (b < 0 || x != x || (op == CAN_AGG_MIN ? keys[i] < keys[b] : keys[i] > keys[b]))
+                    {
+                        pick[gid[i]] = i;
+                    }
+                }
+            }
+            free(keys);
+        }
+        for (int g = 0; g < n_group; g++)
+        {
+            if (pick[g] >= 0)
+            {
+                size_t size = can_dtype_size(dtype);
+                memcpy((char *)res->values[j] + (size_t)g * size, (const char *)vs + (size_t)pick[g] * size, size);
+            }
+            else
+            {
+                can_set_row_null(res, j, g);
+            }
+        }
+    }
+    else
+    {
+        // sum, then mean, then sum of squared deviation from mean
+        double *acc = (double *)res->values[j];
+        memset(acc, 0, sizeof(double) * n_group);
+        for (int w = 0; w < (n + 63) / 64; w++)
+        {
+            for (uint64_t m = can_valid_word(valid, w, n); m != 0; m &= m - 1)
+            {
+                int i = w * 64 + can_ctz64(m);
+                acc[gid[i]] += can_value_as_double(vs, dtype, i);
+            }
+        }
+        if (op != CAN_AGG_SUM)
+        {
+            for (int g = 0; g < n_group; g++)
+            {
+                acc[g] = count[g] > 0 ? acc[g] / count[g] : 0.0;
+            }
+        }
+        if (op == CAN_AGG_VAR)
+        {
+            double *m2 = (double *)calloc(n_group > 0 ? n_group : 1, sizeof(double));
+            if (m2 == NULL)
+            {
+                fprintf(stderr, "ERROR: can_groupby_agg cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            for (int w = 0; w < (n + 63) / 64; w++)
+            {
+                for (uint64_t m = can_valid_word(valid, w, n); m != 0; m &= m - 1)
+                {
+                    int i = w * 64 + can_ctz64(m);
+                    double d = can_value_as_double(vs, dtype, i) - acc[gid[i]];
+                    m2[gid[i]] += d * d;
+                }
+            }
+            for (int g = 0; g < n_group; g++)
+            {
+                acc[g] = count[g] > 1 ? m2[g] / (count[g] - 1) : 0.0;
+            }
+            free(m2);
+        }
+        for (int g = 0; g < n_group; g++)
+        {
+            if (op != CAN_AGG_SUM && count[g] < (op == CAN_AGG_VAR ? 2 : 1))
+            {
+                can_set_row_null(res, j, g);
+            }
+        }
+    }
+    free(count);
+    free(pick);
+}
+
+/// @brief group rows by key columns and aggregate other columns of every group,
+/// e.g. keys {"ANCHOR"} with specs {{CAN_AGG_MEAN, "E", ""}, {CAN_AGG_COUNT, "", "n"}}
+/// (groups are in order of first appearance, sum / mean / var are double, count is int,
+/// min / max / first / last keep the column type, min / max of a group holding NaN are NaN, var is sample variance, null for groups of one row;
+/// null values are skipped: count of a column counts non-null values, sum of no value is 0,
+/// other aggregations of no value are null; null keys form a group of their own)
+/// internally hash aggregation (run detection if keys are already sorted) into one accumulator array per spec
+/// @param df     I dataframe
+/// @param n_keys I number of key columns
+/// @param keys   I key column names
+/// @param n_spec I number of aggregations
+/// @param specs  I aggregations
+/// @return one row per group: key columns then one column per spec
+can_dataframe *can_groupby_agg(const can_dataframe *df, int n_keys, char keys[MAX_COL_NUM][MAX_COL_LEN], int n_spec, const can_agg_spec *specs)
+{
+    if (n_keys <= 0 || n_spec < 0)
+    {
+        fprintf(stderr, "ERROR: can_groupby_agg invalid n_keys = %d, n_spec = %d\n", n_keys, n_spec);
+        exit(EXIT_FAILURE);
+    }
+    int *key_idx = (int *)can_malloc(sizeof(int) * (n_keys + n_spec), "can_groupby_agg");
+    int *spec_idx = key_idx + n_keys;
+    for (int k = 0; k < n_keys; k++)
+    {
+        key_idx[k] = can_find_col(df, keys[k]);
+        if (key_idx[k] == -1)
+        {
+            fprintf(stderr, "ERROR: can_groupby_agg cannot found key col=%s\n", keys[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int s = 0; s < n_spec; s++)
+    {
+        if (specs[s].op < CAN_AGG_SUM || specs[s].op > CAN_AGG_LAST)
+        {
+            fprintf(stderr, "ERROR: can_groupby_agg invalid op = %d\n", specs[s].op);
+            exit(EXIT_FAILURE);
+        }
+        // only count with an empty column name counts rows, any named column must exist
+        int count_rows = specs[s].op == CAN_AGG_COUNT && specs[s].col[0] == '\0';
+        spec_idx[s] = count_rows ? -1 : can_find_col(df, specs[s].col);
+        if (spec_idx[s] == -1 && !count_rows)
+        {
+            fprintf(stderr, "ERROR: can_groupby_agg cannot found col=%s\n", specs[s].col);
+            exit(EXIT_FAILURE);
+        }
+        if (spec_idx[s] >= 0 && df->dtypes[spec_idx[s]] == 'S' && (specs[s].op == CAN_AGG_SUM || specs[s].op == CAN_AGG_MEAN || specs[s].op == CAN_AGG_VAR))
+        {
+            fprintf(stderr, "ERROR: can_groupby_agg cannot sum / mean / var string col=%s\n", specs[s].col);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // group id of every row
+    int n = df->n_row;
+    int n_word = 0;
+    uint64_t *words = can_load_group_keys(df, n_keys, key_idx, &n_word);
+    int *gid = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (gid == NULL)
+    {
+        fprintf(stderr, "ERROR: can_groupby_agg cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    int *first_row = NULL;
+    int n_group = can_group_ids(words, n, n_word, gid, &first_row);
+    free(words);
+
+    // rows of every group, last row of every group
+    int *count = (int *)calloc(n_group > 0 ? n_group : 1, sizeof(int));
+    int *last_row = (int *)malloc(sizeof(int) * (n_group > 0 ? n_group : 1));
+    if (count == NULL || last_row == NULL)
+    {
+        fprintf(stderr, "ERROR: can_groupby_agg cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        count[gid[i]]++;
+        last_row[gid[i]] = i;
+    }
+
+    // output columns
+    char(*cols)[MAX_COL_LEN] = (char(*)[MAX_COL_LEN])calloc(n_keys + n_spec, MAX_COL_LEN);
+    char *dtypes = (char *)can_malloc(n_keys + n_spec, "can_groupby_agg");
+    if (cols == NULL)
+    {
+        fprintf(stderr, "ERROR: can_groupby_agg cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < n_keys; k++)
+    {
+        strncpy(cols[k], df->cols[key_idx[k]], MAX_COL_LEN);
+        dtypes[k] = df->dtypes[key_idx[k]];
+    }
+    for (int s = 0; s < n_spec; s++)
+    {
+        int op = specs[s].op;
+        can_agg_name(&specs[s], cols[n_keys + s]);
+        if (op == CAN_AGG_COUNT)
+        {
+            dtypes[n_keys + s] = 'I';
+        }
+        else if (op == CAN_AGG_MIN || op == CAN_AGG_MAX || op == CAN_AGG_FIRST || op == CAN_AGG_LAST)
+        {
+            dtypes[n_keys + s] = df->dtypes[spec_idx[s]];
+        }
+        else
+        {
+            dtypes[n_keys + s] = 'D';
+        }
+    }
+    can_dataframe *res = can_alloc(n_group, n_keys + n_spec, cols, dtypes, NULL);
+    free(cols);
+    free(dtypes);
+    for (int k = 0; k < n_keys; k++)
+    {
+        can_gather_col(res->values[k], df->values[key_idx[k]], res->dtypes[k], first_row, n_group);
+        if (df->valid[key_idx[k]] != NULL)
+        {
+            can_valid_gather(res, k, df, key_idx[k], first_row, n_group);
+        }
+    }
+    for (int j = 0; j < n_keys + n_spec; j++)
+    {
+        // string columns keep codes of df
+        int j_src = j < n_keys ? key_idx[j] : spec_idx[j - n_keys];
+        if (res->dtypes[j] == 'S')
+        {
+            can_set_col_dict(res, j, df->dicts[j_src]);
+        }
+    }
+
+    // one tight pass over the column per spec, accumulator is the output column itself
+    for (int s = 0; s < n_spec; s++)
+    {
+        int op = specs[s].op;
+        void *out = res->values[n_keys + s];
+        const void *vs = spec_idx[s] >= 0 ? df->values[spec_idx[s]] : NULL;
+        char dtype = spec_idx[s] >= 0 ? df->dtypes[spec_idx[s]] : 'I';
+        if (spec_idx[s] >= 0 && df->valid[spec_idx[s]] != NULL)
+        {
+            can_agg_nullable(res, n_keys + s, df, spec_idx[s], op, gid, n_group);
+        }
+        else if (op == CAN_AGG_COUNT)
+        {
+            memcpy(out, count, sizeof(int) * n_group);
+        }
+        else if (op == CAN_AGG_FIRST)
+        {
+            can_gather_col(out, vs, dtype, first_row, n_group);
+        }
+        else if (op == CAN_AGG_LAST)
+        {
+            can_gather_col(out, vs, dtype, last_row, n_group);
+        }
+        else if (op == CAN_AGG_MIN || op == CAN_AGG_MAX)
+        {
+            // start from first value of every group
+            can_gather_col(out, vs, dtype, first_row, n_group);
+            int sign = op == CAN_AGG_MIN ? 1 : -1;
+            if (dtype == 'I')
+            {
+                const int *v = (const int *)vs;
+                int *acc = (int *)out;
+                for (int i = 0; i < n; i++)
+                {
+                    int g = gid[i];
+                    acc[g] = (sign > 0 ? v[i] < acc[g] : v[i] > acc[g]) ? v[i] : acc[g];
+                }
+            }
+            else if (dtype == 'D')
+            {
+                const double *v = (const double *)vs;
+                double *acc = (double *)out;
+                for (int i = 0; i < n; i++)
+                {
+                    // NaN propagates: taken when met, never replaced (comparisons with it are false)
+                    int g = gid[i];
+                    acc[g] = (v[i] != v[i] || (sign > 0 ? v[i] < acc[g] : v[i] > acc[g])) ? v[i] : acc[g];
+                }
+            }
+            else if (dtype == 'C')
+            {
+                const char *v = (const char *)vs;
+                char *acc = (char *)out;
+                for (int i = 0; i < n; i++)
+                {
+                    int g = gid[i];
+                    acc[g] = (sign > 0 ? v[i] < acc[g] : v[i] > acc[g]) ? v[i] : acc[g];
+                }
+            }
+            else if (dtype == 'f')
+            {
+                const float *v = (const float *)vs;
+                float *acc = (float *)out;
+                for (int i = 0; i < n; i++)
+                {
+                    // NaN propagates: taken when met, never replaced (comparisons with it are false)
+                    int g = gid[i];
+                    acc[g] = (v[i] != v[i] || (sign > 0 ? v[i] < acc[g] : v[i] > acc[g])) ? v[i] : acc[g];
+                }
+            }
+            else if (dtype == 'S')
+            {
+                // codes compared by their rank in string order, missing is smallest
+                const int *v = (const int *)vs;
+                int *acc = (int *)out;
+                int *rank = can_dict_ranks(df->dicts[spec_idx[s]]);
+                for (int i = 0; i < n; i++)
+                {
+                    int g = gid[i];
+                    int r = v[i] >= 0 ? rank[v[i]] : -1, cur = acc[g] >= 0 ? rank[acc[g]] : -1;
+                    acc[g] = (sign > 0 ? r < cur : r > cur) ? v[i] : acc[g];
+                }
+                free(rank);
+            }
+            else
+            {
+                // int8 / int16 / int64 / uint32, compared widened to int64
+                for (int i = 0; i < n; i++)
+                {
+                    int g = gid[i];
+                    int64_t x = can_value_as_int64(vs, dtype, i), cur = can_value_as_int64(out, dtype, g);
+                    if (sign > 0 ? x < cur : x > cur)
+                    {
+                        can_value_set_int64(out, dtype, g, x);
+                    }
+                }
+            }
+        }
+        else
+        {
+            // sum, then mean, then sum of squared deviation from mean (two passes for accuracy)
+            double *acc = (double *)out;
+            memset(acc, 0, sizeof(double) * n_group);
+            if (dtype == 'D')
+            {
+                const double *v = (const double *)vs;
+                for (int i = 0; i < n; i++)
+                {
+                    acc[gid[i]] += v[i];
+                }
+            }
+            else
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    acc[gid[i]] += can_value_as_double(vs, dtype, i);
+                }
+            }
+            if (op == CAN_AGG_SUM)
+            {
+                continue;
+            }
+            for (int g = 0; g < n_group; g++)
+            {
+                acc[g] /= count[g];
+            }
+            if (op == CAN_AGG_MEAN)
+            {
+                continue;
+            }
+            double *m2 = (double *)calloc(n_group > 0 ? n_group : 1, sizeof(double));
+            if (m2 == NULL)
+            {
+                fprintf(stderr, "ERROR: can_groupby_agg cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            for (int i = 0; i < n; i++)
+            {
+                double d = can_value_as_double(vs, dtype, i) - acc[gid[i]];
+                m2[gid[i]] += d * d;
+            }
+            for (int g = 0; g < n_group; g++)
+            {
+                acc[g] = count[g] > 1 ? m2[g] / (count[g] - 1) : MISS_DOUBLE;
+                if (count[g] <= 1)
+                {
+                    can_set_row_null(res, n_keys + s, g);
+                }
+            }
+            free(m2);
+        }
+    }
+
+    free(key_idx);
+    free(gid);
+    free(first_row);
+    free(last_row);
+    free(count);
+    return res;
+}
+
+/// @brief drop rows with duplicated keys, keep the first or last row of every key (rows keep their order)
+/// internally hash distinct (run detection if keys are already sorted), O(n), every column is copied once
+/// @param df        I dataframe
+/// @param n_keys    I number of key columns
+/// @param keys      I key column names
+/// @param keep_last I 0 keep first row of every key, 1 keep last row
+/// @param counts    O number of rows of every kept key in result order (need free), NULL if not wanted
+/// @return deduplicated dataframe (deep copy)
+can_dataframe *can_drop_duplicates(const can_dataframe *df, int n_keys, char keys[MAX_COL_NUM][MAX_COL_LEN], int keep_last, int **counts)
+{
+    if (n_keys <= 0)
+    {
+        fprintf(stderr, "ERROR: can_drop_duplicates invalid n_keys = %d\n", n_keys);
+        exit(EXIT_FAILURE);
+    }
+    int *key_idx = (int *)can_malloc(sizeof(int) * n_keys, "can_drop_duplicates");
+    for (int k = 0; k < n_keys; k++)
+    {
+        key_idx[k] = can_find_col(df, keys[k]);
+        if (key_idx[k] == -1)
+        {
+            fprintf(stderr, "ERROR: can_drop_duplicates cannot found key col=%s\n", keys[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // group id of every row
+    int n = df->n_row;
+    int n_word = 0;
+    uint64_t *words = can_load_group_keys(df, n_keys, key_idx, &n_word);
+    free(key_idx);
+    int *gid = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (gid == NULL)
+    {
+        fprintf(stderr, "ERROR: can_drop_duplicates cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    int *kept = NULL; // first row of every group, in ascending row order
+    int n_group = can_group_ids(words, n, n_word, gid, &kept);
+    free(words);
+
+    int *count = NULL;
+    if (counts != NULL || keep_last)
+    {
+        count = (int *)calloc(n_group > 0 ? n_group : 1, sizeof(int));
+        if (count == NULL)
+        {
+            fprintf(stderr, "ERROR: can_drop_duplicates cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            count[gid[i]]++;
+        }
+    }
+
+    if (keep_last)
+    {
+        // a row is the last of its group when no row of the group is left after it
+        int n_kept = 0;
+        for (int i = 0; i < n; i++)
+        {
+            if (--count[gid[i]] == 0)
+            {
+                kept[n_kept++] = i;
+            }
+        }
+        if (counts != NULL)
+        {
+            // count again, count was used up above
+            for (int i = 0; i < n; i++)
+            {
+                count[gid[i]]++;
+            }
+        }
+    }
+
+    if (counts != NULL)
+    {
+        *counts = (int *)malloc(sizeof(int) * (n_group > 0 ? n_group : 1));
+        if (*counts == NULL)
+        {
+            fprintf(stderr, "ERROR: can_drop_duplicates cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int g = 0; g < n_group; g++)
+        {
+            (*counts)[g] = count[gid[kept[g]]];
+        }
+    }
+
+    // copy every column once
+    can_dataframe *res = can_take_rows(df, kept, n_group);
+
+    free(gid);
+    free(kept);
+    free(count);
+    return res;
+}
+
+/// @brief drop rows with duplicated value of key_col, keep the first row of every value
+/// @param df      I dataframe
+/// @param key_col I key column name
+/// @return deduplicated dataframe (deep copy)
+can_dataframe *can_unique(const can_dataframe *df, char key_col[MAX_COL_LEN])
+{
+    char keys[MAX_COL_NUM][MAX_COL_LEN] = {""};
+    strncpy(keys[0], key_col, MAX_COL_LEN - 1);
+    return can_drop_duplicates(df, 1, keys, 0, NULL);
+}
+
+/// @brief helper function for can_query, column of an intermediate result
+typedef struct
+{
+    char name[MAX_COL_LEN];
+    char dtype;
+    int src; // 0 for source dataframe of query, k for right dataframe of k-th merge
+    int col; // column index in its dataframe
+} can_query_col;
+
+/// @brief helper function for can_query, columns after some steps of a query
+typedef struct
+{
+    int n_col;
+    can_query_col *cols;
+    int n_src;                  // 1 + number of merges
+    const can_dataframe **src; // source dataframe and right dataframe of every merge
+} can_query_schema;
+
+/// @brief helper function for can_query, first column of schema with name
+/// @param sc   I schema
+/// @param name I column name
+/// @return column index in schema, -1 if not found
+static int can_query_find(const can_query_schema *sc, const char *name)
+{
+    for (int c = 0; c < sc->n_col; c++)
+    {
+        if (strncmp(sc->cols[c].name, name, MAX_COL_LEN) == 0)
+        {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/// @brief helper function for can_query, schema after the first n_step steps of query
+/// @param q      I  query (steps already checked)
+/// @param n_step I  number of steps applied
+/// @param sc     IO schema, zeroed or from an earlier call (free by can_query_schema_free)
+static void can_query_schema_at(const can_query *q, int n_step, can_query_schema *sc)
+{
+    // every merge adds at most the columns of its right dataframe
+    int max_col = q->df->n_col;
+    int max_src = 1;
+    for (int s = 0; s < n_step; s++)
+    {
+        if (q->steps[s].op == CAN_QUERY_MERGE)
+        {
+            max_col += q->steps[s].right->n_col;
+            max_src++;
+        }
+    }
+    free(sc->cols);
+    free(sc->src);
+    sc->cols = (can_query_col *)can_malloc(sizeof(can_query_col) * max_col, "can_query");
+    sc->src = (const can_dataframe **)can_malloc(sizeof(const can_dataframe *) * max_src, "can_query");
+
+    sc->n_col = q->df->n_col;
+    for (int j = 0; j < q->df->n_col; j++)
+    {
+        strncpy(sc->cols[j].name, q->df->cols[j], MAX_COL_LEN);
+        sc->cols[j].dtype = q->df->dtypes[j];
+        sc->cols[j].src = 0;
+        sc->cols[j].col = j;
+    }
+    sc->n_src = 1;
+    sc->src[0] = q->df;
+
+    for (int s = 0; s < n_step; s++)
+    {
+        const can_query_step *st = &q->steps[s];
+        if (st->op == CAN_QUERY_SELECT)
+        {
+            can_query_col *cols = (can_query_col *)can_malloc(sizeof(can_query_col) * st->n_col, "can_query");
+            for (int k = 0; k < st->n_col; k++)
+            {
+                cols[k] = sc->cols[can_query_find(sc, st->cols[k])];
+            }
+            memcpy(sc->cols, cols, sizeof(can_query_col) * st->n_col);
+            sc->n_col = st->n_col;
+            free(cols);
+        }
+        else if (st->op == CAN_QUERY_MERGE)
+        {
+            // right columns except its key, same as can_merge_left
+            int found_col2 = can_find_col(st->right, st->cols[0]);
+            for (int j2 = 0; j2 < st->right->n_col; j2++)
+            {
+                if (j2 == found_col2)
+                {
+                    continue;
+                }
+                can_query_col *c = &sc->cols[sc->n_col++];
+                strncpy(c->name, st->right->cols[j2], MAX_COL_LEN);
+                c->dtype = st->right->dtypes[j2];
+                c->src = sc->n_src;
+                c->col = j2;
+            }
+            sc->src[sc->n_src++] = st->right;
+        }
+    }
+}
+
+/// @brief helper function for can_query, free arrays of schema
+/// @param sc IO schema
+static void can_query_schema_free(can_query_schema *sc)
+{
+    free(sc->cols);
+    free(sc->src);
+    sc->cols = NULL;
+    sc->src = NULL;
+}
+
+/// @brief helper function for can_query, check that every column of predicate is in schema with the right data type
+/// @param sc   I schema
+/// @param p    I predicate
+/// @param func I caller name for error message
+static void can_query_check_pred(const can_query_schema *sc, const can_pred *p, const char *func)
+{
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR || p->op == CAN_PRED_NOT)
+    {
+        can_query_check_pred(sc, p->a, func);
+        if (p->b != NULL)
+        {
+            can_query_check_pred(sc, p->b, func);
+        }
+        return;
+    }
+    int c = can_query_find(sc, p->col);
+    if (c == -1)
+    {
+        fprintf(stderr, "ERROR: %s cannot found col=%s\n", func, p->col);
+        exit(EXIT_FAILURE);
+    }
+    else if (p->op != CAN_PRED_NULL && !can_dtype_accepts(sc->cols[c].dtype, p->dtype))
+    {
+        fprintf(stderr, "ERROR: %s found col=%s but it is not %c type\n", func, p->col, p->dtype);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// @brief helper function for can_query, whether every column of predicate means the same column in both schemas
+/// @param a I schema
+/// @param b I schema
+/// @param p I predicate
+/// @return 1 if same, 0 otherwise
+static int can_query_same_pred_cols(const can_query_schema *a, const can_query_schema *b, const can_pred *p)
+{
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR || p->op == CAN_PRED_NOT)
+    {
+        return can_query_same_pred_cols(a, b, p->a) && (p->b == NULL || can_query_same_pred_cols(a, b, p->b));
+    }
+    int ca = can_query_find(a, p->col);
+    int cb = can_query_find(b, p->col);
+    return ca != -1 && cb != -1 && a->cols[ca].src == b->cols[cb].src && a->cols[ca].col == b->cols[cb].col;
+}
+
+/// @brief helper function for can_query, number of leaves of predicate (bound of its distinct column names)
+/// @param p I predicate
+/// @return number of leaves
+static int can_query_pred_n_leaf(const can_pred *p)
+{
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR || p->op == CAN_PRED_NOT)
+    {
+        return can_query_pred_n_leaf(p->a) + (p->b != NULL ? can_query_pred_n_leaf(p->b) : 0);
+    }
+    return 1;
+}
+
+/// @brief helper function for can_query, collect distinct column names of predicate
+/// @param p     I predicate
+/// @param n_col IO number of names
+/// @param cols  IO names, room for can_query_pred_n_leaf(p) names
+static void can_query_pred_cols(const can_pred *p, int *n_col, char cols[][MAX_COL_LEN])
+{
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR || p->op == CAN_PRED_NOT)
+    {
+        can_query_pred_cols(p->a, n_col, cols);
+        if (p->b != NULL)
+        {
+            can_query_pred_cols(p->b, n_col, cols);
+        }
+        return;
+    }
+    for (int k = 0; k < *n_col; k++)
+    {
+        if (strncmp(cols[k], p->col, MAX_COL_LEN) == 0)
+        {
+            return;
+        }
+    }
+    strncpy(cols[(*n_col)++], p->col, MAX_COL_LEN);
+}
+
+/// @brief helper function, add step to query
+/// @param q    IO query
+/// @param op   I  CAN_QUERY_*
+/// @param func I  caller name for error message
+/// @return new step (zeroed)
+static can_query_step *can_query_add(can_query *q, int op, const char *func)
+{
+    if (q->n_step == q->cap_step)
+    {
+        int cap = q->cap_step > 0 ? 2 * q->cap_step : 8;
+        can_query_step *steps = (can_query_step *)realloc(q->steps, sizeof(can_query_step) * cap);
+        if (steps == NULL)
+        {
+            fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+            exit(EXIT_FAILURE);
+        }
+        q->steps = steps;
+        q->cap_step = cap;
+    }
+    can_query_step *st = &q->steps[q->n_step++];
+    memset(st, 0, sizeof(can_query_step));
+    st->op = op;
+    return st;
+}
+
+/// @brief helper function, copy column names into step
+/// @param st    IO step
+/// @param n_col I  number of columns
+/// @param cols  I  column names
+/// @param func  I  caller name for error message
+static void can_query_step_cols(can_query_step *st, int n_col, const char cols[][MAX_COL_LEN], const char *func)
+{
+    st->n_col = n_col;
+    st->cols = (char(*)[MAX_COL_LEN])calloc(n_col, MAX_COL_LEN);
+    if (st->cols == NULL)
+    {
+        fprintf(stderr, "ERROR: %s cannot alloc memory\n", func);
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < n_col; k++)
+    {
+        strncpy(st->cols[k], cols[k], MAX_COL_LEN - 1);
+    }
+}
+
+/// @brief start a lazy query on df, steps are only recorded until can_query_collect
+/// @param df I source dataframe, must outlive the query
+/// @return query (free by can_query_free)
+can_query *can_query_from(const can_dataframe *df)
+{
+    can_query *q = (can_query *)calloc(1, sizeof(can_query));
+    if (q == NULL)
+    {
+        fprintf(stderr, "ERROR: can_query_from cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+    q->df = df;
+    return q;
+}
+
+/// @brief record step: keep only some columns
+/// @param q     IO query
+/// @param n_col I  number of columns selected
+/// @param cols  I  column names
+void can_query_select(can_query *q, int n_col, char cols[MAX_COL_NUM][MAX_COL_LEN])
+{
+    if (n_col <= 0)
+    {
+        fprintf(stderr, "ERROR: can_query_select invalid n_col = %d\n", n_col);
+        exit(EXIT_FAILURE);
+    }
+    can_query_schema sc = {0};
+    can_query_schema_at(q, q->n_step, &sc);
+    for (int k = 0; k < n_col; k++)
+    {
+        if (can_query_find(&sc, cols[k]) == -1)
+        {
+            fprintf(stderr, "ERROR: can_query_select cannot found col=%s\n", cols[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    can_query_schema_free(&sc);
+
+    can_query_step *st = can_query_add(q, CAN_QUERY_SELECT, "can_query_select");
+    can_query_step_cols(st, n_col, cols, "can_query_select");
+}
+
+/// @brief record step: keep rows that satisfy predicate
+/// @param q IO query
+/// @param p I  predicate built by can_pred_* (owned by query)
+void can_query_filter(can_query *q, can_pred *p)
+{
+    can_query_schema sc = {0};
+    can_query_schema_at(q, q->n_step, &sc);
+    can_query_check_pred(&sc, p, "can_query_filter");
+    can_query_schema_free(&sc);
+
+    can_query_step *st = can_query_add(q, CAN_QUERY_FILTER, "can_query_filter");
+    st->pred = p;
+}
+
+/// @brief record step: stable sort by multiple key columns
+/// @param q         IO query
+/// @param n_keys    I  number of key columns
+/// @param cols      I  key column names, first key is most significant
+/// @param ascending I  1 ascending / 0 descending of every key, NULL means all ascending
+void can_query_sort_by(can_query *q, int n_keys, char cols[MAX_COL_NUM][MAX_COL_LEN], const int *ascending)
+{
+    if (n_keys <= 0)
+    {
+        fprintf(stderr, "ERROR: can_query_sort_by invalid n_keys = %d\n", n_keys);
+        exit(EXIT_FAILURE);
+    }
+    can_query_schema sc = {0};
+    can_query_schema_at(q, q->n_step, &sc);
+    for (int k = 0; k < n_keys; k++)
+    {
+        if (can_query_find(&sc, cols[k]) == -1)
+        {
+            fprintf(stderr, "ERROR: can_query_sort_by cannot found col=%s\n", cols[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    can_query_schema_free(&sc);
+
+    can_query_step *st = can_query_add(q, CAN_QUERY_SORT, "can_query_sort_by");
+    can_query_step_cols(st, n_keys, cols, "can_query_sort_by");
+    st->ascending = (int *)can_malloc(sizeof(int) * n_keys, "can_query_sort_by");
+    for (int k = 0; k < n_keys; k++)
+    {
+        st->ascending[k] = ascending == NULL || ascending[k];
+    }
+}
+
+/// @brief record step: left merge with df2 on key_col, same result as can_merge_left
+/// @param q       IO query
+/// @param df2     I  right dataframe, must outlive the query
+/// @param key_col I  the key column name
+void can_query_merge_left(can_query *q, const can_dataframe *df2, char key_col[MAX_COL_LEN])
+{
+    can_query_schema sc = {0};
+    can_query_schema_at(q, q->n_step, &sc);
+    int c = can_query_find(&sc, key_col);
+    int found_col2 = can_find_col(df2, key_col);
+    if (c == -1 || found_col2 == -1)
+    {
+        fprintf(stderr, "ERROR: can_query_merge_left key_col %s is not in both dataframes\n", key_col);
+        exit(EXIT_FAILURE);
+    }
+    else if (sc.cols[c].dtype != df2->dtypes[found_col2])
+    {
+        fprintf(stderr, "ERROR: can_query_merge_left key col %s have different type %c, %c\n", key_col, sc.cols[c].dtype, df2->dtypes[found_col2]);
+        exit(EXIT_FAILURE);
+    }
+    can_query_schema_free(&sc);
+
+    can_query_step *st = can_query_add(q, CAN_QUERY_MERGE, "can_query_merge_left");
+    can_query_step_cols(st, 1, (const char(*)[MAX_COL_LEN])key_col, "can_query_merge_left");
+    st->right = df2;
+}
+
+/// @brief record step: keep at most the first n_row rows
+/// @param q     IO query
+/// @param n_row I  max number of rows
+void can_query_limit(can_query *q, int n_row)
+{
+    can_query_step *st = can_query_add(q, CAN_QUERY_LIMIT, "can_query_limit");
+    st->limit = n_row > 0 ? n_row : 0;
+}
+
+/// @brief free query and the predicates it owns (dataframes are not touched)
+/// @param q IO query
+void can_query_free(can_query *q)
+{
+    for (int s = 0; s < q->n_step; s++)
+    {
+        can_pred_free(q->steps[s].pred);
+        free(q->steps[s].cols);
+        free(q->steps[s].ascending);
+    }
+    free(q->steps);
+    free(q);
+}
+
+/// @brief helper function for can_query_plan, whether any later step or the result uses a column of the merge at step s
+/// @param q I query
+/// @param s I step index of merge
+/// @return 1 if used, 0 otherwise
+static int can_query_merge_used(const can_query *q, int s)
+{
+    can_query_schema sc = {0};
+    can_query_schema_at(q, s + 1, &sc);
+    int src = sc.n_src - 1;
+    int used = 0;
+    for (int t = s + 1; t <= q->n_step && !used; t++)
+    {
+        can_query_schema_at(q, t, &sc);
+        if (t == q->n_step)
+        {
+            // columns of result
+            for (int c = 0; c < sc.n_col && !used; c++)
+            {
+                used = sc.cols[c].src == src;
+            }
+            break;
+        }
+        const can_query_step *st = &q->steps[t];
+        if (st->op == CAN_QUERY_FILTER)
+        {
+            char(*cols)[MAX_COL_LEN] = (char(*)[MAX_COL_LEN])can_malloc((size_t)MAX_COL_LEN * can_query_pred_n_leaf(st->pred), "can_query_collect");
+            int n_col = 0;
+            can_query_pred_cols(st->pred, &n_col, cols);
+            for (int k = 0; k < n_col && !used; k++)
+            {
+                used = sc.cols[can_query_find(&sc, cols[k])].src == src;
+            }
+            free(cols);
+        }
+        else
+        {
+            for (int k = 0; k < st->n_col && !used; k++)
+            {
+                used = sc.cols[can_query_find(&sc, st->cols[k])].src == src;
+            }
+        }
+    }
+    can_query_schema_free(&sc);
+    return used;
+}
+
+/// @brief helper function for can_query_collect, rewrite steps: split AND filters into one filter per clause,
+/// move every filter below sorts, selects, other filters and the merges it does not depend on,
+/// fuse adjacent filters back into one predicate, then drop merges whose columns are never used
+/// (a left merge keeps every left row, so the result does not change; limits are barriers)
+/// @param q IO query
+static void can_query_plan(can_query *q)
+{
+    // split AND so every clause moves down on its own
+    for (int s = 0; s < q->n_step; s++)
+    {
+        while (q->steps[s].op == CAN_QUERY_FILTER && q->steps[s].pred->op == CAN_PRED_AND)
+        {
+            can_pred *and_pred = q->steps[s].pred;
+            can_query_add(q, CAN_QUERY_FILTER, "can_query_collect");
+            memmove(&q->steps[s + 2], &q->steps[s + 1], sizeof(can_query_step) * (q->n_step - s - 2));
+            q->steps[s + 1] = q->steps[s];
+            q->steps[s].pred = and_pred->a;
+            q->steps[s + 1].pred = and_pred->b;
+            free(and_pred); // children are owned by the new steps
+        }
+    }
+
+    // push filter down while the step below does not change which rows and values it sees
+    for (int s = 0; s < q->n_step; s++)
+    {
+        if (q->steps[s].op != CAN_QUERY_FILTER)
+        {
+            continue;
+        }
+        int k = s;
+        while (k > 0 && q->steps[k - 1].op != CAN_QUERY_LIMIT)
+        {
+            can_query_schema before = {0}, after = {0};
+            can_query_schema_at(q, k - 1, &before);
+            can_query_schema_at(q, k, &after);
+            int same = can_query_same_pred_cols(&before, &after, q->steps[k].pred);
+            can_query_schema_free(&before);
+            can_query_schema_free(&after);
+            if (!same)
+            {
+                break;
+            }
+            can_query_step tmp = q->steps[k - 1];
+            q->steps[k - 1] = q->steps[k];
+            q->steps[k] = tmp;
+            k--;
+        }
+    }
+
+    // fuse adjacent filters, evaluated into one bit mask
+    int s = 1;
+    while (s < q->n_step)
+    {
+        if (q->steps[s].op == CAN_QUERY_FILTER && q->steps[s - 1].op == CAN_QUERY_FILTER)
+        {
+            q->steps[s - 1].pred = can_pred_and(q->steps[s - 1].pred, q->steps[s].pred);
+            memmove(&q->steps[s], &q->steps[s + 1], sizeof(can_query_step) * (q->n_step - s - 1));
+            q->n_step--;
+        }
+        else
+        {
+            s++;
+        }
+    }
+
+    s = 0;
+    while (s < q->n_step)
+    {
+        if (q->steps[s].op == CAN_QUERY_MERGE && !can_query_merge_used(q, s))
+        {
+            free(q->steps[s].cols);
+            memmove(&q->steps[s], &q->steps[s + 1], sizeof(can_query_step) * (q->n_step - s - 1));
+            q->n_step--;
+        }
+        else
+        {
+            s++;
+        }
+    }
+}
+
+/// @brief helper function for can_query_collect, gather one column of schema for current rows
+/// (string column shares the dictionary of its source, rows without merge match are null)
+/// @param res   IO dataframe of n rows
+/// @param k     I  column index in res
+/// @param sc    I  schema
+/// @param c     I  column index in schema
+/// @param n     I  number of current rows
+/// @param rows  I  row of source dataframe of each current row, NULL means 0, 1, ..., n - 1
+/// @param match I  matched row of right dataframe of each current row, by merge
+static void can_query_gather(can_dataframe *res, int k, const can_query_schema *sc, int c, int n, const int *rows, int *const *match)
+{
+    const can_query_col *col = &sc->cols[c];
+    const can_dataframe *df = sc->src[col->src];
+    const void *src = df->values[col->col];
+    void *dst = res->values[k];
+    if (col->dtype == 'S')
+    {
+        can_set_col_dict(res, k, df->dicts[col->col]);
+    }
+    if (col->src > 0)
+    {
+        can_gather_col(dst, src, col->dtype, match[col->src], n);
+        can_valid_gather(res, k, df, col->col, match[col->src], n);
+    }
+    else if (rows != NULL)
+    {
+        can_gather_col(dst, src, col->dtype, rows, n);
+        if (df->valid[col->col] != NULL)
+        {
+            can_valid_gather(res, k, df, col->col, rows, n);
+        }
+    }
+    else
+    {
+        memcpy(dst, src, can_dtype_size(col->dtype) * n);
+        can_valid_copy(res, k, 0, df->valid[col->col], 0, n);
+    }
+}
+
+/// @brief helper function for can_query_collect, dataframe of some columns of schema for current rows
+/// @param sc    I schema
+/// @param n_col I number of columns
+/// @param cols  I column names
+/// @param n     I number of current rows
+/// @param rows  I row of source dataframe of each current row, NULL means 0, 1, ..., n - 1
+/// @param match I matched row of right dataframe of each current row, by merge
+/// @return dataframe of n rows (need free)
+static can_dataframe *can_query_columns(const can_query_schema *sc, int n_col, const char cols[][MAX_COL_LEN], int n, const int *rows, int *const *match)
+{
+    int *idx = (int *)can_malloc(sizeof(int) * n_col, "can_query_collect");
+    char *dtypes = (char *)can_malloc(n_col, "can_query_collect");
+    for (int k = 0; k < n_col; k++)
+    {
+        idx[k] = can_query_find(sc, cols[k]);
+        dtypes[k] = sc->cols[idx[k]].dtype;
+    }
+    can_dataframe *res = can_alloc(n, n_col, cols, dtypes, NULL);
+    for (int k = 0; k < n_col; k++)
+    {
+        can_query_gather(res, k, sc, idx[k], n, rows, match);
+    }
+    free(idx);
+    free(dtypes);
+    return res;
+}
+
+/// @brief helper function for can_query_collect, keep current rows idx[0], ..., idx[n_idx - 1] in that order
+/// @param rows    IO row of source dataframe of each current row, NULL means 0, 1, ..., n - 1
+/// @param match   IO matched row of right dataframe of each current row, match[1, n_src)
+/// @param n_src   I  number of sources
+/// @param idx     I  current rows kept
+/// @param n_idx   I  number of current rows kept
+static void can_query_take(int **rows, int **match, int n_src, const int *idx, int n_idx)
+{
+    for (int k = 0; k < n_src; k++)
+    {
+        int *old = k == 0 ? *rows : match[k];
+        if (k == 0 && old == NULL)
+        {
+            // identity rows, kept rows are idx itself
+            *rows = (int *)malloc(sizeof(int) * (n_idx > 0 ? n_idx : 1));
+            if (*rows == NULL)
+            {
+                fprintf(stderr, "ERROR: can_query_collect cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            memcpy(*rows, idx, sizeof(int) * n_idx);
+            continue;
+        }
+        int *kept = (int *)malloc(sizeof(int) * (n_idx > 0 ? n_idx : 1));
+        if (kept == NULL)
+        {
+            fprintf(stderr, "ERROR: can_query_collect cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n_idx; i++)
+        {
+            kept[i] = old[idx[i]];
+        }
+        free(old);
+        if (k == 0)
+        {
+            *rows = kept;
+        }
+        else
+        {
+            match[k] = kept;
+        }
+    }
+}
+
+/// @brief plan and run query, only the final result is materialized
+/// the planner pushes filters below sorts, selects and unrelated merges, fuses adjacent filters and drops unused merges,
+/// intermediate steps only move row numbers and gather the columns they reference (projection pushdown)
+/// @param q IO query (steps are rewritten by the planner, result does not change)
+/// @return result dataframe (deep copy)
+can_dataframe *can_query_collect(can_query *q)
+{
+    can_query_plan(q);
+
+    can_query_schema sc = {0};
+    can_query_schema_at(q, 0, &sc);
+    int n = q->df->n_row;
+    int *rows = NULL; // row of source dataframe of each current row, NULL means identity
+    int n_merge = 0;
+    for (int s = 0; s < q->n_step; s++)
+    {
+        n_merge += q->steps[s].op == CAN_QUERY_MERGE;
+    }
+    int **match = (int **)calloc(n_merge + 1, sizeof(int *)); // matched row of right dataframe of each merge
+    if (match == NULL)
+    {
+        fprintf(stderr, "ERROR: can_query_collect cannot alloc memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int s = 0; s < q->n_step; s++)
+    {
+        const can_query_step *st = &q->steps[s];
+        if (st->op == CAN_QUERY_FILTER)
+        {
+            uint64_t *mask = can_mask_alloc(n, "can_query_collect");
+            char(*cols)[MAX_COL_LEN] = (char(*)[MAX_COL_LEN])can_malloc((size_t)MAX_COL_LEN * can_query_pred_n_leaf(st->pred), "can_query_collect");
+            int n_col = 0;
+            can_query_pred_cols(st->pred, &n_col, cols);
+            int direct = rows == NULL && n == q->df->n_row;
+            for (int k = 0; k < n_col && direct; k++)
+            {
+                int c = can_query_find(&sc, cols[k]);
+                direct = sc.cols[c].src == 0 && sc.cols[c].col == can_find_col(q->df, cols[k]);
+            }
+            if (direct)
+            {
+                // filter on untouched source dataframe, nothing to gather
+                can_pred_mask(q->df, st->pred, mask);
+            }
+            else
+            {
+                can_dataframe *tmp = can_query_columns(&sc, n_col, (const char(*)[MAX_COL_LEN])cols, n, rows, match);
+                can_pred_mask(tmp, st->pred, mask);
+                can_free(tmp);
+            }
+            free(cols);
+            int *idx = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+            if (idx == NULL)
+            {
+                fprintf(stderr, "ERROR: can_query_collect cannot alloc memory\n");
+                exit(EXIT_FAILURE);
+            }
+            int n_idx = can_mask_to_rows(mask, n, idx);
+            can_query_take(&rows, match, sc.n_src, idx, n_idx);
+            n = n_idx;
+            free(idx);
+            free(mask);
+        }
+        else if (st->op == CAN_QUERY_SORT)
+        {
+            can_dataframe *tmp = can_query_columns(&sc, st->n_col, (const char(*)[MAX_COL_LEN])st->cols, n, rows, match);
+            int *key_idx = (int *)can_malloc(sizeof(int) * st->n_col, "can_query_collect");
+            for (int k = 0; k < st->n_col; k++)
+            {
+                key_idx[k] = k;
+            }
+            int *order = can_argsort_index(tmp, st->n_col, key_idx, st->ascending, 1);
+            free(key_idx);
+            can_free(tmp);
+            can_query_take(&rows, match, sc.n_src, order, n);
+            free(order);
+        }
+        else if (st->op == CAN_QUERY_MERGE)
+        {
+            can_dataframe *tmp = can_query_columns(&sc, 1, (const char(*)[MAX_COL_LEN])st->cols, n, rows, match);
+            match[sc.n_src] = can_merge_match(tmp, 0, st->right, can_find_col(st->right, st->cols[0]));
+            can_free(tmp);
+        }
+        else if (st->op == CAN_QUERY_LIMIT)
+        {
+            n = n < st->limit ? n : st->limit;
+        }
+        can_query_schema_at(q, s + 1, &sc);
+    }
+
+    // materialize output columns once
+    char *dtypes = (char *)can_malloc(sc.n_col, "can_query_collect");
+    for (int c = 0; c < sc.n_col; c++)
+    {
+        dtypes[c] = sc.cols[c].dtype;
+    }
+    can_dataframe *res = can_frame_new(n, sc.n_col, dtypes, 1, "can_query_collect");
+    free(dtypes);
+    for (int c = 0; c < sc.n_col; c++)
+    {
+        strncpy(res->cols[c], sc.cols[c].name, MAX_COL_LEN);
+    }
+    can_build_col_hash(res);
+    for (int c = 0; c < sc.n_col; c++)
+    {
+        can_query_gather(res, c, &sc, c, n, rows, match);
+    }
+
+    free(rows);
+    for (int k = 1; k < sc.n_src; k++)
+    {
+        free(match[k]);
+    }
+    free(match);
+    can_query_schema_free(&sc);
+    return res;
+}
+
+/// @brief helper function for can_compress, number of bits of x without leading zeros
+/// @param x I 64 bit word
+/// @return bit width, 0 for x = 0
+static inline int can_bit_width(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return x == 0 ? 0 : 64 - __builtin_clzll(x);
+#else
+    int n = 0;
+    while (x != 0)
+    {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/// @brief helper function for can_compress, whether values of dtype are encoded as integers
+/// (integer types, char and string codes, double / float only take PLAIN / RLE)
+/// @param dtype I data type
+/// @return 1 if integer like
+static inline int can_enc_is_int(char dtype)
+{
+    return dtype != 'D' && dtype != 'f';
+}
+
+/// @brief helper function for can_compress, encode column j of df with the smallest of PLAIN / RLE / FOR / DELTA
+/// @param e  O encoded column
+/// @param df I dataframe
+/// @param j  I column index
+static void can_enc_col_build(can_enc_col *e, const can_dataframe *df, int j)
+{
+    int n = df->n_row;
+    char dtype = df->dtypes[j];
+    size_t size = can_dtype_size(dtype);
+    const char *vs = (const char *)df->values[j];
+    int n_block = (n + CAN_ENC_BLOCK - 1) / CAN_ENC_BLOCK;
+    memset(e, 0, sizeof(can_enc_col));
+    e->dtype = dtype;
+
+    // size of every encoding: runs of bitwise equal values, range of values, range of differences inside blocks
+    int n_run = n > 0 ? 1 : 0;
+    for (int i = 1; i < n; i++)
+    {
+        n_run += memcmp(vs + (size_t)i * size, vs + (size_t)(i - 1) * size, size) != 0;
+    }
+    e->enc = CAN_ENC_PLAIN;
+    e->bytes = (size_t)n * size;
+    if ((size_t)n_run * (size + sizeof(int)) < e->bytes)
+    {
+        e->enc = CAN_ENC_RLE;
+        e->bytes = (size_t)n_run * (size + sizeof(int));
+    }
+    int width_for = 0, width_delta = 0;
+    int64_t v_min = 0, d_min = 0;
+    if (can_enc_is_int(dtype) && n > 0)
+    {
+        int64_t v_max = can_value_as_int64(vs, dtype, 0), d_max = 0;
+        int has_delta = 0;
+        v_min = v_max;
+        for (int i = 1; i < n; i++)
+        {
+            int64_t v = can_value_as_int64(vs, dtype, i);
+            v_min = v < v_min ? v : v_min;
+            v_max = v > v_max ? v : v_max;
+            if (i % CAN_ENC_BLOCK != 0)
+            {
+                // wraps like the decoder, so any int64 difference round trips
+                int64_t d = (int64_t)((uint64_t)v - (uint64_t)can_value_as_int64(vs, dtype, i - 1));
+                d_min = !has_delta || d < d_min ? d : d_min;
+                d_max = !has_delta || d > d_max ? d : d_max;
+                has_delta = 1;
+            }
+        }
+        width_for = can_bit_width((uint64_t)v_max - (uint64_t)v_min);
+        width_delta = can_bit_width((uint64_t)d_max - (uint64_t)d_min);
+        size_t bytes_for = sizeof(uint64_t) * (((size_t)n * width_for + 63) / 64 + 1) + sizeof(int64_t) * 2 * n_block;
+        size_t bytes_delta = sizeof(uint64_t) * (((size_t)n * width_delta + 63) / 64 + 1) + sizeof(int64_t) * 3 * n_block;
+        if (bytes_for < e->bytes)
+        {
+            e->enc = CAN_ENC_FOR;
+            e->bytes = bytes_for;
+        }
+        if (bytes_delta < e->bytes)
+        {
+            e->enc = CAN_ENC_DELTA;
+            e->bytes = bytes_delta;
+        }
+    }
+
+    if (e->enc == CAN_ENC_PLAIN)
+    {
+        e->values = can_malloc(n > 0 ? (size_t)n * size : 1, "can_compress");
+        memcpy(e->values, vs, (size_t)n * size);
+    }
+    else if (e->enc == CAN_ENC_RLE)
+    {
+        e->n_run = n_run;
+        e->values = can_malloc((size_t)n_run * size, "can_compress");
+        e->run_end = (int *)can_malloc(sizeof(int) * n_run, "can_compress");
+        int r = 0;
+        for (int i = 1; i <= n; i++)
+        {
+            if (i == n || memcmp(vs + (size_t)i * size, vs + (size_t)(i - 1) * size, size) != 0)
+            {
+                memcpy((char *)e->values + (size_t)r * size, vs + (size_t)(i - 1) * size, size);
+                e->run_end[r++] = i;
+            }
+        }
+    }
+    else
+    {
+        e->width = e->enc == CAN_ENC_FOR ? width_for : width_delta;
+        e->ref = e->enc == CAN_ENC_FOR ? v_min : d_min;
+        e->bits = (uint64_t *)calloc(((size_t)n * e->width + 63) / 64 + 1, sizeof(uint64_t)); // spare word for can_bits_get
+        e->block_min = (int64_t *)can_malloc(sizeof(int64_t) * n_block, "can_compress");
+        e->block_max = (int64_t *)can_malloc(sizeof(int64_t) * n_block, "can_compress");
+        if (e->bits == NULL)
+        {
+            fprintf(stderr, "ERROR: can_compress cannot alloc memory\n");
+            exit(EXIT_FAILURE);
+        }
+        if (e->enc == CAN_ENC_DELTA)
+        {
+            e->block_first = (int64_t *)can_malloc(sizeof(int64_t) * n_block, "can_compress");
+        }
+        for (int b = 0; b < n_block; b++)
+        {
+            int start = b * CAN_ENC_BLOCK;
+            int end = n - start < CAN_ENC_BLOCK ? n : start + CAN_ENC_BLOCK;
+            int64_t prev = can_value_as_int64(vs, dtype, start);
+            e->block_min[b] = e->block_max[b] = prev;
+            if (e->enc == CAN_ENC_DELTA)
+            {
+                e->block_first[b] = prev;
+            }
+            for (int i = start; i < end; i++)
+            {
+                int64_t v = can_value_as_int64(vs, dtype, i);
+                e->block_min[b] = v < e->block_min[b] ? v : e->block_min[b];
+                e->block_max[b] = v > e->block_max[b] ? v : e->block_max[b];
+                uint64_t code = e->enc == CAN_ENC_FOR ? (uint64_t)v - (uint64_t)e->ref : (i == start ? 0 : (uint64_t)v - (uint64_t)prev - (uint64_t)e->ref);
+                if (e->width > 0)
                 {
-                    char v = can_get_char(df, i, (char *)df->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                    can_set_char(res, row_i, res->cols[j], v);
+                    can_bits_set(e->bits, (size_t)i * e->width, e->width, code);
                 }
+                prev = v;
             }
-            row_i++;
         }
     }
-    return res;
 }
 
-/// @brief concatenate two dataframe by row
-/// @param df1 I dataframe 1
-/// @param df2 I dataframe 2
-/// @return concatenated dataframe
-can_dataframe *can_concat_row(const can_dataframe *df1, const can_dataframe *df2)
+/// @brief helper function, decode rows [start, start + n) of encoded column
+/// @param e     I encoded column
+/// @param start I first row, multiple of CAN_ENC_BLOCK
+/// @param n     I number of rows, at most CAN_ENC_BLOCK
+/// @param dst   O n values of e->dtype
+static void can_enc_decode(const can_enc_col *e, int start, int n, void *dst)
 {
-    // check if have same cols
-    if (df1->n_col != df2->n_col)
+    size_t size = can_dtype_size(e->dtype);
+    if (e->enc == CAN_ENC_PLAIN)
     {
-        fprintf(stderr, "ERROR: can_concat_row df1->n_col != df2->n_col\n");
-        exit(EXIT_FAILURE);
+        memcpy(dst, (const char *)e->values + (size_t)start * size, (size_t)n * size);
     }
-    for (int j = 0; j < df1->n_col; j++)
+    else if (e->enc == CAN_ENC_RLE)
     {
-        if (strcmp(df1->cols[j], df2->cols[j]) != 0)
+        // first run that reaches past start, then fill run by run
+        int lo = 0, hi = e->n_run - 1;
+        while (lo < hi)
         {
-            fprintf(stderr, "ERROR: can_concat_row column of df1 %s have different name with df2\n", df1->cols[j]);
-            exit(EXIT_FAILURE);
+            int mid = (lo + hi) >> 1;
+            if (e->run_end[mid] <= start)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
         }
-
-        if (df1->dtypes[j] != df2->dtypes[j])
+        for (int i = start, r = lo; i < start + n; r++)
         {
-            fprintf(stderr, "ERROR: can_concat_row column of df1 %s have different data type with df2\n", df1->cols[j]);
-            exit(EXIT_FAILURE);
+            int end = e->run_end[r] < start + n ? e->run_end[r] : start + n;
+            const char *v = (const char *)e->values + (size_t)r * size;
+            for (; i < end; i++)
+            {
+                memcpy((char *)dst + (size_t)(i - start) * size, v, size);
+            }
         }
     }
-
-    can_dataframe *res = can_alloc(df1->n_row + df2->n_row, df1->n_col, df1->cols, df1->dtypes, (void **)df1->values); // (void**) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-
-    // copy value of df2
-    int row_i = df1->n_row;
-    for (int i = 0; i < df2->n_row; i++)
+    else
     {
-        // for all column copy value
-        for (int j = 0; j < res->n_col; j++)
+        int64_t v = e->enc == CAN_ENC_DELTA ? e->block_first[start / CAN_ENC_BLOCK] : 0;
+        for (int i = 0; i < n; i++)
         {
-            if (df2->dtypes[j] == 'I')
-            {
-                int v = can_get_int(df2, i, (char *)df2->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                can_set_int(res, row_i, res->cols[j], v);
-            }
-            else if (df2->dtypes[j] == 'D')
+            uint64_t code = e->width > 0 ? can_bits_get(e->bits, (size_t)(start + i) * e->width, e->width) : 0;
+            if (e->enc == CAN_ENC_FOR)
             {
-                double v = can_get_double(df2, i, (char *)df2->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                can_set_double(res, row_i, res->cols[j], v);
+                v = (int64_t)((uint64_t)e->ref + code);
             }
-            else if (df2->dtypes[j] == 'C')
+            else if (i > 0)
             {
-                char v = can_get_char(df2, i, (char *)df2->cols[j]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                can_set_char(res, row_i, res->cols[j], v);
+                v = (int64_t)((uint64_t)v + (uint64_t)e->ref + code);
             }
+            can_value_set_int64(dst, e->dtype, i, v);
         }
-        row_i++;
     }
-
-    return res;
 }
 
-/// @brief concatenate two dataframe by col
-/// @param df1 I dataframe 1
-/// @param df2 I dataframe 2
-/// @return concatenated dataframe
-can_dataframe *can_concat_col(const can_dataframe *df1, const can_dataframe *df2)
+/// @brief compress every column of df in memory with the encoding that takes the least bytes:
+/// RLE for long runs (e.g. constant ANCHOR codes), frame of reference + bit packing for small ranges (e.g. ANT IDs),
+/// delta + bit packing for steady sequences (e.g. sorted timestamps), or plain values when nothing helps
+/// (double / float columns only take RLE or plain; validity bitmaps are copied, string dictionaries shared)
+/// @param df I dataframe
+/// @return compressed dataframe (free by can_compressed_free), independent of df
+can_compressed *can_compress(const can_dataframe *df)
 {
-    // check they have same row
-    if (df1->n_row != df2->n_row)
+    can_compressed *cf = (can_compressed *)calloc(1, sizeof(can_compressed));
+    if (cf == NULL)
     {
-        fprintf(stderr, "ERORR: can_concat_col df1->n_row = %d != df2->n_row = %d\n", df1->n_row, df2->n_row);
+        fprintf(stderr, "ERROR: can_compress cannot alloc memory\n");
         exit(EXIT_FAILURE);
     }
-
-    // check if their col add up exceed MAX_COL_NUM
-    if (df1->n_col + df2->n_col > MAX_COL_NUM)
+    cf->n_row = df->n_row;
+    cf->n_col = df->n_col;
+    cf->dtypes = (char *)can_malloc(df->n_col + 1, "can_compress");
+    memcpy(cf->dtypes, df->dtypes, df->n_col);
+    cf->dtypes[df->n_col] = '\0';
+    cf->cols = (char(*)[MAX_COL_LEN])can_malloc((size_t)MAX_COL_LEN * df->n_col, "can_compress");
+    memcpy(cf->cols, df->cols, (size_t)MAX_COL_LEN * df->n_col);
+    cf->encs = (can_enc_col *)can_malloc(sizeof(can_enc_col) * df->n_col, "can_compress");
+    cf->dicts = (can_dict **)calloc(df->n_col, sizeof(can_dict *));
+    cf->valid = (uint64_t **)calloc(df->n_col, sizeof(uint64_t *));
+    if (cf->dicts == NULL || cf->valid == NULL)
     {
-        fprintf(stderr, "ERORR: can_concat_col df1->n_col + df2->n_col = %d > MAX_COL_NUM = %d\n", df1->n_col + df2->n_col, MAX_COL_NUM);
+        fprintf(stderr, "ERROR: can_compress cannot alloc memory\n");
         exit(EXIT_FAILURE);
     }
-
-    char cols[MAX_COL_NUM][MAX_COL_LEN] = {""};
-    char dtypes[MAX_COL_NUM] = "";
-    void *values[MAX_COL_NUM] = {NULL};
-    for (int j = 0; j < df1->n_col; j++)
-    {
-        strncpy(cols[j], df1->cols[j], MAX_COL_LEN);
-        dtypes[j] = df1->dtypes[j];
-        values[j] = df1->values[j];
-    }
-    for (int j = df1->n_col; j < df1->n_col + df2->n_col; j++)
+    for (int j = 0; j < df->n_col; j++)
     {
-        strncpy(cols[j], df2->cols[j - df1->n_col], MAX_COL_LEN);
-        dtypes[j] = df2->dtypes[j - df1->n_col];
-        values[j] = df2->values[j - df1->n_col];
+        can_enc_col_build(&cf->encs[j], df, j);
+        if (df->dtypes[j] == 'S' && df->dicts[j] != NULL)
+        {
+            cf->dicts[j] = df->dicts[j];
+            cf->dicts[j]->refs++;
+        }
+        if (df->valid[j] != NULL)
+        {
+            size_t n_word = ((size_t)df->n_row + 63) / 64;
+            cf->valid[j] = (uint64_t *)can_malloc(sizeof(uint64_t) * (n_word > 0 ? n_word : 1), "can_compress");
+            memcpy(cf->valid[j], df->valid[j], sizeof(uint64_t) * n_word);
+        }
     }
-    can_dataframe *res = can_alloc(df1->n_row, df1->n_col + df2->n_col, cols, dtypes, values);
-    return res;
+    return cf;
 }
 
-/// @brief merge two dataframe, keep left dataframe unchange,
-/// (df2's key col should be unique, if not unique, first found will be matched)
-/// (should be very careful when key col is double type because of "0.1+0.2!=0.3" problem of float numbers)
-/// @param df1     I left dataframe
-/// @param df2     I right dataframe
-/// @param key_col I the key column name
-/// @return merged dataframe (deep copy)
-can_dataframe *can_merge_left(const can_dataframe *df1, const can_dataframe *df2, char key_col[MAX_COL_LEN])
+/// @brief helper function, column index of compressed dataframe by name
+/// @param cf  I compressed dataframe
+/// @param col I column name
+/// @return column index, -1 if not found
+static int can_compressed_find(const can_compressed *cf, const char *col)
 {
-    // check if their col add up exceed MAX_COL_NUM (-1 because only keep left key col)
-    if (df1->n_col + df2->n_col - 1 > MAX_COL_NUM)
+    for (int j = 0; j < cf->n_col; j++)
     {
-        fprintf(stderr, "ERORR: can_merge_left df1->n_col + df2->n_col - 1 = %d > MAX_COL_NUM = %d\n", df1->n_col + df2->n_col, MAX_COL_NUM);
-        exit(EXIT_FAILURE);
+        if (strncmp(cf->cols[j], col, MAX_COL_LEN) == 0)
+        {
+            return j;
+        }
     }
+    return -1;
+}
 
-    // check they both have key col
-    int found_col1 = -1;
-    for (int j = 0; j < df1->n_col; j++)
+/// @brief helper function, new dataframe of rows of cf set in mask, only blocks holding such rows are decoded
+/// @param cf   I compressed dataframe
+/// @param mask I row bit mask, bits past n_row cleared
+/// @return dataframe
+static can_dataframe *can_compressed_take(const can_compressed *cf, const uint64_t *mask)
+{
+    int n_row = can_mask_count(mask, cf->n_row);
+    can_dataframe *res = can_alloc(n_row, cf->n_col, cf->cols, cf->dtypes, NULL);
+    int64_t buf[CAN_ENC_BLOCK];
+    for (int j = 0; j < cf->n_col; j++)
     {
-        if (strcmp(key_col, df1->cols[j]) == 0)
+        const can_enc_col *e = &cf->encs[j];
+        size_t size = can_dtype_size(e->dtype);
+        if (e->dtype == 'S')
         {
-            found_col1 = j;
-            break;
+            can_set_col_dict(res, j, cf->dicts[j]);
         }
-    }
-    if (found_col1 == -1)
-    {
-        fprintf(stderr, "ERORR: can_merge_left df1 do not have key_col %s\n", key_col);
-        exit(EXIT_FAILURE);
-    }
-    int found_col2 = -1;
-    for (int j = 0; j < df2->n_col; j++)
-    {
-        if (strcmp(key_col, df2->cols[j]) == 0)
+        if (e->enc == CAN_ENC_PLAIN)
         {
-            found_col2 = j;
-            break;
+            can_compact_col(res->values[j], e->values, e->dtype, mask, cf->n_row);
+        }
+        else
+        {
+            char *dst = (char *)res->values[j];
+            for (int start = 0; start < cf->n_row; start += CAN_ENC_BLOCK)
+            {
+                int n = cf->n_row - start < CAN_ENC_BLOCK ? cf->n_row - start : CAN_ENC_BLOCK;
+                int k = can_mask_count(mask + start / 64, n);
+                if (k > 0)
+                {
+                    can_enc_decode(e, start, n, buf);
+                    can_compact_col(dst, buf, e->dtype, mask + start / 64, n);
+                    dst += (size_t)k * size;
+                }
+            }
         }
+        can_valid_compact(res, j, cf->valid[j], cf->n_row, mask);
     }
-    if (found_col2 == -1)
+    return res;
+}
+
+/// @brief decompress every column back to a plain dataframe
+/// @param cf I compressed dataframe
+/// @return dataframe
+can_dataframe *can_decompress(const can_compressed *cf)
+{
+    uint64_t *mask = can_mask_alloc(cf->n_row, "can_decompress");
+    memset(mask, 0xff, sizeof(uint64_t) * ((cf->n_row + 63) / 64));
+    if (cf->n_row & 63)
     {
-        fprintf(stderr, "ERORR: can_merge_left df1 have key_col %s, but df2 do not have key_col\n", key_col);
-        exit(EXIT_FAILURE);
+        mask[cf->n_row / 64] = ((uint64_t)1 << (cf->n_row & 63)) - 1;
     }
+    can_dataframe *res = can_compressed_take(cf, mask);
+    free(mask);
+    return res;
+}
 
-    // check if their key col are of same type
-    if (df1->dtypes[found_col1] != df2->dtypes[found_col2])
+/// @brief encoding of a column of compressed dataframe
+/// @param cf  I compressed dataframe
+/// @param col I column name
+/// @return CAN_ENC_PLAIN / CAN_ENC_RLE / CAN_ENC_FOR / CAN_ENC_DELTA
+int can_compressed_encoding(const can_compressed *cf, char col[MAX_COL_LEN])
+{
+    int j = can_compressed_find(cf, col);
+    if (j == -1)
     {
-        fprintf(stderr, "ERORR: can_merge_left df1, df2 have same key col but different type %c, %c\n", df1->dtypes[found_col1], df2->dtypes[found_col2]);
+        fprintf(stderr, "ERROR: can_compressed_encoding cannot found col=%s\n", col);
         exit(EXIT_FAILURE);
     }
+    return cf->encs[j].enc;
+}
+
+/// @brief memory held by encoded values and validity bitmaps of compressed dataframe
+/// (string dictionaries are shared and not counted)
+/// @param cf I compressed dataframe
+/// @return bytes
+size_t can_compressed_bytes(const can_compressed *cf)
+{
+    size_t bytes = 0;
+    for (int j = 0; j < cf->n_col; j++)
+    {
+        bytes += cf->encs[j].bytes;
+        bytes += cf->valid[j] != NULL ? sizeof(uint64_t) * (((size_t)cf->n_row + 63) / 64) : 0;
+    }
+    return bytes;
+}
 
-    char cols[MAX_COL_NUM][MAX_COL_LEN] = {""};
-    char dtypes[MAX_COL_NUM] = "";
-    void *values[MAX_COL_NUM] = {NULL};
-    for (int j = 0; j < df1->n_col; j++)
+/// @brief helper function, set rows [a, b) of mask
+/// @param mask IO row bit mask
+/// @param a    I  first row
+/// @param b    I  end row (exclusive)
+static void can_mask_set_range(uint64_t *mask, int a, int b)
+{
+    for (; a < b && (a & 63) != 0; a++)
     {
-        strncpy(cols[j], df1->cols[j], MAX_COL_LEN);
-        dtypes[j] = df1->dtypes[j];
-        values[j] = df1->values[j];
+        mask[a >> 6] |= (uint64_t)1 << (a & 63);
     }
-    int col_i = df1->n_col;
-    for (int j = df1->n_col; j < df1->n_col + df2->n_col; j++)
+    for (; a + 64 <= b; a += 64)
+    {
+        mask[a >> 6] = UINT64_MAX;
+    }
+    for (; a < b; a++)
+    {
+        mask[a >> 6] |= (uint64_t)1 << (a & 63);
+    }
+}
+
+/// @brief helper function for can_compressed_filter, range / in leaf on column j into mask:
+/// RLE tests every run once, FOR / DELTA skip or take whole blocks by block min / max
+/// and FOR compares packed values without decoding, null rows never match
+/// @param cf   I compressed dataframe
+/// @param j    I column index
+/// @param p    I CAN_PRED_RANGE / CAN_PRED_IN predicate (string values already turned into codes)
+/// @param mask O (cf->n_row + 63) / 64 words
+static void can_enc_mask_leaf(const can_compressed *cf, int j, const can_pred *p, uint64_t *mask)
+{
+    const can_enc_col *e = &cf->encs[j];
+    int n = cf->n_row;
+    memset(mask, 0, sizeof(uint64_t) * ((n + 63) / 64));
+    if (e->enc == CAN_ENC_PLAIN)
     {
-        if (strcmp(key_col, df2->cols[j - df1->n_col]) == 0)
+        if (p->op == CAN_PRED_RANGE)
         {
-            continue;
+            can_mask_range_values(e->values, e->dtype, n, p->min, p->max, mask);
+        }
+        else
+        {
+            can_mask_in(e->values, e->dtype, n, p, mask);
         }
-        strncpy(cols[col_i], df2->cols[j - df1->n_col], MAX_COL_LEN);
-        dtypes[col_i] = df2->dtypes[j - df1->n_col];
-        values[col_i] = df2->values[j - df1->n_col]; // invalid values, just placeholder
-        col_i++;
     }
-    can_dataframe *res = can_alloc(df1->n_row, df1->n_col + df2->n_col - 1, cols, dtypes, values);
-
-    // match key col and fill value
-    for (int i1 = 0; i1 < df1->n_row; i1++)
+    else if (e->enc == CAN_ENC_RLE)
     {
-        char key_col_dtype = df1->dtypes[found_col1];
-        if (key_col_dtype == 'I')
+        uint64_t *run_mask = can_mask_alloc(e->n_run, "can_compressed_filter");
+        if (p->op == CAN_PRED_RANGE)
         {
-            int v1 = can_get_int(df1, i1, key_col);
-            for (int i2 = 0; i2 < df2->n_row; i2++)
-            {
-                int v2 = can_get_int(df2, i2, key_col);
-                if (v1 == v2) // matched
-                {
-                    // for every col in df2 except key col (found_col2)
-                    for (int j2 = 0; j2 < df2->n_col; j2++)
-                    {
-                        if (j2 == found_col2)
-                        {
-                            continue;
-                        }
-                        if (df2->dtypes[j2] == 'I')
-                        {
-                            int v = can_get_int(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_int(res, i1, (char *)df2->cols[j2], v);
-                        }
-                        else if (df2->dtypes[j2] == 'D')
-                        {
-                            double v = can_get_double(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_double(res, i1, (char *)df2->cols[j2], v);
-                        }
-                        else if (df2->dtypes[j2] == 'C')
-                        {
-                            char v = can_get_char(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_char(res, i1, (char *)df2->cols[j2], v);
-                        }
-                    }
-                }
-            }
+            can_mask_range_values(e->values, e->dtype, e->n_run, p->min, p->max, run_mask);
         }
-
-        else if (key_col_dtype == 'D')
+        else
+        {
+            can_mask_in(e->values, e->dtype, e->n_run, p, run_mask);
+        }
+        for (int w = 0; w < (e->n_run + 63) / 64; w++)
         {
-            double v1 = can_get_double(df1, i1, key_col);
-            for (int i2 = 0; i2 < df2->n_row; i2++)
+            for (uint64_t m = run_mask[w]; m != 0; m &= m - 1)
             {
-                double v2 = can_get_double(df2, i2, key_col);
-                if (v1 == v2) // matched
-                {
-                    // for every col in df2 except key col (found_col2)
-                    for (int j2 = 0; j2 < df2->n_col; j2++)
-                    {
-                        if (j2 == found_col2)
-                        {
-                            continue;
-                        }
-                        if (df2->dtypes[j2] == 'I')
-                        {
-                            int v = can_get_int(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_int(res, i1, (char *)df2->cols[j2], v);
-                        }
-                        else if (df2->dtypes[j2] == 'D')
-                        {
-                            double v = can_get_double(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_double(res, i1, (char *)df2->cols[j2], v);
-                        }
-                        else if (df2->dtypes[j2] == 'C')
-                        {
-                            char v = can_get_char(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_char(res, i1, (char *)df2->cols[j2], v);
-                        }
-                    }
-                }
+                int r = w * 64 + can_ctz64(m);
+                can_mask_set_range(mask, r > 0 ? e->run_end[r - 1] : 0, e->run_end[r]);
             }
         }
-
-        else if (key_col_dtype == 'C')
+        free(run_mask);
+    }
+    else
+    {
+        int64_t tmin, tmax, lo = 0, hi = 0;
+        can_int_limits(e->dtype, &tmin, &tmax);
+        if (p->op == CAN_PRED_RANGE && !can_int_range(p->min, p->max, tmin, tmax, &lo, &hi))
+        {
+            return;
+        }
+        int64_t buf[CAN_ENC_BLOCK];
+        for (int start = 0; start < n; start += CAN_ENC_BLOCK)
         {
-            char v1 = can_get_char(df1, i1, key_col);
-            for (int i2 = 0; i2 < df2->n_row; i2++)
+            int b = start / CAN_ENC_BLOCK;
+            int m = n - start < CAN_ENC_BLOCK ? n - start : CAN_ENC_BLOCK;
+            uint64_t *block_mask = mask + start / 64;
+            if (p->op == CAN_PRED_RANGE)
             {
-                char v2 = can_get_char(df2, i2, key_col);
-                if (v1 == v2) // matched
+                if (e->block_max[b] < lo || e->block_min[b] > hi)
+                {
+                    continue;
+                }
+                else if (e->block_min[b] >= lo && e->block_max[b] <= hi)
+                {
+                    can_mask_set_range(mask, start, start + m);
+                    continue;
+                }
+                else if (e->enc == CAN_ENC_FOR)
                 {
-                    // for every col in df2 except key col (found_col2)
-                    for (int j2 = 0; j2 < df2->n_col; j2++)
+                    // bounds moved to packed values (ref <= block min <= hi)
+                    uint64_t c_lo = lo > e->ref ? (uint64_t)lo - (uint64_t)e->ref : 0;
+                    uint64_t c_hi = (uint64_t)hi - (uint64_t)e->ref;
+                    for (int i = 0; i < m; i++)
                     {
-                        if (j2 == found_col2)
-                        {
-                            continue;
-                        }
-                        if (df2->dtypes[j2] == 'I')
-                        {
-                            int v = can_get_int(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_int(res, i1, (char *)df2->cols[j2], v);
-                        }
-                        else if (df2->dtypes[j2] == 'D')
-                        {
-                            double v = can_get_double(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_double(res, i1, (char *)df2->cols[j2], v);
-                        }
-                        else if (df2->dtypes[j2] == 'C')
-                        {
-                            char v = can_get_char(df2, i2, (char *)df2->cols[j2]); // (char*) here do nothing but prevent [-Wdiscarded-qualifiers] warning
-                            can_set_char(res, i1, (char *)df2->cols[j2], v);
-                        }
+                        uint64_t c = can_bits_get(e->bits, (size_t)(start + i) * e->width, e->width);
+                        block_mask[i >> 6] |= (uint64_t)(c >= c_lo && c <= c_hi) << (i & 63);
                     }
+                    continue;
                 }
             }
+            can_enc_decode(e, start, m, buf);
+            if (p->op == CAN_PRED_RANGE)
+            {
+                can_mask_range_values(buf, e->dtype, m, p->min, p->max, block_mask);
+            }
+            else
+            {
+                can_mask_in(buf, e->dtype, m, p, block_mask);
+            }
+        }
+    }
+    if (cf->valid[j] != NULL)
+    {
+        for (int w = 0; w < (n + 63) / 64; w++)
+        {
+            mask[w] &= cf->valid[j][w];
         }
     }
-
-    return res;
 }
 
-/// @brief helper function for can_sort
-/// @param a
-/// @param b
-/// @return
-static int can_compare_int(const void *a, const void *b)
+/// @brief helper function for can_compressed_filter, evaluate predicate on all rows of cf into mask
+/// @param cf   I compressed dataframe (columns checked)
+/// @param p    I predicate
+/// @param mask O (cf->n_row + 63) / 64 words, bits past n_row cleared
+static void can_enc_mask(const can_compressed *cf, const can_pred *p, uint64_t *mask)
 {
-    return (*(int *)a - *(int *)b);
-}
-/// @brief helper function for can_sort
-/// @param a
-/// @param b
-/// @return
-static int can_compare_double(const void *a, const void *b)
-{
-    double diff = (*(double *)a - *(double *)b);
-    if (diff == 0.0)
+    int n = cf->n_row;
+    int n_word = (n + 63) / 64;
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR)
     {
-        return 0;
+        can_enc_mask(cf, p->a, mask);
+        uint64_t *other = can_mask_alloc(n, "can_compressed_filter");
+        can_enc_mask(cf, p->b, other);
+        for (int w = 0; w < n_word; w++)
+        {
+            mask[w] = p->op == CAN_PRED_AND ? mask[w] & other[w] : mask[w] | other[w];
+        }
+        free(other);
+        return;
+    }
+    else if (p->op == CAN_PRED_NOT)
+    {
+        can_enc_mask(cf, p->a, mask);
+        for (int w = 0; w < n_word; w++)
+        {
+            mask[w] = ~mask[w];
+        }
+        if (n & 63)
+        {
+            mask[n_word - 1] &= ((uint64_t)1 << (n & 63)) - 1;
+        }
+        return;
+    }
+
+    int j = can_compressed_find(cf, p->col);
+    if (p->op == CAN_PRED_NULL)
+    {
+        for (int w = 0; w < n_word; w++)
+        {
+            mask[w] = cf->valid[j] != NULL ? ~can_valid_word(cf->valid[j], w, n) : 0;
+        }
+        if (n & 63)
+        {
+            mask[n_word - 1] &= ((uint64_t)1 << (n & 63)) - 1;
+        }
+    }
+    else if (p->dtype == 'S')
+    {
+        // strings to codes of the column dictionary, then an int set
+        can_pred q = *p;
+        q.dtype = 'I';
+        q.set = can_malloc(sizeof(int) * (p->n_set > 0 ? p->n_set : 1), "can_compressed_filter");
+        q.n_set = can_pred_str_codes(cf->dicts[j], p, (int *)q.set);
+        can_enc_mask_leaf(cf, j, &q, mask);
+        free(q.set);
     }
     else
     {
-        return diff > 0.0 ? 1 : -1;
+        can_enc_mask_leaf(cf, j, p, mask);
     }
 }
-/// @brief helper function for can_sort
-/// @param a
-/// @param b
-/// @return
-static int can_compare_char(const void *a, const void *b)
-{
-    return (*(char *)a - *(char *)b);
-}
 
-/// @brief sort dataframe in ascending order
-/// @param df      I dataframe
-/// @param key_col I key column name
-/// @return sorted dataframe
-can_dataframe *can_sort(const can_dataframe *df, char key_col[MAX_COL_LEN])
+/// @brief helper function, check that every column of predicate exists in cf with the right data type
+/// @param cf I compressed dataframe
+/// @param p  I predicate
+static void can_compressed_check_pred(const can_compressed *cf, const can_pred *p)
 {
-    int found_col = -1;
-    for (int j = 0; j < df->n_col; j++)
+    if (p->op == CAN_PRED_AND || p->op == CAN_PRED_OR || p->op == CAN_PRED_NOT)
     {
-        if (strcmp(key_col, df->cols[j]) == 0)
+        can_compressed_check_pred(cf, p->a);
+        if (p->b != NULL)
         {
-            found_col = j;
-            break;
+            can_compressed_check_pred(cf, p->b);
         }
+        return;
     }
-    if (found_col == -1)
+    int j = can_compressed_find(cf, p->col);
+    if (j == -1)
+    {
+        fprintf(stderr, "ERROR: can_compressed_filter cannot found col=%s\n", p->col);
+        exit(EXIT_FAILURE);
+    }
+    else if (p->op != CAN_PRED_NULL && !can_dtype_accepts(cf->dtypes[j], p->dtype))
     {
-        fprintf(stderr, "ERROR: can_sort df do not have key col %s\n", key_col);
+        fprintf(stderr, "ERROR: can_compressed_filter found col=%s but it is not %c type\n", p->col, p->dtype);
         exit(EXIT_FAILURE);
     }
+}
 
-    // make same structure without data
-    can_dataframe *res = can_alloc(df->n_row, df->n_col, df->cols, df->dtypes, NULL);
-    // find the sorted order
-    int *order = malloc(sizeof(int) * df->n_row);
+/// @brief filter rows of compressed dataframe that satisfy a compound predicate (same semantics as can_filter),
+/// predicate is evaluated on encoded values and only blocks holding matching rows are decoded
+/// @param cf I compressed dataframe
+/// @param p  I predicate built by can_pred_* (not freed)
+/// @return filtered dataframe (plain)
+can_dataframe *can_compressed_filter(const can_compressed *cf, const can_pred *p)
+{
+    can_compressed_check_pred(cf, p);
+    uint64_t *mask = can_mask_alloc(cf->n_row, "can_compressed_filter");
+    can_enc_mask(cf, p, mask);
+    can_dataframe *res = can_compressed_take(cf, mask);
+    free(mask);
+    return res;
+}
 
-    char key_col_type = df->dtypes[found_col];
-    if (key_col_type == 'I')
+/// @brief aggregate a whole column of compressed dataframe, null values skipped:
+/// RLE adds value * run length, FOR sums packed values, FOR / DELTA min / max come from block min / max,
+/// other cases decode one block at a time
+/// @param cf  I compressed dataframe
+/// @param col I column name
+/// @param op  I CAN_AGG_SUM / CAN_AGG_MEAN / CAN_AGG_COUNT / CAN_AGG_MIN / CAN_AGG_MAX (string column only count)
+/// @return result as double, MISS_DOUBLE for mean / min / max of no value, NaN for min / max if any value is NaN
+double can_compressed_agg(const can_compressed *cf, char col[MAX_COL_LEN], int op)
+{
+    int j = can_compressed_find(cf, col);
+    if (j == -1)
+    {
+        fprintf(stderr, "ERROR: can_compressed_agg cannot found col=%s\n", col);
+        exit(EXIT_FAILURE);
+    }
+    else if (op != CAN_AGG_SUM && op != CAN_AGG_MEAN && op != CAN_AGG_COUNT && op != CAN_AGG_MIN && op != CAN_AGG_MAX)
+    {
+        fprintf(stderr, "ERROR: can_compressed_agg invalid op = %d\n", op);
+        exit(EXIT_FAILURE);
+    }
+    else if (cf->dtypes[j] == 'S' && op != CAN_AGG_COUNT)
     {
-        // make a copy of key col, and sort it by qsort
-        int *vp = malloc(sizeof(int) * df->n_row);
-        int order_i = 0;
-        memcpy(vp, can_get_int_pointer((can_dataframe *)df, key_col), sizeof(int) * df->n_row);
-        qsort(vp, df->n_row, sizeof(int), can_compare_int);
+        fprintf(stderr, "ERROR: can_compressed_agg string col=%s can only be counted\n", col);
+        exit(EXIT_FAILURE);
+    }
 
-        // use the sorted copy as reference to get sorted order
-        for (int i = 0; i < res->n_row; i++)
+    const can_enc_col *e = &cf->encs[j];
+    const uint64_t *valid = cf->valid[j];
+    int n = cf->n_row;
+    int is_int = can_enc_is_int(e->dtype);
+    int count = 0;
+    double sum = 0.0, d_min = 0.0, d_max = 0.0;
+    int64_t i_min = 0, i_max = 0;
+    if (op == CAN_AGG_COUNT)
+    {
+        if (valid == NULL)
         {
-            int v = vp[i];
-            // for each row in df, search equal value
-            for (int row_i = 0; row_i < df->n_row; row_i++)
-            {
-                // if multiple rows have same value on key col, make sure they won't repeat (each row can only appear once)
-                if (v == can_get_int(df, row_i, key_col))
-                {
-                    int found = 0;
-                    for (int k = 0; k < order_i; k++)
-                    {
-                        if (row_i == order[k])
-                        {
-                            found = 1;
-                            break;
-                        }
-                    }
-                    // if not in order list, add it
-                    if (found == 0)
-                    {
-                        order[order_i] = row_i;
-                        order_i++;
-                    }
-                }
-            }
+            return n;
+        }
+        for (int w = 0; w < (n + 63) / 64; w++)
+        {
+            count += can_popcount64(can_valid_word(valid, w, n));
         }
-        free(vp);
+        return count;
     }
-    else if (key_col_type == 'D')
+    else if (e->enc == CAN_ENC_RLE)
     {
-        // make a copy of key col, and sort it by qsort
-        double *vp = malloc(sizeof(double) * df->n_row);
-        int order_i = 0;
-        memcpy(vp, can_get_double_pointer((can_dataframe *)df, key_col), sizeof(double) * df->n_row);
-        qsort(vp, df->n_row, sizeof(double), can_compare_double);
-
-        // use the sorted copy as reference to get sorted order
-        for (int i = 0; i < res->n_row; i++)
+        // one step per run, valid rows of a run counted 64 at a time
+        for (int r = 0; r < e->n_run; r++)
         {
-            double v = vp[i];
-            // for each row in df, search equal value
-            for (int row_i = 0; row_i < df->n_row; row_i++)
+            int a = r > 0 ? e->run_end[r - 1] : 0, c = e->run_end[r] - a;
+            if (valid != NULL)
             {
-                // if multiple rows have same value on key col, make sure they won't repeat (each row can only appear once)
-                if (v == can_get_double(df, row_i, key_col))
+                c = 0;
+                for (int i = a; i < e->run_end[r]; i += 64)
                 {
-                    int found = 0;
-                    for (int k = 0; k < order_i; k++)
-                    {
-                        if (row_i == order[k])
-                        {
-                            found = 1;
-                            break;
-                        }
-                    }
-                    // if not in order list, add it
-                    if (found == 0)
-                    {
-                        order[order_i] = row_i;
-                        order_i++;
-                    }
+                    int k = e->run_end[r] - i < 64 ? e->run_end[r] - i : 64;
+                    c += can_popcount64(can_bits_get(valid, i, k));
                 }
             }
+            if (c == 0)
+            {
+                continue;
+            }
+            double x = can_value_as_double(e->values, e->dtype, r);
+            int64_t y = is_int ? can_value_as_int64(e->values, e->dtype, r) : 0;
+            sum += x * c;
+            d_min = count == 0 || x != x || x < d_min ? x : d_min; // NaN propagates
+            d_max = count == 0 || x != x || x > d_max ? x : d_max;
+            i_min = count == 0 || y < i_min ? y : i_min;
+            i_max = count == 0 || y > i_max ? y : i_max;
+            count += c;
         }
-        free(vp);
     }
-    else if (key_col_type == 'D')
+    else if (valid == NULL && (e->enc == CAN_ENC_FOR || e->enc == CAN_ENC_DELTA) && (op == CAN_AGG_MIN || op == CAN_AGG_MAX))
     {
-        // make a copy of key col, and sort it by qsort
-        char *vp = malloc(sizeof(char) * df->n_row);
-        int order_i = 0;
-        memcpy(vp, can_get_char_pointer((can_dataframe *)df, key_col), sizeof(char) * df->n_row);
-        qsort(vp, df->n_row, sizeof(char), can_compare_char);
-
-        // use the sorted copy as reference to get sorted order
-        for (int i = 0; i < res->n_row; i++)
+        for (int b = 0; b < (n + CAN_ENC_BLOCK - 1) / CAN_ENC_BLOCK; b++)
         {
-            char v = vp[i];
-            // for each row in df, search equal value
-            for (int row_i = 0; row_i < df->n_row; row_i++)
-            {
-                // if multiple rows have same value on key col, make sure they won't repeat (each row can only appear once)
-                if (v == can_get_char(df, row_i, key_col))
-                {
-                    int found = 0;
-                    for (int k = 0; k < order_i; k++)
-                    {
-                        if (row_i == order[k])
-                        {
-                            found = 1;
-                            break;
-                        }
-                    }
-                    // if not in order list, add it
-                    if (found == 0)
-                    {
-                        order[order_i] = row_i;
-                        order_i++;
-                    }
-                }
-            }
+            i_min = b == 0 || e->block_min[b] < i_min ? e->block_min[b] : i_min;
+            i_max = b == 0 || e->block_max[b] > i_max ? e->block_max[b] : i_max;
         }
-        free(vp);
+        count = n;
     }
-
-    // now set the value of res, according to the sorted order
-    for(int i = 0;i<res->n_row;i++)
+    else if (valid == NULL && e->enc == CAN_ENC_FOR && e->width <= 52)
     {
-        for(int j=0;j<res->n_col;j++)
+        // sum of packed values of a block fits in 64 bits, reference added once per block
+        for (int start = 0; start < n; start += CAN_ENC_BLOCK)
         {
-            char col_type = res->dtypes[j];
-            if(col_type=='I')
+            int m = n - start < CAN_ENC_BLOCK ? n - start : CAN_ENC_BLOCK;
+            uint64_t s = 0;
+            for (int i = 0; e->width > 0 && i < m; i++)
             {
-                can_set_int(res, i, res->cols[j], can_get_int(df, order[i], res->cols[j]));
+                s += can_bits_get(e->bits, (size_t)(start + i) * e->width, e->width);
             }
-            else if(col_type=='D')
+            sum += (double)s + (double)e->ref * m;
+        }
+        count = n;
+    }
+    else
+    {
+        int64_t buf[CAN_ENC_BLOCK];
+        size_t size = can_dtype_size(e->dtype);
+        for (int start = 0; start < n; start += CAN_ENC_BLOCK)
+        {
+            int m = n - start < CAN_ENC_BLOCK ? n - start : CAN_ENC_BLOCK;
+            const void *vs = (const char *)e->values + (size_t)start * size;
+            if (e->enc != CAN_ENC_PLAIN)
             {
-                can_set_double(res, i, res->cols[j], can_get_double(df, order[i], res->cols[j]));
+                can_enc_decode(e, start, m, buf);
+                vs = buf;
             }
-            else if(col_type=='C')
+            for (int w = 0; w < (m + 63) / 64; w++)
             {
-                can_set_char(res, i, res->cols[j], can_get_char(df, order[i], res->cols[j]));
+                uint64_t bits = valid != NULL ? can_valid_word(valid + start / 64, w, m) : (w == m / 64 && (m & 63) ? ((uint64_t)1 << (m & 63)) - 1 : UINT64_MAX);
+                for (; bits != 0; bits &= bits - 1)
+                {
+                    int i = w * 64 + can_ctz64(bits);
+                    double x = can_value_as_double(vs, e->dtype, i);
+                    int64_t y = is_int ? can_value_as_int64(vs, e->dtype, i) : 0;
+                    sum += x;
+                    d_min = count == 0 || x != x || x < d_min ? x : d_min; // NaN propagates
+                    d_max = count == 0 || x != x || x > d_max ? x : d_max;
+                    i_min = count == 0 || y < i_min ? y : i_min;
+                    i_max = count == 0 || y > i_max ? y : i_max;
+                    count++;
+                }
             }
         }
     }
 
-    free(order);
-    return res;
+    if (op == CAN_AGG_SUM)
+    {
+        return sum;
+    }
+    else if (count == 0)
+    {
+        return MISS_DOUBLE;
+    }
+    else if (op == CAN_AGG_MEAN)
+    {
+        return sum / count;
+    }
+    else if (op == CAN_AGG_MIN)
+    {
+        return is_int ? (double)i_min : d_min;
+    }
+    return is_int ? (double)i_max : d_max;
+}
+
+/// @brief free compressed dataframe
+/// @param cf IO compressed dataframe
+void can_compressed_free(can_compressed *cf)
+{
+    if (cf == NULL)
+    {
+        return;
+    }
+    for (int j = 0; j < cf->n_col; j++)
+    {
+        can_enc_col *e = &cf->encs[j];
+        free(e->values);
+        free(e->run_end);
+        free(e->bits);
+        free(e->block_min);
+        free(e->block_max);
+        free(e->block_first);
+        can_dict_release(cf->dicts[j]);
+        free(cf->valid[j]);
+    }
+    free(cf->encs);
+    free(cf->dicts);
+    free(cf->valid);
+    free(cf->cols);
+    free(cf->dtypes);
+    free(cf);
 }
 
 #endif
\ No newline at end of file
@@ -32,6 +32,103 @@ void test_read_and_write_csv()
     can_free(df);
 }
 
+void test_write_csv_buffered()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+
+    // shortest round trip doubles, no banner line, so it can be read back directly
+    can_write_csv_buffered("../test_data/test1_copy", df, ",", -1, 0);
+    can_dataframe *df_back = can_read_csv("../test_data/test1_copy", 6, cols, "CDDDII", ",", 1);
+    can_print(df_back, 4);
+
+    can_free(df);
+    can_free(df_back);
+}
+
+void test_binary()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_save_binary("../test_data/test1.bin", df);
+
+    // zero copy, columns point into the file mapping
+    can_dataframe *df_bin = can_load_binary("../test_data/test1.bin");
+    can_print(df_bin, 4);
+
+    can_free(df);
+    can_free(df_bin);
+}
+
+void test_read_csv_mmap()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv_mmap("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_print(df, 4);
+
+    // 0 threads means use all processors
+    can_dataframe *df_par = can_read_csv_parallel("../test_data/test1", 6, cols, "CDDDII", " ", 1, 0);
+    can_print(df_par, 4);
+
+
+    // a file of many chunks with strings and nulls, every chunk has its own dictionary order
+    FILE *fp = fopen("../test_data/test_parallel", "w");
+    fprintf(fp, "SITE ANT1 N\n");
+    const char *sites[4] = {"roof", "gate", "lake", "hill"};
+    for (int i = 0; i < 40000; i++)
+    {
+        fprintf(fp, "%s ", i % 17 == 0 ? CAN_NULL_TOKEN : sites[(i / 100 + i / 10000) % (1 + i / 10000)]);
+        i % 13 == 0 ? fprintf(fp, "%s ", CAN_NULL_TOKEN) : fprintf(fp, "%d ", 19000 + i % 500);
+        fprintf(fp, "%.3f\n", i * 0.001);
+    }
+    fclose(fp);
+    const char par_cols[MAX_COL_NUM][MAX_COL_LEN] = {"SITE", "ANT1", "N"};
+    can_dataframe *df_big = can_read_csv_mmap("../test_data/test_parallel", 3, par_cols, "SID", " ", 1);
+    can_dataframe *df_big_par = can_read_csv_parallel("../test_data/test_parallel", 3, par_cols, "SID", " ", 1, 4);
+    int n_diff = 0;
+    for (int i = 0; i < df_big->n_row && df_big->n_row == df_big_par->n_row; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            n_diff += can_is_null(df_big, i, (char *)par_cols[j]) != can_is_null(df_big_par, i, (char *)par_cols[j]);
+        }
+        n_diff += !can_is_null(df_big, i, "SITE") && strcmp(can_get_str(df_big, i, "SITE"), can_get_str(df_big_par, i, "SITE")) != 0;
+        n_diff += can_get_int(df_big, i, "ANT1") != can_get_int(df_big_par, i, "ANT1");
+        n_diff += can_get_double(df_big, i, "N") != can_get_double(df_big_par, i, "N");
+    }
+    printf("parallel read of %d rows (mmap read %d rows) differs in %d values\n", df_big_par->n_row, df_big->n_row, n_diff);
+    remove("../test_data/test_parallel");
+
+    can_free(df);
+    can_free(df_par);
+    can_free(df_big);
+    can_free(df_big_par);
+}
+
+void test_csv_reader()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_csv_reader *rd = can_csv_reader_open("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+
+    // mean of E over the whole file, 3 rows in memory at a time
+    double sum_e = 0;
+    int n = 0;
+    can_dataframe *batch = NULL;
+    while ((batch = can_csv_reader_next_batch(rd, 3, batch)) != NULL)
+    {
+        can_print(batch, batch->n_row);
+        double *e = can_get_double_pointer(batch, "E");
+        for (int i = 0; i < batch->n_row; i++)
+        {
+            sum_e += e[i];
+        }
+        n += batch->n_row;
+    }
+    printf("mean of E is %lf\n", sum_e / n);
+
+    can_csv_reader_close(rd);
+}
+
 void test_get_and_set()
 {
     const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
@@ -50,6 +147,14 @@ void test_get_and_set()
     can_set_double(df, 3, "N", 1e-10);
     can_print(df, 4);
 
+    // resolve column once, then access without name lookup
+    can_col_handle ant2 = can_get_col_handle(df, "ANT2");
+    for (int i = 0; i < df->n_row; i++)
+    {
+        can_hset_int(df, ant2, i, can_hget_int(df, ant2, i) + 1);
+    }
+    can_print(df, 4);
+
     can_free(df);
 }
 
@@ -109,6 +214,51 @@ void test_filter()
     can_free(anchor_A_to_C);
 }
 
+void test_filter_pred()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+
+    // E > 0 AND 19000 <= ANT1 <= 40000 AND ANCHOR != 'D', one pass and one copy
+    can_pred *pred = can_pred_and(can_pred_range_double("E", 0, 10000),
+                                  can_pred_and(can_pred_range_int("ANT1", 19000, 40000), can_pred_ne_char("ANCHOR", 'D')));
+    can_dataframe *res = can_filter(df, pred);
+    can_print(res, 1);
+
+    // ANT2 in set OR NOT N <= 0
+    const int ant2_set[2] = {36611, 38415};
+    can_pred *pred2 = can_pred_or(can_pred_in_int("ANT2", 2, ant2_set), can_pred_not(can_pred_range_double("N", -10000, 0)));
+    can_dataframe *res2 = can_filter(df, pred2);
+    can_print(res2, 3);
+
+    can_pred_free(pred);
+    can_pred_free(pred2);
+    can_free(res);
+    can_free(res2);
+    can_free(df);
+}
+
+void test_view()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_print(df, 4);
+
+    // chained filters only refine the selected rows, nothing is copied
+    can_view *v = can_view_of(df);
+    can_view_filter_double(v, "E", 0, 10000);
+    can_view_filter_int(v, "ANT1", 20000, 99999);
+
+    // copy only the needed columns
+    char sel_cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "ANT1"};
+    can_dataframe *res = can_view_materialize(v, 2, sel_cols);
+    can_print(res, res->n_row);
+
+    can_view_free(v);
+    can_free(res);
+    can_free(df);
+}
+
 void test_concat()
 {
     const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
@@ -123,9 +273,26 @@ void test_concat()
     can_dataframe *df4 = can_concat_col(df3, df3);
     can_print(df4, 8);
 
+    // many frames at once, one allocation and one memcpy per column segment
+    can_dataframe *frames[4] = {df1, df2, df3, df1};
+    can_dataframe *df5 = can_concat_rows_n(4, frames);
+    can_dataframe *df6 = can_concat_rows_n_parallel(4, frames, 2);
+    can_print(df5, 2);
+    can_print(df6, 2);
+
+    // any number of columns, schema grows with the frame
+    can_dataframe *df7 = can_concat_col(df4, df4);
+    can_dataframe *df8 = can_concat_col(df7, df7);
+    printf("n_col = %d\n", df8->n_col);
+
     can_free(df1);
     can_free(df2);
     can_free(df3);
+    can_free(df4);
+    can_free(df5);
+    can_free(df6);
+    can_free(df7);
+    can_free(df8);
 }
 
 void test_merge()
@@ -158,6 +325,406 @@ void test_sort()
     can_dataframe *df2 = can_sort(df1, "N");
     can_print(df2, 4);
 
+    int *order = can_argsort(df1, "ANT1");
+    printf("sorted order by ANT1: %d %d %d %d\n", order[0], order[1], order[2], order[3]);
+
+    free(order);
+    can_free(df1);
+    can_free(df2);
+}
+
+void test_sort_by()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df1 = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_print(df1, 4);
+
+    // sort by U, then ANT1 descending for same U
+    char keys[MAX_COL_NUM][MAX_COL_LEN] = {"U", "ANT1"};
+    int ascending[2] = {1, 0};
+    can_dataframe *df2 = can_sort_by(df1, 2, keys, ascending);
+    can_print(df2, 4);
+
+    can_free(df1);
+    can_free(df2);
+}
+
+void test_groupby()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df1 = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_dataframe *df2 = can_concat_row(df1, df1);
+
+    char keys[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR"};
+    can_agg_spec specs[4] = {
+        {CAN_AGG_MEAN, "E", ""},
+        {CAN_AGG_MAX, "ANT1", ""},
+        {CAN_AGG_VAR, "U", ""},
+        {CAN_AGG_COUNT, "", "n"},
+    };
+    can_dataframe *res = can_groupby_agg(df2, 1, keys, 4, specs);
+    can_print(res, 4);
+
+    // NaN propagates to min / max wherever it is in the group, with or without nulls in the column
+    const char nan_cols[MAX_COL_NUM][MAX_COL_LEN] = {"K", "V"};
+    int k[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+    double v[8] = {NAN, 1, 3, 2, 5, NAN, 4, 6};
+    void *values[MAX_COL_NUM] = {k, v};
+    can_dataframe *df3 = can_alloc(8, 2, nan_cols, "ID", values);
+    char nan_keys[MAX_COL_NUM][MAX_COL_LEN] = {"K"};
+    can_agg_spec nan_specs[2] = {{CAN_AGG_MIN, "V", ""}, {CAN_AGG_MAX, "V", ""}};
+    can_dataframe *res1 = can_groupby_agg(df3, 1, nan_keys, 2, nan_specs);
+    can_print(res1, 2);
+    can_set_null(df3, 7, "V");
+    can_dataframe *res2 = can_groupby_agg(df3, 1, nan_keys, 2, nan_specs);
+    can_print(res2, 2);
+
+    can_free(df1);
+    can_free(df2);
+    can_free(df3);
+    can_free(res);
+    can_free(res1);
+    can_free(res2);
+}
+
+void test_unique()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df1 = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_dataframe *df2 = can_concat_row(df1, df1);
+
+    can_dataframe *res = can_unique(df2, "ANCHOR");
+    can_print(res, 4);
+
+    // last row of every (U, ANCHOR) and how many rows each had
+    char keys[MAX_COL_NUM][MAX_COL_LEN] = {"U", "ANCHOR"};
+    int *counts = NULL;
+    can_dataframe *res2 = can_drop_duplicates(df2, 2, keys, 1, &counts);
+    can_print(res2, 4);
+    printf("counts: %d %d %d %d\n", counts[0], counts[1], counts[2], counts[3]);
+
+    free(counts);
+    can_free(df1);
+    can_free(df2);
+    can_free(res);
+    can_free(res2);
+}
+
+void test_query()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df1 = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+
+    const char cols2[MAX_COL_NUM][MAX_COL_LEN] = {"ANT1", "LENGTH"};
+    int ant1[7] = {10001, 10002, 19354, 20000, 19333, 36647, 88888};
+    double length[7] = {1.1, 1.2, 1.4, 2.0, 1.3, 3.7, 8.8};
+    void *values[MAX_COL_NUM] = {ant1, length};
+    can_dataframe *df2 = can_alloc(7, 2, cols2, "ID", values);
+
+    // steps are only recorded, nothing is copied yet
+    char keys[MAX_COL_NUM][MAX_COL_LEN] = {"U", "ANCHOR"};
+    int ascending[2] = {0, 1};
+    char select[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "ANT1", "LENGTH"};
+    can_query *q = can_query_from(df1);
+    can_query_sort_by(q, 2, keys, ascending);
+    can_query_merge_left(q, df2, "ANT1");
+    can_query_filter(q, can_pred_and(can_pred_range_double("LENGTH", 1.3, 10), can_pred_ne_char("ANCHOR", 'A')));
+    can_query_select(q, 3, select);
+    can_query_limit(q, 2);
+
+    // the filter on ANCHOR runs before the sort, the filter on LENGTH after the merge, only the result is copied
+    can_dataframe *res = can_query_collect(q);
+    can_print(res, 2);
+
+    can_query_free(q);
+    can_free(res);
+    can_free(df1);
+    can_free(df2);
+}
+
+void test_zone_maps()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"TIME", "VALUE"};
+    int n = 100000;
+    can_dataframe *df = can_alloc(n, 2, cols, "ID", NULL);
+    int *time = can_get_int_pointer(df, "TIME");
+    double *value = can_get_double_pointer(df, "VALUE");
+    for (int i = 0; i < n; i++)
+    {
+        time[i] = i;
+        value[i] = i % 100 * 0.5;
+    }
+
+    // blocks of 4096 rows outside [50000, 50004] are skipped without scanning
+    can_enable_zone_maps(df, 4096);
+    can_dataframe *res = can_filter_int(df, "TIME", 50000, 50004);
+    can_print(res, 5);
+
+    // writes through a pointer must be reported, set functions do it themselves
+    time[0] = 50002;
+    can_mark_modified(df, "TIME");
+    can_dataframe *res2 = can_filter_int(df, "TIME", 50000, 50004);
+    can_print(res2, 6);
+
+    can_free(df);
+    can_free(res);
+    can_free(res2);
+}
+
+void test_index()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ID", "VALUE"};
+    int n = 100000;
+    can_dataframe *df = can_alloc(n, 2, cols, "ID", NULL);
+    int *id = can_get_int_pointer(df, "ID");
+    double *value = can_get_double_pointer(df, "VALUE");
+    for (int i = 0; i < n; i++)
+    {
+        id[i] = (int)((i * 7919L) % n); // shuffled ids
+        value[i] = i * 0.5;
+    }
+
+    // filters on ID binary search the index instead of scanning
+    can_create_index(df, "ID");
+    can_dataframe *res = can_filter_int(df, "ID", 500, 503);
+    can_print(res, 4);
+
+    // set marks the index stale, next filter rebuilds it
+    can_set_int(df, 0, "ID", 501);
+    can_dataframe *res2 = can_filter_int(df, "ID", 501, 501);
+    can_print(res2, 2);
+
+    can_free(df);
+    can_free(res);
+    can_free(res2);
+}
+
+void test_allocator()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df1 = can_read_csv("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+
+    // intermediates come from the arena and go back all at once
+    can_allocator *arena = can_arena_new(1 << 16);
+    for (int i = 0; i < 10000; i++)
+    {
+        can_allocator *prev = can_set_allocator(arena);
+        can_dataframe *tmp = can_filter_double(df1, "U", 2.3, 2.34);
+        can_dataframe *res = can_sort(tmp, "ANT2");
+        can_set_allocator(prev);
+        if (i == 0)
+        {
+            can_print(res, 3);
+        }
+        can_arena_reset(arena);
+    }
+    can_allocator_free(arena);
+
+    // small frames reuse blocks of the pool
+    can_allocator *pool = can_pool_new();
+    can_allocator *prev = can_set_allocator(pool);
+    for (int i = 0; i < 10000; i++)
+    {
+        can_dataframe *res = can_select_col(df1, "N");
+        can_free(res);
+    }
+    can_set_allocator(prev);
+    can_allocator_free(pool);
+
+    can_free(df1);
+}
+
+void test_append()
+{
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "DISTANCE", "TAG_ID"};
+    can_dataframe *df = can_alloc(0, 3, cols, "CDI", NULL);
+
+    // one measurement at a time, columns grow by doubling
+    can_reserve(df, 4);
+    for (int i = 0; i < 1000; i++)
+    {
+        can_append_row(df, (char)('A' + i % 4), 1.5 * i, i);
+    }
+    can_print(df, 5);
+
+    // append a whole batch with one memcpy per column
+    can_dataframe *batch = can_filter_int(df, "TAG_ID", 0, 2);
+    can_append_frame(df, batch);
+    printf("n_row = %d, capacity = %d\n", df->n_row, df->capacity);
+
+    can_free(df);
+    can_free(batch);
+}
+
+void test_dtypes()
+{
+    // float / uint32 columns take half the memory of double / int
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv_mmap("../test_data/test1", 6, cols, "Cfffuu", " ", 1);
+    can_print(df, 4);
+
+    can_set_int64(df, 0, "ANT1", 4000000000LL);
+    printf("ANT1 of row 0 = %lld, U of row 1 = %f\n", (long long)can_get_int64(df, 0, "ANT1"), can_get_double(df, 1, "U"));
+
+    // integer filters take any integer column
+    can_dataframe *df1 = can_filter_int64(df, "ANT2", 38000, 39000);
+    can_print(df1, 4);
+
+    int64_t ants[2] = {19333, 20000};
+    can_pred *p = can_pred_or(can_pred_in_int64("ANT1", 2, ants), can_pred_range_double("E", 6.0, 7.0));
+    can_dataframe *df2 = can_filter(df, p);
+    can_print(df2, 4);
+
+    can_dataframe *df3 = can_sort(df, "U");
+    can_print(df3, 4);
+
+    can_pred_free(p);
+    can_free(df);
+    can_free(df1);
+    can_free(df2);
+    can_free(df3);
+}
+
+void test_strings()
+{
+    // ANCHOR as dictionary encoded strings, every row only holds an int code
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv_mmap("../test_data/test1", 6, cols, "SDDDII", " ", 1);
+    can_set_str(df, 3, "ANCHOR", "DELTA");
+    can_append_row(df, "ECHO", 1.0, 2.0, 3.0, 40000, 50000);
+    can_print(df, 5);
+    printf("ANCHOR of row 3 = %s\n", can_get_str(df, 3, "ANCHOR"));
+
+    // string is looked up once, rows are compared by code
+    can_dataframe *df1 = can_filter_str(df, "ANCHOR", "B");
+    can_print(df1, 5);
+
+    const char *names[2] = {"A", "ECHO"};
+    can_pred *p = can_pred_in_str("ANCHOR", 2, names);
+    can_dataframe *df2 = can_filter(df, p);
+    can_print(df2, 5);
+
+    // right dataframe has its own dictionary, its codes are translated once
+    const char right_cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "SITE"};
+    const char *anchors[3] = {"ECHO", "A", "ZULU"};
+    const char *sites[3] = {"roof", "gate", "lake"};
+    void *values[MAX_COL_NUM] = {(void *)anchors, (void *)sites};
+    can_dataframe *right = can_alloc(3, 2, right_cols, "SS", values);
+    can_dataframe *df3 = can_merge_left(df, right, "ANCHOR");
+    can_print(df3, 5);
+
+    can_dataframe *df4 = can_sort(df, "ANCHOR");
+    can_print(df4, 5);
+
+    can_pred_free(p);
+    can_free(df);
+    can_free(df1);
+    can_free(df2);
+    can_free(right);
+    can_free(df3);
+    can_free(df4);
+}
+
+void test_nulls()
+{
+    // missing csv fields (and can_set_null) are marked in a validity bitmap, MISS_* is kept as the stored value
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "N", "E", "U", "ANT1", "ANT2"};
+    can_dataframe *df = can_read_csv_mmap("../test_data/test1", 6, cols, "CDDDII", " ", 1);
+    can_set_null(df, 1, "ANT1");
+    can_set_null(df, 3, "N");
+    can_print(df, 4);
+    printf("ANT1 of row 1 is null = %d, nulls of N = %d\n", can_is_null(df, 1, "ANT1"), can_null_count(df, "N"));
+
+    // comparisons are false on null rows, can_pred_is_null selects them
+    can_dataframe *df1 = can_filter_double(df, "N", -1000, 0);
+    can_print(df1, 4);
+    can_pred *p = can_pred_or(can_pred_range_int("ANT1", 19000, 19500), can_pred_is_null("ANT1"));
+    can_dataframe *df2 = can_filter(df, p);
+    can_print(df2, 4);
+
+    // != is a comparison too, so null rows are not in it, NOT of == keeps them
+    can_pred *ne = can_pred_ne_int("ANT1", 19000);
+    can_pred *not_eq = can_pred_not(can_pred_eq_int("ANT1", 19000));
+    can_dataframe *df7 = can_filter(df, ne);
+    can_dataframe *df8 = can_filter(df, not_eq);
+    printf("ANT1 != 19000 has %d rows, NOT ANT1 == 19000 has %d rows\n", df7->n_row, df8->n_row);
+
+    // nulls first
+    char keys[MAX_COL_NUM][MAX_COL_LEN] = {"N"};
+    can_dataframe *df3 = can_sort_by_nulls(df, 1, keys, NULL, 0);
+    can_print(df3, 4);
+
+    // nulls are skipped, null keys form their own group
+    char group_keys[MAX_COL_NUM][MAX_COL_LEN] = {"ANT1"};
+    can_agg_spec specs[2] = {{CAN_AGG_MEAN, "N", ""}, {CAN_AGG_COUNT, "N", ""}};
+    can_dataframe *df4 = can_groupby_agg(df, 1, group_keys, 2, specs);
+    can_print(df4, 4);
+
+    // nulls are written as CAN_NULL_TOKEN ("NA") and read back as nulls, not as MISS_* values
+    const char rt_cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "SITE", "N", "ANT1"};
+    const char *sites[4] = {"roof", NULL, "gate", "lake"};
+    void *values[MAX_COL_NUM] = {can_get_char_pointer(df, "ANCHOR"), (void *)sites, can_get_double_pointer(df, "N"), can_get_int_pointer(df, "ANT1")};
+    can_dataframe *df5 = can_alloc(4, 4, rt_cols, "CSDI", values);
+    printf("NULL string of can_alloc is null = %d\n", can_is_null(df5, 1, "SITE"));
+    can_set_null(df5, 2, "ANCHOR");
+    can_set_null(df5, 3, "N");
+    can_set_null(df5, 1, "ANT1");
+    can_write_csv_buffered("../test_data/test1_copy", df5, " ", -1, 0);
+    can_dataframe *df6 = can_read_csv_mmap("../test_data/test1_copy", 4, rt_cols, "CSDI", " ", 1);
+    can_print(df6, 4);
+    printf("nulls read back: ANCHOR %d SITE %d N %d ANT1 %d\n", can_null_count(df6, "ANCHOR"), can_null_count(df6, "SITE"),
+           can_null_count(df6, "N"), can_null_count(df6, "ANT1"));
+    can_pred *ne_site = can_pred_ne_str("SITE", "gate");
+    can_dataframe *df9 = can_filter(df6, ne_site);
+    can_print(df9, 4);
+
+    can_pred_free(p);
+    can_pred_free(ne);
+    can_pred_free(not_eq);
+    can_pred_free(ne_site);
+    can_free(df);
+    can_free(df1);
+    can_free(df2);
+    can_free(df3);
+    can_free(df4);
+    can_free(df5);
+    can_free(df6);
+    can_free(df7);
+    can_free(df8);
+    can_free(df9);
+}
+
+void test_compress()
+{
+    // 10000 epochs of 4 anchors: runs of anchor names, steady timestamps, antenna IDs in a small range
+    const char cols[MAX_COL_NUM][MAX_COL_LEN] = {"ANCHOR", "TIME", "ANT1", "N"};
+    can_dataframe *df = can_alloc(10000, 4, cols, "ClID", NULL);
+    for (int i = 0; i < df->n_row; i++)
+    {
+        ((char *)df->values[0])[i] = 'A' + i / 2500;
+        ((int64_t *)df->values[1])[i] = 1700000000000LL + i * 1000;
+        ((int *)df->values[2])[i] = 19300 + i % 64;
+        ((double *)df->values[3])[i] = (i % 100) * 0.01;
+    }
+    can_set_null(df, 7, "ANT1");
+
+    // every column gets the encoding with the least bytes
+    can_compressed *cf = can_compress(df);
+    printf("encodings ANCHOR %d TIME %d ANT1 %d N %d, %zu bytes\n", can_compressed_encoding(cf, "ANCHOR"), can_compressed_encoding(cf, "TIME"),
+           can_compressed_encoding(cf, "ANT1"), can_compressed_encoding(cf, "N"), can_compressed_bytes(cf));
+
+    // filters and aggregates run on the encoded values
+    can_pred *p = can_pred_and(can_pred_eq_char("ANCHOR", 'B'), can_pred_range_int("ANT1", 19300, 19301));
+    can_dataframe *df1 = can_compressed_filter(cf, p);
+    can_print(df1, 4);
+    printf("ANT1 max %f count %f\n", can_compressed_agg(cf, "ANT1", CAN_AGG_MAX), can_compressed_agg(cf, "ANT1", CAN_AGG_COUNT));
+
+    can_dataframe *df2 = can_decompress(cf);
+    can_print(df2, 4);
+
+    can_pred_free(p);
+    can_compressed_free(cf);
+    can_free(df);
     can_free(df1);
     can_free(df2);
 }
@@ -166,11 +733,29 @@ int main(int argc, char const *argv[])
 {
     // test_alloc_and_free();
     // test_read_and_write_csv();
+    // test_read_csv_mmap();
+    // test_csv_reader();
+    // test_write_csv_buffered();
+    // test_binary();
     // test_get_and_set();
     // test_select_col_and_cols();
     // test_select_row_and_rows();
     // test_filter();
+    // test_filter_pred();
+    // test_view();
     // test_concat();
     // test_merge();
-    test_sort();
+    // test_sort();
+    // test_sort_by();
+    // test_query();
+    // test_groupby();
+    // test_unique();
+    // test_zone_maps();
+    // test_index();
+    // test_allocator();
+    // test_append();
+    // test_dtypes();
+    // test_strings();
+    // test_nulls();
+    test_compress();
 }